@@ -17,86 +17,114 @@
 #include <cassert>
 
 namespace adept {
+
+/** @brief Memory orderings and scopes accepted by the atomic types */
+using memory_order = sycl::ext::oneapi::memory_order;
+using memory_scope = sycl::ext::oneapi::memory_scope;
+
 /**
  * @brief A portable atomic type. Not all base types are supported by CUDA.
+ * @details The value is stored as a plain member, so that the object can be copied between host and
+ * device, and every operation goes through a sycl atomic_ref built on the fly. The default memory order
+ * used by the operations and the scope of the synchronization are template parameters, so that
+ * containers only pay for the ordering they need. Each operation also accepts an explicit order.
+ * @tparam Order Default ordering: relaxed, acquire/release (acq_rel) or seq_cst
+ * @tparam Scope Set of work items the operations synchronize with: work_group, device or system
+ * @tparam Space Address space of the atomic: global_space, or local_space for work-group local memory
  */
-template <typename Type>
+template <typename Type, memory_order Order = memory_order::relaxed, memory_scope Scope = memory_scope::device,
+          sycl::access::address_space Space = sycl::access::address_space::global_space>
 struct AtomicBase_t {
 
-  using AtomicType_t =  sycl::ext::oneapi::atomic_ref<Type,
-			sycl::ext::oneapi::memory_order::relaxed,
-			sycl::ext::oneapi::memory_scope::system,
-			sycl::access::address_space::global_space>;
+  using AtomicRef_t = sycl::ext::oneapi::atomic_ref<Type, Order, Scope, Space>;
+
+  static constexpr memory_order kOrder = Order; ///< Default memory order
+  static constexpr memory_scope kScope = Scope; ///< Memory scope
 
-  Type a = 0; AtomicType_t fData{a};
+  Type fData{0}; ///< Stored value, only accessed through atomic references
 
-  AtomicBase_t(Type t = 0) : fData(a) { a = t;}
+  /** @brief Atomic reference to the stored value */
+  AtomicRef_t Ref() const { return AtomicRef_t(const_cast<Type &>(fData)); }
+
+  AtomicBase_t(Type t = 0) : fData(t) {}
 
   /** @brief Copy constructor */
-  AtomicBase_t(AtomicBase_t const &other) { store(other.load()); }
+  AtomicBase_t(AtomicBase_t const &other) : fData(other.load()) {}
 
-  AtomicBase_t &operator=(AtomicBase_t const &other) { store(other.load()); }
+  AtomicBase_t &operator=(AtomicBase_t const &other)
+  {
+    store(other.load());
+    return *this;
+  }
 
   /** @brief Emplace the data at a given address */
-  static AtomicBase_t *MakeInstanceAt(void *addr)  {
+  static AtomicBase_t *MakeInstanceAt(void *addr)
+  {
     assert(addr != nullptr && "cannot allocate at nullptr address");
-    assert((((unsigned long long)addr) % alignof(AtomicType_t)) == 0 && "addr does not satisfy alignment");
+    assert((((unsigned long long)addr) % alignof(Type)) == 0 && "addr does not satisfy alignment");
     AtomicBase_t *obj = new (addr) AtomicBase_t();
     return obj;
   }
 
   /** @brief Atomically replaces the current value with desired. */
-  
-  void store(Type desired) {
-    return(fData.store(desired));
-  }
+  void store(Type desired) { Ref().store(desired); }
+
+  void store(Type desired, memory_order order) { Ref().store(desired, order); }
 
   /** @brief Atomically loads and returns the current value of the atomic variable. */
-  
-  Type load() const {
-    // There is no atomic load on CUDA. Issue a memory fence to get the required
-    // semantics and make sure that the value is really loaded from memory.
-    return fData.load();
-  }
+  Type load() const { return Ref().load(); }
+
+  Type load(memory_order order) const { return Ref().load(order); }
 
   /** @brief Atomically replaces the underlying value with desired. */
-  
-  Type exchange(Type desired) {
-    return fData.exchange(desired);
-   }
+  Type exchange(Type desired, memory_order order = Order) { return Ref().exchange(desired, order); }
 
   /** @brief Atomically compares the stored value with the expected one, and if equal stores desired.
    * If not loads the old value into expected. Returns true if swap was successful. */
-  
-  bool compare_exchange_strong(Type &expected, Type desired) {
-    return(fData.compare_exchange_strong(expected, desired));
+  bool compare_exchange_strong(Type &expected, Type desired) { return Ref().compare_exchange_strong(expected, desired); }
+
+  bool compare_exchange_strong(Type &expected, Type desired, memory_order success, memory_order failure)
+  {
+    return Ref().compare_exchange_strong(expected, desired, success, failure);
+  }
+
+  /** @brief Same as compare_exchange_strong, but may fail spuriously. Cheaper in retry loops. */
+  bool compare_exchange_weak(Type &expected, Type desired) { return Ref().compare_exchange_weak(expected, desired); }
+
+  bool compare_exchange_weak(Type &expected, Type desired, memory_order success, memory_order failure)
+  {
+    return Ref().compare_exchange_weak(expected, desired, success, failure);
   }
 
   // @brief Atomically assigns the desired value to the atomic variable.
-  Type operator=(Type desired) { return fData.operator=(desired); }
+  Type operator=(Type desired)
+  {
+    store(desired);
+    return desired;
+  }
 
   // @brief Atomically replaces the current value with the result of arithmetic addition of the value and arg.
-  Type fetch_add(Type arg) { return fData.fetch_add(arg); }
+  Type fetch_add(Type arg, memory_order order = Order) { return Ref().fetch_add(arg, order); }
 
   // @brief Atomically replaces the current value with the result of arithmetic subtraction of the value and arg.
-  Type fetch_sub(Type arg) { return fData.fetch_sub(arg); }
+  Type fetch_sub(Type arg, memory_order order = Order) { return Ref().fetch_sub(arg, order); }
 
   // @brief Atomically replaces the current value with the result of bitwise AND of the value and arg.
-  Type fetch_and(Type arg) { return fData.fetch_and(arg); }
+  Type fetch_and(Type arg, memory_order order = Order) { return Ref().fetch_and(arg, order); }
 
   // @brief Atomically replaces the current value with the result of bitwise OR of the value and arg.
-  Type fetch_or(Type arg) { return fData.fetch_or(arg); }
+  Type fetch_or(Type arg, memory_order order = Order) { return Ref().fetch_or(arg, order); }
 
   // @brief Atomically replaces the current value with the result of bitwise XOR of the value and arg.
-  Type fetch_xor(Type arg) { return fData.fetch_xor(arg); }
+  Type fetch_xor(Type arg, memory_order order = Order) { return Ref().fetch_xor(arg, order); }
 
   // @brief Atomically replaces the current value with the result of MAX of the value and arg.
-  Type fetch_max(Type arg) { return fData.fetch_max(&fData, arg); }
+  Type fetch_max(Type arg, memory_order order = Order) { return Ref().fetch_max(arg, order); }
 
   // @brief Atomically replaces the current value with the result of MIN of the value and arg.
-  Type fetch_min(Type arg) { return fData.fetch_min(&fData, arg); }
+  Type fetch_min(Type arg, memory_order order = Order) { return Ref().fetch_min(arg, order); }
 
-  /** @brief Performs atomic add. */  
+  /** @brief Performs atomic add. */
   Type operator+=(Type arg) { return (fetch_add(arg) + arg); }
 
   /** @brief Performs atomic subtract. */
@@ -117,22 +145,41 @@ struct AtomicBase_t {
 };
 
 /** @brief Atomic_t generic implementation specialized using SFINAE mechanism */
-template <typename Type, typename Enable = void>
+template <typename Type, memory_order Order = memory_order::relaxed, memory_scope Scope = memory_scope::device,
+          sycl::access::address_space Space = sycl::access::address_space::global_space, typename Enable = void>
 struct Atomic_t;
 
 /** @brief Specialization for integral types. */
-template <typename Type>
-struct Atomic_t<Type> : public AtomicBase_t<Type> {
-  using AtomicBase_t<Type>::fData;
+template <typename Type, memory_order Order, memory_scope Scope, sycl::access::address_space Space>
+struct Atomic_t<Type, Order, Scope, Space> : public AtomicBase_t<Type, Order, Scope, Space> {
+  using Base_t = AtomicBase_t<Type, Order, Scope, Space>;
+  using Base_t::Base_t;
+  using Base_t::Ref;
+
+  Atomic_t() = default;
+  Atomic_t(Atomic_t const &other) = default;
+  Atomic_t &operator=(Atomic_t const &other) = default;
 
   /** @brief Atomically assigns the desired value to the atomic variable. */
-  Type operator=(Type desired)  {
-    fData.exchange(desired);
+  Type operator=(Type desired)
+  {
+    Ref().exchange(desired);
     return desired;
   }
 
-
 }; // End specialization for integral types of Atomic_t
 
+/** @brief Counter only used to hand out unique indices: no ordering with other memory accesses */
+template <typename Type>
+using AtomicCounter_t = Atomic_t<Type, memory_order::relaxed, memory_scope::device>;
+
+/** @brief Flag or sequence number publishing data written before it: release stores, acquire loads */
+template <typename Type>
+using AtomicSync_t = Atomic_t<Type, memory_order::acq_rel, memory_scope::device>;
+
+/** @brief Counter shared by the work items of one work-group only */
+template <typename Type>
+using AtomicGroup_t = Atomic_t<Type, memory_order::relaxed, memory_scope::work_group>;
+
 } // End namespace adept
 #endif // ADEPT_ATOMIC_H_
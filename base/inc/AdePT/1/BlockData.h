@@ -10,6 +10,8 @@
 #ifndef ADEPT_1BLOCKDATA_H_
 #define ADEPT_1BLOCKDATA_H_
 
+#include <cassert>
+
 #include <CopCore/1/CopCore.h>
 #include <AdePT/1/Atomic.h>
 #include <AdePT/1/mpmc_bounded_queue.h>
@@ -24,7 +26,7 @@ template <typename Type>
 class BlockData : protected copcore::VariableSizeObjectInterface<BlockData<Type>, Type> {
 
 public:
-  using AtomicInt_t = adept::Atomic_t<int>;
+  using AtomicInt_t = adept::AtomicCounter_t<int>; ///< Holes are synchronized by the queue
   using Queue_t     = adept::mpmc_bounded_queue<int>;
   using Value_t     = Type;
   using Base_t      = copcore::VariableSizeObjectInterface<BlockData<Value_t>, Value_t>;
@@ -120,6 +122,74 @@ public:
     fHoles->enqueue(index);
   }
 
+  /** @brief Dispatch up to n free elements at once, writing their indices. Returns the number obtained.
+      @details Holes are taken first with a single bulk dequeue, the rest is booked with a single atomic. */
+  int NextElements(int *indices, int n)
+  {
+    int nholes = fHoles->dequeue_n(indices, n);
+    int nnew   = 0;
+    if (nholes < n) {
+      int first = fNbooked.fetch_add(n - nholes);
+      nnew      = first < fCapacity ? fCapacity - first : 0;
+      if (nnew > n - nholes) nnew = n - nholes;
+      for (int i = 0; i < nnew; ++i)
+        indices[nholes + i] = first + i;
+    }
+    if (nholes + nnew > 0) fNused.fetch_add(nholes + nnew);
+    return nholes + nnew;
+  }
+
+  /** @brief Release n elements at once */
+  void ReleaseElements(int const *indices, int n)
+  {
+    if (n <= 0) return;
+    int done = 0;
+    while (done < n) {
+      int nqueued = fHoles->enqueue_n(indices + done, n - done);
+      if (nqueued == 0) break;
+      done += nqueued;
+    }
+    // The holes queue has the capacity of the block, so it holds every element that can be released.
+    // Only the elements actually turned into holes stop counting as used.
+    assert(done == n && "BlockData::ReleaseElements: holes queue full");
+    fNused.fetch_sub(done);
+  }
+
+  /** @brief Sub-group cooperative NextElement. Must be called by all work items of the sub-group.
+      @details Holes are dequeued for the whole sub-group with one CAS, and the missing elements are
+        booked by the sub-group leader with one atomic. Returns nullptr for items not wanting an element,
+        or if none is left. */
+  template <typename SubGroup>
+  Type *NextElement(SubGroup const &sg, bool want = true)
+  {
+    int index    = -1;
+    bool gotHole = fHoles->dequeue_subgroup(sg, index, want);
+    bool needNew = want && !gotHole;
+    int rank     = sycl::exclusive_scan_over_group(sg, needNew ? 1 : 0, sycl::plus<int>());
+    int nneeded  = sycl::reduce_over_group(sg, needNew ? 1 : 0, sycl::plus<int>());
+    if (nneeded > 0) {
+      int first = 0;
+      if (sg.get_local_id()[0] == 0) first = fNbooked.fetch_add(nneeded);
+      first = sycl::group_broadcast(sg, first, 0);
+      if (needNew) index = (first + rank < fCapacity) ? first + rank : -1;
+    }
+    int ngot = sycl::reduce_over_group(sg, (want && index >= 0) ? 1 : 0, sycl::plus<int>());
+    if (ngot > 0 && sg.get_local_id()[0] == 0) fNused.fetch_add(ngot);
+    return (want && index >= 0) ? &fData[index] : nullptr;
+  }
+
+  /** @brief Sub-group cooperative ReleaseElement. Must be called by all work items of the sub-group. */
+  template <typename SubGroup>
+  void ReleaseElement(SubGroup const &sg, int index, bool active = true)
+  {
+    bool queued = fHoles->enqueue_subgroup(sg, index, active);
+    // As in ReleaseElements, only the elements actually turned into holes stop counting as used.
+    int nqueued = sycl::reduce_over_group(sg, queued ? 1 : 0, sycl::plus<int>());
+    assert(nqueued == sycl::reduce_over_group(sg, active ? 1 : 0, sycl::plus<int>()) &&
+           "BlockData::ReleaseElement: holes queue full");
+    if (nqueued > 0 && sg.get_local_id()[0] == 0) fNused.fetch_sub(nqueued);
+  }
+
   /** @brief Number of elements currently distributed */
   int GetNused() { return fNused.load(); }
 
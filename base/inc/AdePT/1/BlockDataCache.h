@@ -0,0 +1,178 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file BlockDataCache.h
+ * @brief Caches of free BlockData slots, per CPU thread and per work-group.
+ *
+ * @details A cache is a small magazine of free element indices. Elements are taken from and returned to
+ * the magazine without global atomics. When it runs empty it is refilled in one BlockData::NextElements
+ * call, and when it is full part of it is flushed with one BlockData::ReleaseElements call. Indices kept
+ * in the magazine count as used in the block, so the magazine has to be flushed before the block
+ * statistics are inspected.
+ *
+ * BlockDataCache is owned by a single CPU thread (or device work item). BlockDataGroupCache lives in the
+ * local memory of a work-group and is shared by its work items, which call its operations together.
+ */
+
+#ifndef ADEPT_1BLOCKDATACACHE_H_
+#define ADEPT_1BLOCKDATACACHE_H_
+
+#include <cassert>
+
+#include <AdePT/1/BlockData.h>
+
+namespace adept {
+
+/** @brief Magazine of N free indices of a BlockData */
+template <typename Type, int N = 32>
+class BlockDataCache {
+  static_assert(N >= 2 && N % 2 == 0, "BlockDataCache size has to be an even number");
+
+public:
+  using Block_t = BlockData<Type>;
+
+private:
+  Block_t *fBlock{nullptr}; ///< Block the indices belong to
+  int fCount{0};            ///< Number of cached indices
+  int fIndices[N];          ///< Cached free indices
+
+public:
+  BlockDataCache(Block_t *block) : fBlock(block) {}
+
+  BlockDataCache(const BlockDataCache &) = delete;
+  BlockDataCache &operator=(const BlockDataCache &) = delete;
+
+  /** @brief Returns the cached indices to the block */
+  ~BlockDataCache() { Flush(); }
+
+  /** @brief Index of the next free element, -1 if none left in the block */
+  int NextIndex()
+  {
+    if (fCount == 0) fCount = fBlock->NextElements(fIndices, N / 2);
+    if (fCount == 0) return -1;
+    return fIndices[--fCount];
+  }
+
+  /** @brief Next free element, nullptr if none left in the block */
+  Type *NextElement()
+  {
+    int index = NextIndex();
+    return (index < 0) ? nullptr : &(*fBlock)[index];
+  }
+
+  /** @brief Release an element given by NextIndex or NextElement */
+  void ReleaseElement(int index)
+  {
+    if (fCount == N) {
+      fBlock->ReleaseElements(fIndices + N / 2, N / 2);
+      fCount = N / 2;
+    }
+    fIndices[fCount++] = index;
+  }
+
+  /** @brief Return all cached indices to the block */
+  void Flush()
+  {
+    fBlock->ReleaseElements(fIndices, fCount);
+    fCount = 0;
+  }
+
+  /** @brief Number of cached indices */
+  int GetNcached() const { return fCount; }
+}; // End class BlockDataCache
+
+/** @brief Magazine of N free indices of a BlockData, shared by a work-group.
+ *  @details The object is placed in local memory and is not constructed: Init() sets it up. All
+ *  operations are collective over the group, which must not have more than N work items.
+ */
+template <typename Type, int N = 256>
+class BlockDataGroupCache {
+  static_assert(N >= 2 && N % 2 == 0, "BlockDataGroupCache size has to be an even number");
+
+public:
+  using Block_t = BlockData<Type>;
+
+private:
+  Block_t *fBlock; ///< Block the indices belong to
+  int fCount;      ///< Number of cached indices
+  int fIndices[N]; ///< Cached free indices
+
+  template <typename Group>
+  static bool IsLeader(Group const &group)
+  {
+    return group.get_local_linear_id() == 0;
+  }
+
+public:
+  /** @brief Empty the magazine and attach it to a block */
+  template <typename Group>
+  void Init(Group const &group, Block_t *block)
+  {
+    assert(group.get_local_linear_range() <= N && "BlockDataGroupCache: group larger than the cache");
+    if (IsLeader(group)) {
+      fBlock = block;
+      fCount = 0;
+    }
+    sycl::group_barrier(group);
+  }
+
+  /** @brief Index of the next free element for the work items with want set, -1 for the others or if
+   *  none is left in the block. The magazine is refilled by the leader when it holds too few indices. */
+  template <typename Group>
+  int NextIndex(Group const &group, bool want = true)
+  {
+    int rank  = sycl::exclusive_scan_over_group(group, want ? 1 : 0, sycl::plus<int>());
+    int total = sycl::reduce_over_group(group, want ? 1 : 0, sycl::plus<int>());
+    if (total == 0) return -1;
+    if (IsLeader(group) && fCount < total) {
+      int refill = total - fCount + N / 2;
+      if (refill > N - fCount) refill = N - fCount;
+      fCount += fBlock->NextElements(fIndices + fCount, refill);
+    }
+    sycl::group_barrier(group);
+    const int count = fCount;
+    int index       = (want && rank < count) ? fIndices[count - 1 - rank] : -1;
+    sycl::group_barrier(group);
+    if (IsLeader(group)) fCount = count > total ? count - total : 0;
+    sycl::group_barrier(group);
+    return index;
+  }
+
+  /** @brief Release the elements of the work items with active set. The leader first flushes the
+   *  magazine to the block down to half of its size if the indices would not fit. */
+  template <typename Group>
+  void ReleaseElement(Group const &group, int index, bool active = true)
+  {
+    int rank  = sycl::exclusive_scan_over_group(group, active ? 1 : 0, sycl::plus<int>());
+    int total = sycl::reduce_over_group(group, active ? 1 : 0, sycl::plus<int>());
+    if (total == 0) return;
+    if (IsLeader(group) && fCount + total > N) {
+      int nflush = fCount + total - N / 2;
+      if (nflush > fCount) nflush = fCount;
+      fBlock->ReleaseElements(fIndices + fCount - nflush, nflush);
+      fCount -= nflush;
+    }
+    sycl::group_barrier(group);
+    const int count = fCount;
+    if (active) fIndices[count + rank] = index;
+    sycl::group_barrier(group);
+    if (IsLeader(group)) fCount = count + total;
+    sycl::group_barrier(group);
+  }
+
+  /** @brief Return all cached indices to the block */
+  template <typename Group>
+  void Flush(Group const &group)
+  {
+    if (IsLeader(group)) {
+      fBlock->ReleaseElements(fIndices, fCount);
+      fCount = 0;
+    }
+    sycl::group_barrier(group);
+  }
+}; // End class BlockDataGroupCache
+
+} // End namespace adept
+
+#endif // ADEPT_1BLOCKDATACACHE_H_
@@ -0,0 +1,351 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file DaughterBVH.h
+ * @brief Bounding volume hierarchies over the daughters of logical volumes.
+ *
+ * @details For every logical volume with enough daughters, a binary tree of axis-aligned boxes is built
+ * on the host over the bounding boxes of the daughters, expressed in the frame of the volume. The trees
+ * of all volumes are flattened into a single node array, whose leaves refer to ranges of an array of
+ * daughter indices. The structure holds no pointers besides the array bases, so it is uploaded to the
+ * device by copying the arrays. Navigation queries then only test the daughters whose boxes are crossed
+ * by the step, contain the point, or are closer than the safety found so far, instead of all of them.
+ */
+
+#ifndef ADEPT_1DAUGHTERBVH_H_
+#define ADEPT_1DAUGHTERBVH_H_
+
+#include <CL/sycl.hpp>
+
+#include <CopCore/1/Global.h>
+
+#include <VecGeom/base/Global.h>
+#include <VecGeom/base/Vector3D.h>
+#include <VecGeom/volumes/LogicalVolume.h>
+#include <VecGeom/volumes/PlacedVolume.h>
+
+#include <algorithm>
+#include <numeric>
+#include <set>
+#include <vector>
+
+namespace adept {
+
+/** @brief Flattened BVHs over the daughter bounding boxes of all logical volumes */
+class DaughterBVH {
+public:
+  using Precision = vecgeom::Precision;
+  using Vector    = vecgeom::Vector3D<Precision>;
+
+  /** @brief Node of a tree. The children of an inner node are stored next to each other. */
+  struct Node {
+    Precision fMin[3]; ///< Lower corner of the box
+    Precision fMax[3]; ///< Upper corner of the box
+    int fFirst;        ///< Leaf: first entry in the daughter indices. Inner node: index of the left child
+    int fCount;        ///< Leaf: number of daughters. Zero for inner nodes
+  };
+
+  static constexpr int kStackSize = 64; ///< Traversal stack, enough for trees of any practical depth
+
+private:
+  const Node *fNodes{nullptr};  ///< Nodes of all trees
+  const int *fDaughters{nullptr}; ///< Indices into the daughter lists, referenced by the leaves
+  const int *fRoots{nullptr};   ///< Root node per logical volume id, -1 for volumes without tree
+  int fNumVolumes{0};           ///< Size of fRoots
+
+  __host__ __device__ static bool ContainsPoint(Node const &node, Vector const &point)
+  {
+    for (int k = 0; k < 3; ++k) {
+      if (point[k] < node.fMin[k] || point[k] > node.fMax[k]) return false;
+    }
+    return true;
+  }
+
+  /** @brief Slab test of the segment [0, step] of the ray against the box of a node */
+  __host__ __device__ static bool Intersects(Node const &node, Vector const &point, Vector const &invDir,
+                                             Precision step)
+  {
+    Precision tmin = 0, tmax = step;
+    for (int k = 0; k < 3; ++k) {
+      Precision t1 = (node.fMin[k] - point[k]) * invDir[k];
+      Precision t2 = (node.fMax[k] - point[k]) * invDir[k];
+      if (t1 > t2) {
+        Precision t = t1;
+        t1          = t2;
+        t2          = t;
+      }
+      // NaNs from a point on the slab of a parallel ray compare false and leave the interval unchanged.
+      tmin = t1 > tmin ? t1 : tmin;
+      tmax = t2 < tmax ? t2 : tmax;
+    }
+    return tmin <= tmax;
+  }
+
+  /** @brief Squared distance from the point to the box of a node, zero inside */
+  __host__ __device__ static Precision Distance2(Node const &node, Vector const &point)
+  {
+    Precision d2 = 0;
+    for (int k = 0; k < 3; ++k) {
+      Precision d = point[k] < node.fMin[k] ? node.fMin[k] - point[k] : point[k] - node.fMax[k];
+      d2 += d > 0 ? d * d : 0;
+    }
+    return d2;
+  }
+
+public:
+  DaughterBVH() = default;
+
+  DaughterBVH(const Node *nodes, const int *daughters, const int *roots, int numVolumes)
+      : fNodes(nodes), fDaughters(daughters), fRoots(roots), fNumVolumes(numVolumes)
+  {
+  }
+
+  /** @brief Root node of the tree of a logical volume, -1 if the volume has none */
+  __host__ __device__ int Root(unsigned int volumeId) const
+  {
+    return volumeId < (unsigned int)fNumVolumes ? fRoots[volumeId] : -1;
+  }
+
+  /** @brief Calls hit(index, step) for the daughters whose boxes are crossed by the ray within step.
+   *  @details hit returns the new step, which prunes the remaining nodes.
+   */
+  template <typename Hit>
+  __host__ __device__ void ForEachCandidate(int root, Vector const &point, Vector const &dir, Precision step,
+                                            Hit &&hit) const
+  {
+    const Vector invDir(1. / dir[0], 1. / dir[1], 1. / dir[2]);
+    int stack[kStackSize];
+    int top      = 0;
+    stack[top++] = root;
+    while (top > 0) {
+      Node const &node = fNodes[stack[--top]];
+      if (!Intersects(node, point, invDir, step)) continue;
+      if (node.fCount > 0) {
+        for (int i = node.fFirst; i < node.fFirst + node.fCount; ++i)
+          step = hit(fDaughters[i], step);
+      } else {
+        stack[top++] = node.fFirst + 1;
+        stack[top++] = node.fFirst;
+      }
+    }
+  }
+
+  /** @brief Calls near(index, safety) for the daughters whose boxes are closer to the point than safety.
+   *  @details near returns the new safety, which prunes the remaining nodes. As the box of a daughter
+   *  encloses it, the daughters skipped cannot be closer than the safety.
+   */
+  template <typename Near>
+  __host__ __device__ void ForEachNearer(int root, Vector const &point, Precision safety, Near &&near) const
+  {
+    int stack[kStackSize];
+    int top      = 0;
+    stack[top++] = root;
+    while (top > 0) {
+      Node const &node = fNodes[stack[--top]];
+      if (Distance2(node, point) >= safety * safety) continue;
+      if (node.fCount > 0) {
+        for (int i = node.fFirst; i < node.fFirst + node.fCount; ++i)
+          safety = near(fDaughters[i], safety);
+      } else {
+        stack[top++] = node.fFirst + 1;
+        stack[top++] = node.fFirst;
+      }
+    }
+  }
+
+  /** @brief Calls test(index) for the daughters whose boxes contain the point, until it returns true.
+   *  @returns Whether test returned true for one of the daughters
+   */
+  template <typename Test>
+  __host__ __device__ bool FindFirst(int root, Vector const &point, Test &&test) const
+  {
+    int stack[kStackSize];
+    int top      = 0;
+    stack[top++] = root;
+    while (top > 0) {
+      Node const &node = fNodes[stack[--top]];
+      if (!ContainsPoint(node, point)) continue;
+      if (node.fCount > 0) {
+        for (int i = node.fFirst; i < node.fFirst + node.fCount; ++i)
+          if (test(fDaughters[i])) return true;
+      } else {
+        stack[top++] = node.fFirst + 1;
+        stack[top++] = node.fFirst;
+      }
+    }
+    return false;
+  }
+}; // End class DaughterBVH
+
+/** @brief Builds the DaughterBVH of a geometry on the host and uploads it to the device */
+class DaughterBVHBuilder {
+  using Node      = DaughterBVH::Node;
+  using Precision = vecgeom::Precision;
+  using Vector    = vecgeom::Vector3D<Precision>;
+
+  struct Box_t {
+    Vector fMin;
+    Vector fMax;
+    Vector Center() const { return 0.5 * (fMin + fMax); }
+  };
+
+  int fMinDaughters;           ///< Volumes with fewer daughters are scanned linearly
+  int fLeafSize;               ///< Maximum number of daughters per leaf
+  std::vector<Node> fNodes;    ///< Nodes of all trees
+  std::vector<int> fDaughters; ///< Daughter indices referenced by the leaves
+  std::vector<int> fRoots;     ///< Root node per logical volume id
+
+  sycl::queue *fQueue{nullptr}; ///< Queue of the device copy
+  char *fDeviceBuffer{nullptr}; ///< Device copy of the three arrays
+
+  /** @brief Bounding box of a daughter in the frame of its mother */
+  static Box_t DaughterBox(vecgeom::VPlacedVolume const *daughter)
+  {
+    Vector lo, hi;
+    daughter->GetUnplacedVolume()->Extent(lo, hi);
+    Box_t box{Vector(vecgeom::kInfLength), Vector(-vecgeom::kInfLength)};
+    for (int corner = 0; corner < 8; ++corner) {
+      Vector local(corner & 1 ? hi[0] : lo[0], corner & 2 ? hi[1] : lo[1], corner & 4 ? hi[2] : lo[2]);
+      Vector inMother = daughter->GetTransformation()->InverseTransform(local);
+      for (int k = 0; k < 3; ++k) {
+        box.fMin[k] = std::min(box.fMin[k], inMother[k] - vecgeom::kTolerance);
+        box.fMax[k] = std::max(box.fMax[k], inMother[k] + vecgeom::kTolerance);
+      }
+    }
+    return box;
+  }
+
+  /** @brief Fill node with the subtree over the daughters indices[begin, end) */
+  void FillNode(int node, std::vector<Box_t> const &boxes, std::vector<int> &indices, int begin, int end)
+  {
+    Node bounds;
+    Vector cmin(vecgeom::kInfLength), cmax(-vecgeom::kInfLength);
+    for (int k = 0; k < 3; ++k) {
+      bounds.fMin[k] = vecgeom::kInfLength;
+      bounds.fMax[k] = -vecgeom::kInfLength;
+    }
+    for (int i = begin; i < end; ++i) {
+      Box_t const &box = boxes[indices[i]];
+      Vector center    = box.Center();
+      for (int k = 0; k < 3; ++k) {
+        bounds.fMin[k] = std::min(bounds.fMin[k], box.fMin[k]);
+        bounds.fMax[k] = std::max(bounds.fMax[k], box.fMax[k]);
+        cmin[k]        = std::min(cmin[k], center[k]);
+        cmax[k]        = std::max(cmax[k], center[k]);
+      }
+    }
+
+    if (end - begin <= fLeafSize) {
+      bounds.fFirst = fDaughters.size();
+      bounds.fCount = end - begin;
+      fDaughters.insert(fDaughters.end(), indices.begin() + begin, indices.begin() + end);
+      fNodes[node] = bounds;
+      return;
+    }
+
+    // Median split along the axis of largest extent of the box centers.
+    int axis = 0;
+    for (int k = 1; k < 3; ++k)
+      if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis]) axis = k;
+    const int mid = begin + (end - begin) / 2;
+    std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+                     [&](int a, int b) { return boxes[a].Center()[axis] < boxes[b].Center()[axis]; });
+
+    const int left = fNodes.size();
+    fNodes.emplace_back();
+    fNodes.emplace_back();
+    bounds.fFirst = left;
+    bounds.fCount = 0;
+    fNodes[node]  = bounds;
+    FillNode(left, boxes, indices, begin, mid);
+    FillNode(left + 1, boxes, indices, mid, end);
+  }
+
+  void BuildVolume(vecgeom::LogicalVolume const *logical)
+  {
+    auto const &daughters = logical->GetDaughters();
+    const int n           = daughters.size();
+    if (n < fMinDaughters) return;
+
+    std::vector<Box_t> boxes;
+    boxes.reserve(n);
+    for (int i = 0; i < n; ++i)
+      boxes.push_back(DaughterBox(daughters[i]));
+    std::vector<int> indices(n);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    const int root = fNodes.size();
+    fNodes.emplace_back();
+    FillNode(root, boxes, indices, 0, n);
+    if (logical->id() >= fRoots.size()) fRoots.resize(logical->id() + 1, -1);
+    fRoots[logical->id()] = root;
+  }
+
+  void Collect(vecgeom::LogicalVolume const *logical, std::set<vecgeom::LogicalVolume const *> &visited)
+  {
+    if (!visited.insert(logical).second) return;
+    BuildVolume(logical);
+    for (auto *daughter : logical->GetDaughters())
+      Collect(daughter->GetLogicalVolume(), visited);
+  }
+
+public:
+  DaughterBVHBuilder(int minDaughters = 8, int leafSize = 4) : fMinDaughters(minDaughters), fLeafSize(leafSize) {}
+
+  DaughterBVHBuilder(const DaughterBVHBuilder &) = delete;
+  DaughterBVHBuilder &operator=(const DaughterBVHBuilder &) = delete;
+
+  ~DaughterBVHBuilder() { FreeDevice(); }
+
+  /** @brief Build the trees of all logical volumes below the world */
+  void Build(vecgeom::VPlacedVolume const *world)
+  {
+    fNodes.clear();
+    fDaughters.clear();
+    fRoots.clear();
+    std::set<vecgeom::LogicalVolume const *> visited;
+    Collect(world->GetLogicalVolume(), visited);
+  }
+
+  /** @brief Number of logical volumes having a tree */
+  int GetNumTrees() const { return std::count_if(fRoots.begin(), fRoots.end(), [](int root) { return root >= 0; }); }
+
+  int GetNumNodes() const { return fNodes.size(); }
+
+  /** @brief View of the trees in host memory, valid as long as the builder */
+  DaughterBVH HostView() const { return DaughterBVH(fNodes.data(), fDaughters.data(), fRoots.data(), fRoots.size()); }
+
+  /** @brief Copy the trees to device memory. The copy lives until FreeDevice() or the builder destruction. */
+  DaughterBVH Upload(sycl::queue &queue)
+  {
+    FreeDevice();
+    const size_t nodesSize     = sizeof(Node) * fNodes.size();
+    const size_t daughtersSize = sizeof(int) * fDaughters.size();
+    const size_t rootsSize     = sizeof(int) * fRoots.size();
+
+    if (nodesSize + daughtersSize + rootsSize == 0) return DaughterBVH();
+    fQueue        = &queue;
+    fDeviceBuffer = sycl::malloc_device<char>(nodesSize + daughtersSize + rootsSize, queue);
+    if (!fDeviceBuffer) COPCORE_EXCEPTION("DaughterBVHBuilder::Upload: cannot allocate device memory");
+    Node *nodes    = (Node *)fDeviceBuffer;
+    int *daughters = (int *)(fDeviceBuffer + nodesSize);
+    int *roots     = (int *)(fDeviceBuffer + nodesSize + daughtersSize);
+    if (nodesSize) queue.memcpy(nodes, fNodes.data(), nodesSize);
+    if (daughtersSize) queue.memcpy(daughters, fDaughters.data(), daughtersSize);
+    if (rootsSize) queue.memcpy(roots, fRoots.data(), rootsSize);
+    queue.wait_and_throw();
+    return DaughterBVH(nodes, daughters, roots, fRoots.size());
+  }
+
+  /** @brief Release the device copy */
+  void FreeDevice()
+  {
+    if (fDeviceBuffer) sycl::free(fDeviceBuffer, *fQueue);
+    fDeviceBuffer = nullptr;
+  }
+}; // End class DaughterBVHBuilder
+
+} // End namespace adept
+
+#endif // ADEPT_1DAUGHTERBVH_H_
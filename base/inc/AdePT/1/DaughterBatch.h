@@ -0,0 +1,366 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file DaughterBatch.h
+ * @brief Batched DistanceToIn for the box and tube daughters of logical volumes.
+ *
+ * @details For every logical volume with enough box or full tube daughters, the shape parameters and the
+ * transformations from the mother frame to the daughter frames are stored in blocks of kLanes daughters of
+ * the same kind, as structure of arrays. The transformations are stored as the affine map applied to the
+ * point, so that no inversion or dispatch on the volume type is needed at query time. The distances of a
+ * whole block are computed by loops of fixed length over the lanes, without branches, which the compiler
+ * vectorizes on the CPU backend. On devices each work-item evaluates the blocks of its own track. The
+ * daughters of other kinds are listed separately and left to VolumeDispatcher. The rotations, the shape
+ * parameters and the distances are of type adept::Real_t, single precision in mixed precision builds;
+ * the translations stay in double and the point is moved to the daughter frame in double.
+ */
+
+#ifndef ADEPT_1DAUGHTERBATCH_H_
+#define ADEPT_1DAUGHTERBATCH_H_
+
+#include <CL/sycl.hpp>
+
+#include <AdePT/1/Precision.h>
+#include <CopCore/1/Global.h>
+
+#include <VecGeom/base/Global.h>
+#include <VecGeom/base/Vector3D.h>
+#include <VecGeom/volumes/LogicalVolume.h>
+#include <VecGeom/volumes/PlacedVolume.h>
+#include <VecGeom/volumes/VolumeTypes.h>
+#include <VecGeom/volumes/Box.h>
+#include <VecGeom/volumes/Tube.h>
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <vector>
+
+namespace adept {
+
+/** @brief Structure of arrays of the box and tube daughters of all logical volumes */
+class DaughterBatch {
+public:
+  using Precision = vecgeom::Precision;
+  using Real_t    = adept::Real_t;
+  using Vector    = vecgeom::Vector3D<Precision>;
+
+  static constexpr int kLanes = 8; ///< Daughters per block: one AVX-512 or two AVX2 registers of doubles
+
+  /** @brief Distance of the daughters missed, mapped back to vecgeom::kInfLength for the caller */
+  static constexpr Real_t kInf = std::numeric_limits<Real_t>::max();
+
+  enum Kind : int { kBoxKind = 0, kTubeKind = 1 };
+
+  /** @brief Daughters of the same kind, lane i of every array belonging to the i-th daughter */
+  struct Block {
+    Real_t fM[9][kLanes];    ///< Rotation part of the map to the daughter frame, row-major
+    Precision fC[3][kLanes]; ///< Translation part of the map to the daughter frame
+    Real_t fP[3][kLanes];    ///< Box: half-lengths. Tube: outer radius, its square and half-length in z
+    int fIndex[kLanes];      ///< Index in the daughter list of the mother
+    int fKind;               ///< Kind of all daughters in the block
+    int fCount;              ///< Number of used lanes
+  };
+
+  /** @brief Blocks and other daughters of a logical volume */
+  struct Range {
+    int fFirstBlock; ///< -1 for volumes without batch
+    int fNumBlocks;
+    int fFirstOther; ///< Daughters not in the blocks, as entries in the other indices
+    int fNumOthers;
+  };
+
+private:
+  const Block *fBlocks{nullptr}; ///< Blocks of all volumes
+  const int *fOthers{nullptr};   ///< Indices of the daughters left to VolumeDispatcher
+  const Range *fRanges{nullptr}; ///< Range per logical volume id
+  int fNumVolumes{0};            ///< Size of fRanges
+
+  /** @brief Distances to the boxes of a block, negative for points inside as in VecGeom */
+  __host__ __device__ static void BoxDistances(Block const &block, Real_t const (&p)[3][kLanes],
+                                               Real_t const (&d)[3][kLanes], Real_t (&dist)[kLanes])
+  {
+    for (int l = 0; l < kLanes; ++l) {
+      Real_t tnear = -kInf, tfar = kInf;
+      for (int k = 0; k < 3; ++k) {
+        const Real_t inv = Real_t(1) / d[k][l];
+        Real_t t1        = (-block.fP[k][l] - p[k][l]) * inv;
+        Real_t t2        = (block.fP[k][l] - p[k][l]) * inv;
+        const Real_t lo  = t1 < t2 ? t1 : t2;
+        const Real_t hi  = t1 < t2 ? t2 : t1;
+        // NaNs from a point on the slab of a parallel ray compare false and leave the interval unchanged.
+        tnear = lo > tnear ? lo : tnear;
+        tfar  = hi < tfar ? hi : tfar;
+      }
+      const bool hit = tnear <= tfar && tfar > vecgeom::kHalfTolerance;
+      dist[l]        = hit ? tnear : kInf;
+    }
+  }
+
+  /** @brief Distances to the full tubes of a block, -1 for points inside */
+  __host__ __device__ static void TubeDistances(Block const &block, Real_t const (&p)[3][kLanes],
+                                                Real_t const (&d)[3][kLanes], Real_t (&dist)[kLanes])
+  {
+    for (int l = 0; l < kLanes; ++l) {
+      const Real_t rmax2 = block.fP[1][l];
+      const Real_t dz    = block.fP[2][l];
+      const Real_t r2    = p[0][l] * p[0][l] + p[1][l] * p[1][l];
+      const Real_t absz  = sycl::fabs(p[2][l]);
+
+      // Entering through the end cap facing the point.
+      const Real_t tz     = (absz - dz) / sycl::fabs(d[2][l]);
+      const Real_t xz     = p[0][l] + tz * d[0][l];
+      const Real_t yz     = p[1][l] + tz * d[1][l];
+      const bool towardsZ = p[2][l] * d[2][l] < 0;
+      const bool capHit   = absz > dz - vecgeom::kHalfTolerance && towardsZ && xz * xz + yz * yz <= rmax2;
+      const Real_t tcap   = capHit ? (tz > 0 ? tz : 0) : kInf;
+
+      // Entering through the outer surface.
+      const Real_t a     = d[0][l] * d[0][l] + d[1][l] * d[1][l];
+      const Real_t b     = p[0][l] * d[0][l] + p[1][l] * d[1][l];
+      const Real_t c     = r2 - rmax2;
+      const Real_t disc  = b * b - a * c;
+      const Real_t tr    = (-b - sycl::sqrt(disc > 0 ? disc : Real_t(0))) / a;
+      const Real_t zr    = p[2][l] + tr * d[2][l];
+      const bool sideHit = c > -vecgeom::kHalfTolerance && b < 0 && disc >= 0 && sycl::fabs(zr) <= dz;
+      const Real_t tside = sideHit ? (tr > 0 ? tr : 0) : kInf;
+
+      const bool inside = absz < dz - vecgeom::kHalfTolerance && c < -vecgeom::kHalfTolerance;
+      dist[l]           = inside ? Real_t(-1) : (tcap < tside ? tcap : tside);
+    }
+  }
+
+public:
+  DaughterBatch() = default;
+
+  DaughterBatch(const Block *blocks, const int *others, const Range *ranges, int numVolumes)
+      : fBlocks(blocks), fOthers(others), fRanges(ranges), fNumVolumes(numVolumes)
+  {
+  }
+
+  /** @brief Range of a logical volume, nullptr if the volume has no batch */
+  __host__ __device__ Range const *Find(unsigned int volumeId) const
+  {
+    if (volumeId >= (unsigned int)fNumVolumes || fRanges[volumeId].fFirstBlock < 0) return nullptr;
+    return &fRanges[volumeId];
+  }
+
+  /** @brief Index of the i-th daughter of the range to be handled one by one */
+  __host__ __device__ int Other(Range const &range, int i) const { return fOthers[range.fFirstOther + i]; }
+
+  /** @brief Calls visit(index, distance) with the DistanceToIn of all box and tube daughters of the range
+   *  @details point and dir are given in the frame of the mother. Daughters that are missed get kInfLength.
+   */
+  template <typename Visit>
+  __host__ __device__ void DistancesToIn(Range const &range, Vector const &point, Vector const &dir,
+                                         Visit &&visit) const
+  {
+    for (int b = range.fFirstBlock; b < range.fFirstBlock + range.fNumBlocks; ++b) {
+      Block const &block = fBlocks[b];
+
+      Real_t p[3][kLanes], d[3][kLanes], dist[kLanes];
+      for (int k = 0; k < 3; ++k) {
+        for (int l = 0; l < kLanes; ++l) {
+          p[k][l] = Real_t(block.fM[3 * k][l] * point[0] + block.fM[3 * k + 1][l] * point[1] +
+                           block.fM[3 * k + 2][l] * point[2] + block.fC[k][l]);
+          d[k][l] = Real_t(block.fM[3 * k][l] * dir[0] + block.fM[3 * k + 1][l] * dir[1] +
+                           block.fM[3 * k + 2][l] * dir[2]);
+        }
+      }
+
+      if (block.fKind == kBoxKind)
+        BoxDistances(block, p, d, dist);
+      else
+        TubeDistances(block, p, d, dist);
+
+      for (int l = 0; l < block.fCount; ++l)
+        visit(block.fIndex[l], dist[l] < kInf ? Precision(dist[l]) : vecgeom::kInfLength);
+    }
+  }
+}; // End class DaughterBatch
+
+/** @brief Builds the DaughterBatch of a geometry on the host and uploads it to the device */
+class DaughterBatchBuilder {
+  using Block     = DaughterBatch::Block;
+  using Range     = DaughterBatch::Range;
+  using Precision = vecgeom::Precision;
+  using Vector    = vecgeom::Vector3D<Precision>;
+
+  int fMinDaughters;            ///< Volumes with fewer box and tube daughters are not batched
+  std::vector<Block> fBlocks;   ///< Blocks of all volumes
+  std::vector<int> fOthers;     ///< Daughters left to VolumeDispatcher
+  std::vector<Range> fRanges;   ///< Range per logical volume id
+
+  sycl::queue *fQueue{nullptr}; ///< Queue of the device copy
+  char *fDeviceBuffer{nullptr}; ///< Device copy of the three arrays
+
+  /** @brief Kind of a daughter, -1 if it cannot be batched */
+  static int KindOf(vecgeom::VPlacedVolume const *daughter)
+  {
+    switch (daughter->GetType()) {
+    case vecgeom::VolumeTypes::kBox:
+      return DaughterBatch::kBoxKind;
+    case vecgeom::VolumeTypes::kTube: {
+      auto const &tube = *static_cast<const vecgeom::PlacedTube *>(daughter)->GetUnplacedStruct();
+      // Only full cylinders: hollow tubes and phi sections keep the generic implementation.
+      if (tube.fRmin == 0 && tube.fDphi >= vecgeom::kTwoPi) return DaughterBatch::kTubeKind;
+      return -1;
+    }
+    default:
+      return -1;
+    }
+  }
+
+  /** @brief Store daughter in the lane of block */
+  static void FillLane(Block &block, int lane, int index, vecgeom::VPlacedVolume const *daughter)
+  {
+    // Read the affine map off the transformation rather than relying on its storage convention.
+    auto const *tr = daughter->GetTransformation();
+    Vector origin  = tr->Transform(Vector(0, 0, 0));
+    for (int i = 0; i < 3; ++i) {
+      Vector axis(i == 0, i == 1, i == 2);
+      Vector column = tr->TransformDirection(axis);
+      for (int k = 0; k < 3; ++k)
+        block.fM[3 * k + i][lane] = column[k];
+    }
+    for (int k = 0; k < 3; ++k)
+      block.fC[k][lane] = origin[k];
+
+    if (block.fKind == DaughterBatch::kBoxKind) {
+      auto const &box = *static_cast<const vecgeom::PlacedBox *>(daughter)->GetUnplacedStruct();
+      for (int k = 0; k < 3; ++k)
+        block.fP[k][lane] = box.fDimensions[k];
+    } else {
+      auto const &tube  = *static_cast<const vecgeom::PlacedTube *>(daughter)->GetUnplacedStruct();
+      block.fP[0][lane] = tube.fRmax;
+      block.fP[1][lane] = tube.fRmax * tube.fRmax;
+      block.fP[2][lane] = tube.fZ;
+    }
+    block.fIndex[lane] = index;
+  }
+
+  /** @brief An empty block, whose unused lanes hold a point-like box at the origin and are never visited */
+  static Block MakeBlock(int kind)
+  {
+    Block block;
+    block.fKind  = kind;
+    block.fCount = 0;
+    for (int l = 0; l < DaughterBatch::kLanes; ++l) {
+      for (int k = 0; k < 9; ++k)
+        block.fM[k][l] = (k % 4 == 0);
+      for (int k = 0; k < 3; ++k) {
+        block.fC[k][l] = 0;
+        block.fP[k][l] = 0;
+      }
+      block.fIndex[l] = -1;
+    }
+    return block;
+  }
+
+  void BuildVolume(vecgeom::LogicalVolume const *logical)
+  {
+    auto const &daughters = logical->GetDaughters();
+    const int n           = daughters.size();
+
+    std::vector<int> byKind[2], others;
+    for (int i = 0; i < n; ++i) {
+      const int kind = KindOf(daughters[i]);
+      if (kind < 0)
+        others.push_back(i);
+      else
+        byKind[kind].push_back(i);
+    }
+    if ((int)(byKind[0].size() + byKind[1].size()) < fMinDaughters) return;
+
+    Range range{(int)fBlocks.size(), 0, (int)fOthers.size(), (int)others.size()};
+    for (int kind = 0; kind < 2; ++kind) {
+      for (size_t i = 0; i < byKind[kind].size(); ++i) {
+        const int lane = i % DaughterBatch::kLanes;
+        if (lane == 0) {
+          fBlocks.push_back(MakeBlock(kind));
+          range.fNumBlocks++;
+        }
+        FillLane(fBlocks.back(), lane, byKind[kind][i], daughters[byKind[kind][i]]);
+        fBlocks.back().fCount = lane + 1;
+      }
+    }
+    fOthers.insert(fOthers.end(), others.begin(), others.end());
+
+    if (logical->id() >= fRanges.size()) fRanges.resize(logical->id() + 1, Range{-1, 0, 0, 0});
+    fRanges[logical->id()] = range;
+  }
+
+  void Collect(vecgeom::LogicalVolume const *logical, std::set<vecgeom::LogicalVolume const *> &visited)
+  {
+    if (!visited.insert(logical).second) return;
+    BuildVolume(logical);
+    for (auto *daughter : logical->GetDaughters())
+      Collect(daughter->GetLogicalVolume(), visited);
+  }
+
+public:
+  DaughterBatchBuilder(int minDaughters = 2) : fMinDaughters(minDaughters) {}
+
+  DaughterBatchBuilder(const DaughterBatchBuilder &) = delete;
+  DaughterBatchBuilder &operator=(const DaughterBatchBuilder &) = delete;
+
+  ~DaughterBatchBuilder() { FreeDevice(); }
+
+  /** @brief Build the blocks of all logical volumes below the world */
+  void Build(vecgeom::VPlacedVolume const *world)
+  {
+    fBlocks.clear();
+    fOthers.clear();
+    fRanges.clear();
+    std::set<vecgeom::LogicalVolume const *> visited;
+    Collect(world->GetLogicalVolume(), visited);
+  }
+
+  /** @brief Number of logical volumes having blocks */
+  int GetNumVolumes() const
+  {
+    return std::count_if(fRanges.begin(), fRanges.end(), [](Range const &range) { return range.fFirstBlock >= 0; });
+  }
+
+  int GetNumBlocks() const { return fBlocks.size(); }
+
+  /** @brief View of the blocks in host memory, valid as long as the builder */
+  DaughterBatch HostView() const
+  {
+    return DaughterBatch(fBlocks.data(), fOthers.data(), fRanges.data(), fRanges.size());
+  }
+
+  /** @brief Copy the blocks to device memory. The copy lives until FreeDevice() or the builder destruction. */
+  DaughterBatch Upload(sycl::queue &queue)
+  {
+    FreeDevice();
+    const size_t blocksSize = sizeof(Block) * fBlocks.size();
+    const size_t othersSize = sizeof(int) * fOthers.size();
+    const size_t rangesSize = sizeof(Range) * fRanges.size();
+
+    if (blocksSize + othersSize + rangesSize == 0) return DaughterBatch();
+    fQueue        = &queue;
+    fDeviceBuffer = sycl::malloc_device<char>(blocksSize + othersSize + rangesSize, queue);
+    if (!fDeviceBuffer) COPCORE_EXCEPTION("DaughterBatchBuilder::Upload: cannot allocate device memory");
+    Block *blocks = (Block *)fDeviceBuffer;
+    int *others   = (int *)(fDeviceBuffer + blocksSize);
+    Range *ranges = (Range *)(fDeviceBuffer + blocksSize + othersSize);
+    if (blocksSize) queue.memcpy(blocks, fBlocks.data(), blocksSize);
+    if (othersSize) queue.memcpy(others, fOthers.data(), othersSize);
+    if (rangesSize) queue.memcpy(ranges, fRanges.data(), rangesSize);
+    queue.wait_and_throw();
+    return DaughterBatch(blocks, others, ranges, fRanges.size());
+  }
+
+  /** @brief Release the device copy */
+  void FreeDevice()
+  {
+    if (fDeviceBuffer) sycl::free(fDeviceBuffer, *fQueue);
+    fDeviceBuffer = nullptr;
+  }
+}; // End class DaughterBatchBuilder
+
+} // End namespace adept
+
+#endif // ADEPT_1DAUGHTERBATCH_H_
@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file DeviceScan.h
+ * @brief Device-wide exclusive prefix sum.
+ *
+ * @details Three kernels: each work-group scans its part of the input and stores its total, a single
+ * work-group scans the totals, and the scanned totals are added to the elements of each work-group.
+ * Used to compute destination offsets for stable stream compaction.
+ */
+
+#ifndef ADEPT_1DEVICESCAN_H_
+#define ADEPT_1DEVICESCAN_H_
+
+#include <CL/sycl.hpp>
+#include <vector>
+
+namespace adept {
+
+/** @brief Device-wide exclusive scan of int arrays */
+class DeviceScan {
+public:
+  static constexpr int kBlockSize = 256; ///< Work-group size
+
+  /** @brief Number of ints of scratch memory needed to scan n elements */
+  static int ScratchSize(int n) { return (n + kBlockSize - 1) / kBlockSize; }
+
+  /** @brief Asynchronous exclusive scan of in[0, n) into out[0, n). The input and output may coincide.
+   *  @param scratch Device memory holding at least ScratchSize(n) ints
+   *  @returns Event of the last kernel
+   */
+  static sycl::event ExclusiveScan(sycl::queue &queue, const int *in, int *out, int n, int *scratch,
+                                   std::vector<sycl::event> const &deps = {})
+  {
+    if (n <= 0) return queue.submit([&](sycl::handler &cgh) {
+      cgh.depends_on(deps);
+      cgh.single_task([]() {});
+    });
+    const int nblocks = ScratchSize(n);
+    const sycl::nd_range<1> range(nblocks * kBlockSize, kBlockSize);
+
+    // Scan inside each work-group, keeping the totals
+    auto scanBlocks = queue.submit([&](sycl::handler &cgh) {
+      cgh.depends_on(deps);
+      cgh.parallel_for(range, [=](sycl::nd_item<1> item) {
+        const int i = item.get_global_id(0);
+        const int v = (i < n) ? in[i] : 0;
+        const int s = sycl::exclusive_scan_over_group(item.get_group(), v, sycl::plus<int>());
+        if (i < n) out[i] = s;
+        if (item.get_local_id(0) == kBlockSize - 1) scratch[item.get_group(0)] = s + v;
+      });
+    });
+
+    // Scan the work-group totals with a single work-group
+    auto scanTotals = queue.submit([&](sycl::handler &cgh) {
+      cgh.depends_on(scanBlocks);
+      cgh.parallel_for(sycl::nd_range<1>(kBlockSize, kBlockSize), [=](sycl::nd_item<1> item) {
+        auto group = item.get_group();
+        int carry  = 0;
+        for (int first = 0; first < nblocks; first += kBlockSize) {
+          const int j     = first + item.get_local_id(0);
+          const int v     = (j < nblocks) ? scratch[j] : 0;
+          const int s     = sycl::exclusive_scan_over_group(group, v, sycl::plus<int>());
+          const int total = sycl::reduce_over_group(group, v, sycl::plus<int>());
+          if (j < nblocks) scratch[j] = s + carry;
+          carry += total;
+        }
+      });
+    });
+
+    // Add the offset of each work-group
+    return queue.submit([&](sycl::handler &cgh) {
+      cgh.depends_on(scanTotals);
+      cgh.parallel_for(range, [=](sycl::nd_item<1> item) {
+        const int i = item.get_global_id(0);
+        if (i < n) out[i] += scratch[item.get_group(0)];
+      });
+    });
+  }
+}; // End class DeviceScan
+
+} // End namespace adept
+
+#endif // ADEPT_1DEVICESCAN_H_
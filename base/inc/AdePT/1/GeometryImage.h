@@ -0,0 +1,480 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file GeometryImage.h
+ * @brief Flat, pointer-free image of a VecGeom geometry.
+ *
+ * @details The image stores the logical volumes (shape and range of daughters), the placed volumes (logical
+ * volume and transformation), the daughter lists and the navigation index table in a single contiguous
+ * buffer. All references are indices and all arrays are located by offsets from the start of the buffer,
+ * so that the image can be copied as is and read in place through a GeometryImageView. An image read from a
+ * file rebuilds the VecGeom geometry with Instantiate(), which skips the GDML parsing on repeated runs, and
+ * checks that the rebuilt geometry has the stored navigation index table: the navigation states kept by the
+ * tracks are indices in that table.
+ *
+ * Upload() copies the image to device memory in a single USM copy. The view then locates points in place,
+ * giving the navigation index of the deepest volume containing them, on any backend and without the VecGeom
+ * device geometry. The navigation in the transport kernels still goes through VecGeom. Only the shapes
+ * supported by VolumeDispatcher (box, trd and tube) can be stored.
+ */
+
+#ifndef ADEPT_1GEOMETRYIMAGE_H_
+#define ADEPT_1GEOMETRYIMAGE_H_
+
+#include <CL/sycl.hpp>
+
+#include <CopCore/1/Global.h>
+
+#include <VecGeom/base/Global.h>
+#include <VecGeom/base/Transformation3D.h>
+#include <VecGeom/management/GeoManager.h>
+#include <VecGeom/management/NavIndexTable.h>
+#include <VecGeom/volumes/LogicalVolume.h>
+#include <VecGeom/volumes/PlacedVolume.h>
+#include <VecGeom/volumes/VolumeTypes.h>
+#include <VecGeom/volumes/Box.h>
+#include <VecGeom/volumes/Trd.h>
+#include <VecGeom/volumes/Tube.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace adept {
+
+/** @brief Layout of the image buffer */
+struct GeometryImageLayout {
+  static constexpr char kMagic[8] = {'A', 'D', 'E', 'P', 'T', 'G', 'E', 'O'};
+  static constexpr int kVersion   = 1; ///< To be increased with every change of the layout
+
+  enum Shape : int { kBoxShape = 0, kTrdShape = 1, kTubeShape = 2 };
+
+  struct Header {
+    char fMagic[8];
+    int fVersion;
+    int fNumLogical;                ///< Number of logical volumes
+    int fNumPlaced;                 ///< Number of placed volumes, the world being the first one
+    int fNumDaughters;              ///< Total length of the daughter lists
+    unsigned long fNumNavIndex;     ///< Number of entries of the navigation index table, 0 if not stored
+    unsigned long fLogicalOffset;   ///< Offsets of the arrays from the start of the image
+    unsigned long fPlacedOffset;
+    unsigned long fDaughtersOffset;
+    unsigned long fNavIndexOffset;
+    unsigned long fSize;            ///< Size of the whole image in bytes
+  };
+
+  struct Logical {
+    int fShape;         ///< One of Shape
+    int fFirstDaughter; ///< Start of the daughters in the daughter lists
+    int fNumDaughters;
+    int fId;            ///< Id of the logical volume in the geometry the image was taken from
+    double fParams[5];  ///< Box: dx, dy, dz. Trd: dx1, dx2, dy1, dy2, dz. Tube: rmin, rmax, dz, sphi, dphi
+  };
+
+  struct Placed {
+    int fLogical;           ///< Index of the logical volume
+    int fId;                ///< Id of the placed volume in the geometry the image was taken from
+    double fTranslation[3]; ///< Transformation3D translation
+    double fRotation[9];    ///< Transformation3D rotation, in its own storage order
+  };
+};
+
+/** @brief Read-only access to an image in place */
+class GeometryImageView {
+  using Layout = GeometryImageLayout;
+
+  const char *fBase{nullptr}; ///< Start of the image
+
+  __host__ __device__ Layout::Header const &Head() const { return *(Layout::Header const *)fBase; }
+
+public:
+  GeometryImageView() = default;
+
+  __host__ __device__ GeometryImageView(const char *base) : fBase(base) {}
+
+  __host__ __device__ int GetNumLogical() const { return Head().fNumLogical; }
+
+  __host__ __device__ int GetNumPlaced() const { return Head().fNumPlaced; }
+
+  __host__ __device__ unsigned long GetNumNavIndex() const { return Head().fNumNavIndex; }
+
+  __host__ __device__ Layout::Logical const &Logical(int i) const
+  {
+    return ((Layout::Logical const *)(fBase + Head().fLogicalOffset))[i];
+  }
+
+  __host__ __device__ Layout::Placed const &Placed(int i) const
+  {
+    return ((Layout::Placed const *)(fBase + Head().fPlacedOffset))[i];
+  }
+
+  /** @brief Placed volume index of the i-th daughter of a logical volume */
+  __host__ __device__ int Daughter(Layout::Logical const &logical, int i) const
+  {
+    return ((int const *)(fBase + Head().fDaughtersOffset))[logical.fFirstDaughter + i];
+  }
+
+  /** @brief The navigation index table, nullptr if the image has none */
+  __host__ __device__ vecgeom::NavIndex_t const *NavIndex() const
+  {
+    if (Head().fNumNavIndex == 0) return nullptr;
+    return (vecgeom::NavIndex_t const *)(fBase + Head().fNavIndexOffset);
+  }
+
+  __host__ __device__ unsigned long GetSize() const { return Head().fSize; }
+
+  __host__ __device__ bool Enabled() const { return fBase != nullptr; }
+
+  /** @brief Transformation from the frame of the mother to the one of a placed volume */
+  __host__ __device__ static vecgeom::Transformation3D Transformation(Layout::Placed const &placed)
+  {
+    const double *t = placed.fTranslation;
+    const double *r = placed.fRotation;
+    return vecgeom::Transformation3D(t[0], t[1], t[2], r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], r[8]);
+  }
+
+  /** @brief Whether the shape of a logical volume contains a point in its frame, surface included */
+  __host__ __device__ static bool Contains(Layout::Logical const &logical,
+                                           vecgeom::Vector3D<vecgeom::Precision> const &point)
+  {
+    const double *p = logical.fParams;
+    switch (logical.fShape) {
+    case Layout::kBoxShape:
+      return std::abs(point[0]) <= p[0] && std::abs(point[1]) <= p[1] && std::abs(point[2]) <= p[2];
+    case Layout::kTrdShape: {
+      if (std::abs(point[2]) > p[4]) return false;
+      const double f = (point[2] + p[4]) / (2 * p[4]);
+      return std::abs(point[0]) <= p[0] + f * (p[1] - p[0]) && std::abs(point[1]) <= p[2] + f * (p[3] - p[2]);
+    }
+    case Layout::kTubeShape: {
+      const double r2 = point[0] * point[0] + point[1] * point[1];
+      if (std::abs(point[2]) > p[2] || r2 < p[0] * p[0] || r2 > p[1] * p[1]) return false;
+      if (p[4] >= vecgeom::kTwoPi) return true;
+      double phi = std::atan2(point[1], point[0]) - p[3];
+      while (phi < 0)
+        phi += vecgeom::kTwoPi;
+      while (phi >= vecgeom::kTwoPi)
+        phi -= vecgeom::kTwoPi;
+      return phi <= p[4];
+    }
+    }
+    return false;
+  }
+
+  /** @brief Navigation index of the deepest volume containing the global point, 0 if the point is outside
+   *  of the world or if the image has no navigation index table. Uses the image only. */
+  __host__ __device__ vecgeom::NavIndex_t LocatePoint(vecgeom::Vector3D<vecgeom::Precision> const &globalpoint) const
+  {
+    vecgeom::NavIndex_t const *table = NavIndex();
+    if (table == nullptr) return 0;
+    const unsigned long size = GetNumNavIndex();
+
+    Layout::Placed const *current = &Placed(0);
+    auto point                    = Transformation(*current).Transform(globalpoint);
+    if (!Contains(Logical(current->fLogical), point)) return 0;
+
+    // The navigation index of the d-th daughter of the state at nav is stored at nav + 3 + d.
+    vecgeom::NavIndex_t nav = 1;
+    for (bool descended = true; descended;) {
+      descended           = false;
+      auto const &logical = Logical(current->fLogical);
+      for (int d = 0; d < logical.fNumDaughters; ++d) {
+        Layout::Placed const &daughter = Placed(Daughter(logical, d));
+        const auto local               = Transformation(daughter).Transform(point);
+        if (!Contains(Logical(daughter.fLogical), local)) continue;
+        if (nav + 3 + d >= size) return 0;
+        nav       = table[nav + 3 + d];
+        current   = &daughter;
+        point     = local;
+        descended = true;
+        break;
+      }
+    }
+    return nav;
+  }
+};
+
+/** @brief Owner of an image, built from a geometry or read from a file */
+class GeometryImage {
+  using Layout = GeometryImageLayout;
+
+  std::vector<char> fBuffer;    ///< The image
+  sycl::queue *fQueue{nullptr}; ///< Queue of the device copy
+  char *fDeviceBuffer{nullptr}; ///< Device copy of the image
+
+  static size_t Align(size_t offset) { return (offset + 7) & ~size_t(7); }
+
+  /** @brief Record of a logical volume, false if its shape cannot be stored */
+  static bool MakeLogical(vecgeom::LogicalVolume const *logical, Layout::Logical &record)
+  {
+    record               = Layout::Logical{};
+    record.fId           = logical->id();
+    auto const *unplaced = logical->GetUnplacedVolume();
+    if (auto const *box = dynamic_cast<vecgeom::UnplacedBox const *>(unplaced)) {
+      record.fShape     = Layout::kBoxShape;
+      record.fParams[0] = box->x();
+      record.fParams[1] = box->y();
+      record.fParams[2] = box->z();
+    } else if (auto const *trd = dynamic_cast<vecgeom::UnplacedTrd const *>(unplaced)) {
+      record.fShape     = Layout::kTrdShape;
+      record.fParams[0] = trd->dx1();
+      record.fParams[1] = trd->dx2();
+      record.fParams[2] = trd->dy1();
+      record.fParams[3] = trd->dy2();
+      record.fParams[4] = trd->dz();
+    } else if (auto const *tube = dynamic_cast<vecgeom::UnplacedTube const *>(unplaced)) {
+      record.fShape     = Layout::kTubeShape;
+      record.fParams[0] = tube->rmin();
+      record.fParams[1] = tube->rmax();
+      record.fParams[2] = tube->z();
+      record.fParams[3] = tube->sphi();
+      record.fParams[4] = tube->dphi();
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  static vecgeom::Transformation3D *MakeTransformation(Layout::Placed const &placed)
+  {
+    return new vecgeom::Transformation3D(GeometryImageView::Transformation(placed));
+  }
+
+  static Layout::Placed MakePlaced(vecgeom::VPlacedVolume const *pvol, int logical)
+  {
+    Layout::Placed record{};
+    record.fLogical = logical;
+    record.fId      = pvol->id();
+    auto const *tr  = pvol->GetTransformation();
+    for (int k = 0; k < 3; ++k)
+      record.fTranslation[k] = tr->Translation(k);
+    for (int k = 0; k < 9; ++k)
+      record.fRotation[k] = tr->Rotation(k);
+    return record;
+  }
+
+  static vecgeom::VUnplacedVolume const *MakeShape(Layout::Logical const &logical)
+  {
+    const double *p = logical.fParams;
+    switch (logical.fShape) {
+    case Layout::kBoxShape:
+      return vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(p[0], p[1], p[2]);
+    case Layout::kTrdShape:
+      return vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedTrd>(p[0], p[1], p[2], p[3], p[4]);
+    case Layout::kTubeShape:
+      return vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedTube>(p[0], p[1], p[2], p[3], p[4]);
+    default:
+      COPCORE_EXCEPTION("GeometryImage: unknown shape");
+    }
+    return nullptr;
+  }
+
+  /** @brief Whether count elements of the given size at offset lie within an image of the given size */
+  static bool InImage(unsigned long offset, unsigned long count, size_t elementSize, unsigned long size)
+  {
+    return offset >= sizeof(Layout::Header) && offset % 8 == 0 && offset <= size &&
+           count <= (size - offset) / elementSize;
+  }
+
+  /** @brief Whether all the arrays of the image lie within it and all its indices are in range */
+  static bool IsValid(GeometryImageView const &view, Layout::Header const &header)
+  {
+    if (header.fNumLogical < 1 || header.fNumPlaced < 1 || header.fNumDaughters < 0) return false;
+    if (!InImage(header.fLogicalOffset, header.fNumLogical, sizeof(Layout::Logical), header.fSize) ||
+        !InImage(header.fPlacedOffset, header.fNumPlaced, sizeof(Layout::Placed), header.fSize) ||
+        !InImage(header.fDaughtersOffset, header.fNumDaughters, sizeof(int), header.fSize) ||
+        !InImage(header.fNavIndexOffset, header.fNumNavIndex, sizeof(vecgeom::NavIndex_t), header.fSize))
+      return false;
+
+    for (int i = 0; i < header.fNumLogical; ++i) {
+      auto const &logical = view.Logical(i);
+      if (logical.fShape < Layout::kBoxShape || logical.fShape > Layout::kTubeShape) return false;
+      if (logical.fFirstDaughter < 0 || logical.fNumDaughters < 0 ||
+          logical.fFirstDaughter > header.fNumDaughters - logical.fNumDaughters)
+        return false;
+      for (int d = 0; d < logical.fNumDaughters; ++d) {
+        const int daughter = view.Daughter(logical, d);
+        if (daughter < 1 || daughter >= header.fNumPlaced) return false;
+      }
+    }
+    for (int i = 0; i < header.fNumPlaced; ++i) {
+      if (view.Placed(i).fLogical < 0 || view.Placed(i).fLogical >= header.fNumLogical) return false;
+    }
+    return true;
+  }
+
+public:
+  GeometryImage() = default;
+
+  GeometryImage(const GeometryImage &) = delete;
+  GeometryImage &operator=(const GeometryImage &) = delete;
+
+  ~GeometryImage() { FreeDevice(); }
+
+  /** @brief Take the image of the geometry below world, with the navigation index table if there is one.
+   *  Returns false, leaving the image empty, if the geometry has shapes that cannot be stored. */
+  bool Build(vecgeom::VPlacedVolume const *world)
+  {
+    fBuffer.clear();
+    // Number the logical volumes and the distinct placed volumes, the world first.
+    std::vector<vecgeom::LogicalVolume const *> logicals;
+    std::map<vecgeom::LogicalVolume const *, int> logicalIndex;
+    std::vector<Layout::Placed> placed;
+    std::vector<int> daughterLists;
+
+    auto indexOf = [&](vecgeom::LogicalVolume const *logical) {
+      auto it = logicalIndex.find(logical);
+      if (it != logicalIndex.end()) return it->second;
+      logicalIndex[logical] = logicals.size();
+      logicals.push_back(logical);
+      return (int)logicals.size() - 1;
+    };
+
+    placed.push_back(MakePlaced(world, indexOf(world->GetLogicalVolume())));
+    std::vector<Layout::Logical> logicalRecords;
+    for (size_t i = 0; i < logicals.size(); ++i) {
+      Layout::Logical record;
+      if (!MakeLogical(logicals[i], record)) return false;
+      record.fFirstDaughter = daughterLists.size();
+      record.fNumDaughters   = logicals[i]->GetDaughters().size();
+      for (auto *daughter : logicals[i]->GetDaughters()) {
+        daughterLists.push_back(placed.size());
+        placed.push_back(MakePlaced(daughter, indexOf(daughter->GetLogicalVolume())));
+      }
+      logicalRecords.push_back(record);
+    }
+
+    // The table size is given in bytes.
+    auto *navTable                      = vecgeom::NavIndexTable::Instance();
+    const vecgeom::NavIndex_t *navIndex = navTable->GetTable();
+    const size_t numNavIndex            = navIndex ? navTable->GetTableSize() / sizeof(vecgeom::NavIndex_t) : 0;
+
+    Layout::Header header{};
+    std::memcpy(header.fMagic, Layout::kMagic, sizeof(header.fMagic));
+    header.fVersion         = Layout::kVersion;
+    header.fNumLogical      = logicalRecords.size();
+    header.fNumPlaced       = placed.size();
+    header.fNumDaughters    = daughterLists.size();
+    header.fNumNavIndex     = numNavIndex;
+    header.fLogicalOffset   = Align(sizeof(Layout::Header));
+    header.fPlacedOffset    = Align(header.fLogicalOffset + sizeof(Layout::Logical) * logicalRecords.size());
+    header.fDaughtersOffset = Align(header.fPlacedOffset + sizeof(Layout::Placed) * placed.size());
+    header.fNavIndexOffset  = Align(header.fDaughtersOffset + sizeof(int) * daughterLists.size());
+    header.fSize            = Align(header.fNavIndexOffset + sizeof(vecgeom::NavIndex_t) * numNavIndex);
+
+    fBuffer.assign(header.fSize, 0);
+    std::memcpy(fBuffer.data(), &header, sizeof(header));
+    std::memcpy(fBuffer.data() + header.fLogicalOffset, logicalRecords.data(),
+                sizeof(Layout::Logical) * logicalRecords.size());
+    std::memcpy(fBuffer.data() + header.fPlacedOffset, placed.data(), sizeof(Layout::Placed) * placed.size());
+    std::memcpy(fBuffer.data() + header.fDaughtersOffset, daughterLists.data(), sizeof(int) * daughterLists.size());
+    if (numNavIndex)
+      std::memcpy(fBuffer.data() + header.fNavIndexOffset, navIndex, sizeof(vecgeom::NavIndex_t) * numNavIndex);
+    return true;
+  }
+
+  bool Empty() const { return fBuffer.empty(); }
+
+  /** @brief Access to the image in host memory, valid as long as the image is not rebuilt */
+  GeometryImageView HostView() const { return GeometryImageView(fBuffer.data()); }
+
+  /** @brief Copy the image to device memory at once. The copy lives until FreeDevice() or the image
+   *  destruction. An empty image gives a disabled view. */
+  GeometryImageView Upload(sycl::queue &queue)
+  {
+    FreeDevice();
+    if (Empty()) return GeometryImageView();
+    fQueue        = &queue;
+    fDeviceBuffer = sycl::malloc_device<char>(fBuffer.size(), queue);
+    if (!fDeviceBuffer) COPCORE_EXCEPTION("GeometryImage::Upload: cannot allocate device memory");
+    queue.memcpy(fDeviceBuffer, fBuffer.data(), fBuffer.size()).wait_and_throw();
+    return GeometryImageView(fDeviceBuffer);
+  }
+
+  /** @brief Release the device copy */
+  void FreeDevice()
+  {
+    if (fDeviceBuffer) sycl::free(fDeviceBuffer, *fQueue);
+    fDeviceBuffer = nullptr;
+  }
+
+  /** @brief Write the image to a file */
+  bool Save(std::string const &filename) const
+  {
+    if (Empty()) return false;
+    std::ofstream out(filename, std::ios::binary);
+    out.write(fBuffer.data(), fBuffer.size());
+    return out.good();
+  }
+
+  /** @brief Read an image from a file, checking its format version and its consistency */
+  bool Load(std::string const &filename)
+  {
+    fBuffer.clear();
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    const std::streamoff fileSize = in.tellg();
+    in.seekg(0);
+
+    // The size in the header must be the one of the file, which bounds all the offsets checked below.
+    Layout::Header header;
+    if (!in.read((char *)&header, sizeof(header))) return false;
+    if (std::memcmp(header.fMagic, Layout::kMagic, sizeof(header.fMagic)) != 0 || header.fVersion != Layout::kVersion)
+      return false;
+    if (header.fSize < sizeof(header) || header.fSize != (unsigned long)fileSize) return false;
+
+    fBuffer.resize(header.fSize);
+    std::memcpy(fBuffer.data(), &header, sizeof(header));
+    if (!in.read(fBuffer.data() + sizeof(header), header.fSize - sizeof(header)) || !IsValid(HostView(), header)) {
+      fBuffer.clear();
+      return false;
+    }
+    return true;
+  }
+
+  /** @brief Build the VecGeom geometry described by the image and close it. Returns the world. */
+  vecgeom::VPlacedVolume const *Instantiate() const
+  {
+    if (Empty()) return nullptr;
+    const GeometryImageView view = HostView();
+
+    std::vector<vecgeom::LogicalVolume *> logicals(view.GetNumLogical());
+    for (int i = 0; i < view.GetNumLogical(); ++i) {
+      const std::string name = "lv" + std::to_string(view.Logical(i).fId);
+      logicals[i]            = new vecgeom::LogicalVolume(name.c_str(), MakeShape(view.Logical(i)));
+    }
+
+    // Place the daughters in their original order, to find the same navigation indices again.
+    for (int i = 0; i < view.GetNumLogical(); ++i) {
+      auto const &logical = view.Logical(i);
+      for (int d = 0; d < logical.fNumDaughters; ++d) {
+        auto const &daughter   = view.Placed(view.Daughter(logical, d));
+        const std::string name = "pv" + std::to_string(daughter.fId);
+        logicals[i]->PlaceDaughter(name.c_str(), logicals[daughter.fLogical], MakeTransformation(daughter));
+      }
+    }
+
+    auto const *world = logicals[view.Placed(0).fLogical]->Place("world", MakeTransformation(view.Placed(0)));
+    vecgeom::GeoManager::Instance().SetWorldAndClose(world);
+
+    // The navigation states refer to the table by offsets, so it has to be the stored one.
+    auto const *navTable                    = vecgeom::NavIndexTable::Instance();
+    const vecgeom::NavIndex_t *rebuiltIndex = navTable->GetTable();
+    const size_t storedSize                 = view.GetNumNavIndex() * sizeof(vecgeom::NavIndex_t);
+    if (storedSize != 0 && (rebuiltIndex == nullptr || navTable->GetTableSize() != storedSize ||
+                            std::memcmp(rebuiltIndex, view.NavIndex(), storedSize) != 0))
+      COPCORE_EXCEPTION("GeometryImage::Instantiate: navigation index table differs from the stored one");
+
+    return vecgeom::GeoManager::Instance().GetWorld();
+  }
+
+  size_t GetSize() const { return fBuffer.size(); }
+}; // End class GeometryImage
+
+} // End namespace adept
+
+#endif // ADEPT_1GEOMETRYIMAGE_H_
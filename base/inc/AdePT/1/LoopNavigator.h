@@ -9,6 +9,9 @@
 #ifndef RT_LOOP_NAVIGATOR_H_
 #define RT_LOOP_NAVIGATOR_H_
 
+#include <AdePT/1/DaughterBatch.h>
+#include <AdePT/1/DaughterBVH.h>
+#include <AdePT/1/RelocationCache.h>
 #include <AdePT/1/VolumeDispatcher.h>
 
 #include <CopCore/1/Global.h>
@@ -32,10 +35,16 @@ class LoopNavigator {
 public:
   using VPlacedVolumePtr_t = vecgeom::VPlacedVolume const *;
 
+  // All queries take an optional DaughterBVH: the daughters of the volumes
+  // having a tree are then searched through it instead of one after the other.
+  // The step computations also take an optional DaughterBatch, used for the
+  // volumes without tree to compute the distances to box and tube daughters
+  // a block at a time.
   __host__ __device__
   static VPlacedVolumePtr_t LocatePointIn(vecgeom::VPlacedVolume const *vol,
                                           vecgeom::Vector3D<vecgeom::Precision> const &point,
-                                          vecgeom::NavStateIndex &path, bool top)
+                                          vecgeom::NavStateIndex &path, bool top,
+                                          adept::DaughterBVH const *bvh = nullptr)
   {
     if (top) {
       assert(vol != nullptr);
@@ -48,15 +57,26 @@ public:
 
     bool godeeper;
     do {
-      godeeper = false;
-      for (auto *daughter : currentvolume->GetDaughters()) {
+      godeeper       = false;
+      auto enterIfIn = [&](VPlacedVolumePtr_t daughter) {
         vecgeom::Vector3D<vecgeom::Precision> transformedpoint;
-        if (VolumeDispatcher::Contains(daughter, currentpoint, transformedpoint)) {
-          path.Push(daughter);
-          currentpoint  = transformedpoint;
-          currentvolume = daughter;
-          godeeper      = true;
-          break;
+        if (!VolumeDispatcher::Contains(daughter, currentpoint, transformedpoint)) return false;
+        path.Push(daughter);
+        currentpoint  = transformedpoint;
+        currentvolume = daughter;
+        return true;
+      };
+
+      auto const &daughters = currentvolume->GetDaughters();
+      const int root        = bvh ? bvh->Root(currentvolume->GetLogicalVolume()->id()) : -1;
+      if (root >= 0) {
+        godeeper = bvh->FindFirst(root, currentpoint, [&](int index) { return enterIfIn(daughters[index]); });
+      } else {
+        for (auto *daughter : daughters) {
+          if (enterIfIn(daughter)) {
+            godeeper = true;
+            break;
+          }
         }
       }
     } while (godeeper);
@@ -66,7 +86,7 @@ public:
 
   __host__ __device__
   static VPlacedVolumePtr_t RelocatePoint(vecgeom::Vector3D<vecgeom::Precision> const &localpoint,
-                                          vecgeom::NavStateIndex &path)
+                                          vecgeom::NavStateIndex &path, adept::DaughterBVH const *bvh = nullptr)
   {
     vecgeom::VPlacedVolume const *currentmother       = path.Top();
     vecgeom::Vector3D<vecgeom::Precision> transformed = localpoint;
@@ -79,7 +99,7 @@ public:
 
     if (currentmother) {
       path.Pop();
-      return LocatePointIn(currentmother, transformed, path, false);
+      return LocatePointIn(currentmother, transformed, path, false, bvh);
     }
     return currentmother;
   }
@@ -94,7 +114,9 @@ private:
                                                       vecgeom::Precision step_limit,
                                                       vecgeom::NavStateIndex const &in_state,
                                                       vecgeom::NavStateIndex &out_state,
-                                                      VPlacedVolumePtr_t &hitcandidate)
+                                                      VPlacedVolumePtr_t &hitcandidate,
+                                                      adept::DaughterBVH const *bvh,
+                                                      adept::DaughterBatch const *batch)
   {
     vecgeom::Precision step         = step_limit;
     VPlacedVolumePtr_t pvol         = in_state.Top();
@@ -104,15 +126,48 @@ private:
 
     if (step < 0) step = 0;
 
-    for (auto *daughter : pvol->GetDaughters()) {
-      double ddistance = VolumeDispatcher::DistanceToIn(daughter, localpoint, localdir, step);
-
+    auto considerDaughter = [&](VPlacedVolumePtr_t daughter, double ddistance) {
       // if distance is negative; we are inside that daughter and should relocate
       // unless distance is minus infinity
       const bool valid = (ddistance < step && !vecgeom::IsInf(ddistance)) &&
                          !((ddistance <= 0.) && in_state.GetLastExited() == daughter);
       hitcandidate = valid ? daughter : hitcandidate;
       step         = valid ? ddistance : step;
+    };
+    auto testDaughter = [&](VPlacedVolumePtr_t daughter) {
+      considerDaughter(daughter, VolumeDispatcher::DistanceToIn(daughter, localpoint, localdir, step));
+    };
+
+    auto const &daughters = pvol->GetDaughters();
+    const auto volumeId   = pvol->GetLogicalVolume()->id();
+    const int root        = bvh ? bvh->Root(volumeId) : -1;
+    auto const *range     = (root < 0 && batch) ? batch->Find(volumeId) : nullptr;
+    if (root >= 0) {
+      bvh->ForEachCandidate(root, localpoint, localdir, step, [&](int index, vecgeom::Precision) {
+        testDaughter(daughters[index]);
+        return step;
+      });
+    } else if (range) {
+      const VPlacedVolumePtr_t outCandidate = hitcandidate;
+      const vecgeom::Precision outStep      = step;
+      batch->DistancesToIn(*range, localpoint, localdir,
+                           [&](int index, vecgeom::Precision ddistance) { considerDaughter(daughters[index], ddistance); });
+      // In mixed precision the distances of the batch are single precision: recompute the one of the
+      // daughter hit in double, before it is compared with the other daughters and used for the step.
+      if (adept::kMixedPrecision && hitcandidate != outCandidate) {
+        const vecgeom::Precision refined =
+            VolumeDispatcher::DistanceToIn(hitcandidate, localpoint, localdir, vecgeom::kInfLength);
+        const bool valid = refined < outStep && !vecgeom::IsInf(refined);
+        step             = valid ? refined : outStep;
+        hitcandidate     = valid ? hitcandidate : outCandidate;
+      }
+      for (int i = 0; i < range->fNumOthers; ++i) {
+        testDaughter(daughters[batch->Other(*range, i)]);
+      }
+    } else {
+      for (auto *daughter : daughters) {
+        testDaughter(daughter);
+      }
     }
 
     // now we have the candidates and we prepare the out_state
@@ -144,13 +199,72 @@ private:
   }
 
 public:
+  // Computes the isotropic safety of the globalpoint (which must be in the
+  // current volume): a lower bound of the distance to the surface of the
+  // current volume and of its daughters, in any direction. With a hierarchy
+  // for the current volume, only the daughters whose boxes are closer than
+  // the safety found so far are queried.
+  __host__ __device__ static vecgeom::Precision ComputeSafety(vecgeom::Vector3D<vecgeom::Precision> const &globalpoint,
+                                                              vecgeom::NavStateIndex const &state,
+                                                              adept::DaughterBVH const *bvh = nullptr)
+  {
+    vecgeom::Transformation3D m;
+    state.TopMatrix(m);
+    vecgeom::Vector3D<vecgeom::Precision> localpoint = m.Transform(globalpoint);
+
+    VPlacedVolumePtr_t pvol   = state.Top();
+    vecgeom::Precision safety = VolumeDispatcher::SafetyToOut(pvol, localpoint);
+    if (safety <= 0.) return 0.;
+
+    auto const &daughters = pvol->GetDaughters();
+    const int root        = bvh ? bvh->Root(pvol->GetLogicalVolume()->id()) : -1;
+    if (root >= 0) {
+      bvh->ForEachNearer(root, localpoint, safety, [&](int index, vecgeom::Precision) {
+        vecgeom::Precision dsafety = VolumeDispatcher::SafetyToIn(daughters[index], localpoint);
+        safety                     = dsafety < safety ? dsafety : safety;
+        return safety;
+      });
+    } else {
+      for (auto *daughter : daughters) {
+        vecgeom::Precision dsafety = VolumeDispatcher::SafetyToIn(daughter, localpoint);
+        safety                     = dsafety < safety ? dsafety : safety;
+      }
+    }
+    return safety > 0. ? safety : 0.;
+  }
+
+  // Checks a step against the isotropic safety cached by the caller for the
+  // globalpoint, recomputing it if the step goes beyond. Returns true if the
+  // step stays within the safety: out_state is then set to in_state without
+  // boundary and the safety is decremented by the step, without any further
+  // geometry query. Otherwise the caller must compute the step, after which
+  // no safety is left. A point on a boundary has no safety, so that it is
+  // not recomputed there.
+  __host__ __device__ static bool StepWithinSafety(vecgeom::Vector3D<vecgeom::Precision> const &globalpoint,
+                                                   vecgeom::Precision step_limit,
+                                                   vecgeom::NavStateIndex const &in_state,
+                                                   vecgeom::NavStateIndex &out_state, vecgeom::Precision &safety,
+                                                   adept::DaughterBVH const *bvh = nullptr)
+  {
+    if (step_limit >= safety && !in_state.IsOnBoundary()) safety = ComputeSafety(globalpoint, in_state, bvh);
+    if (step_limit >= safety) {
+      safety = 0.;
+      return false;
+    }
+    in_state.CopyTo(&out_state);
+    out_state.SetBoundaryState(false);
+    safety -= step_limit;
+    return true;
+  }
+
   // Computes a step from the globalpoint (which must be in the current volume)
   // into globaldir, taking step_limit into account. If a volume is hit, the
   // function calls out_state.SetBoundaryState(true) and relocates the state to
   // the next volume.
   __host__ __device__ static double ComputeStepAndPropagatedState(
       vecgeom::Vector3D<vecgeom::Precision> const &globalpoint, vecgeom::Vector3D<vecgeom::Precision> const &globaldir,
-      vecgeom::Precision step_limit, vecgeom::NavStateIndex const &in_state, vecgeom::NavStateIndex &out_state)
+      vecgeom::Precision step_limit, vecgeom::NavStateIndex const &in_state, vecgeom::NavStateIndex &out_state,
+      adept::DaughterBVH const *bvh = nullptr, adept::DaughterBatch const *batch = nullptr)
   {
     // calculate local point/dir from global point/dir
     vecgeom::Vector3D<vecgeom::Precision> localpoint;
@@ -162,7 +276,8 @@ public:
     localdir   = m.TransformDirection(globaldir);
 
     VPlacedVolumePtr_t hitcandidate = nullptr;
-    vecgeom::Precision step = ComputeStepAndHit(localpoint, localdir, step_limit, in_state, out_state, hitcandidate);
+    vecgeom::Precision step =
+        ComputeStepAndHit(localpoint, localdir, step_limit, in_state, out_state, hitcandidate, bvh, batch);
 
     if (out_state.IsOnBoundary()) {
       // Relocate the point after the step to refine out_state.
@@ -170,11 +285,11 @@ public:
 
       if (!hitcandidate) {
         // We didn't hit a daughter but instead we're exiting the current volume.
-        RelocatePoint(localpoint, out_state);
+        RelocatePoint(localpoint, out_state, bvh);
       } else {
         // Otherwise check if we're directly entering other daughters transitively.
         localpoint = hitcandidate->GetTransformation()->Transform(localpoint);
-        LocatePointIn(hitcandidate, localpoint, out_state, false);
+        LocatePointIn(hitcandidate, localpoint, out_state, false, bvh);
       }
 
       if (out_state.Top() != nullptr) {
@@ -199,7 +314,9 @@ public:
                                                              vecgeom::Vector3D<vecgeom::Precision> const &globaldir,
                                                              vecgeom::Precision step_limit,
                                                              vecgeom::NavStateIndex const &in_state,
-                                                             vecgeom::NavStateIndex &out_state)
+                                                             vecgeom::NavStateIndex &out_state,
+                                                             adept::DaughterBVH const *bvh     = nullptr,
+                                                             adept::DaughterBatch const *batch = nullptr)
   {
     // calculate local point/dir from global point/dir
     vecgeom::Vector3D<vecgeom::Precision> localpoint;
@@ -211,7 +328,8 @@ public:
     localdir   = m.TransformDirection(globaldir);
 
     VPlacedVolumePtr_t hitcandidate = nullptr;
-    vecgeom::Precision step = ComputeStepAndHit(localpoint, localdir, step_limit, in_state, out_state, hitcandidate);
+    vecgeom::Precision step =
+        ComputeStepAndHit(localpoint, localdir, step_limit, in_state, out_state, hitcandidate, bvh, batch);
 
     if (out_state.IsOnBoundary()) {
       if (!hitcandidate) {
@@ -224,12 +342,29 @@ public:
     return step;
   }
 
+  // Same as above, using and updating the isotropic safety cached by the
+  // caller for the globalpoint: steps within the safety don't query the
+  // geometry further.
+  __host__ __device__ static double ComputeStepAndNextVolume(vecgeom::Vector3D<vecgeom::Precision> const &globalpoint,
+                                                             vecgeom::Vector3D<vecgeom::Precision> const &globaldir,
+                                                             vecgeom::Precision step_limit,
+                                                             vecgeom::NavStateIndex const &in_state,
+                                                             vecgeom::NavStateIndex &out_state,
+                                                             vecgeom::Precision &safety,
+                                                             adept::DaughterBVH const *bvh     = nullptr,
+                                                             adept::DaughterBatch const *batch = nullptr)
+  {
+    if (StepWithinSafety(globalpoint, step_limit, in_state, out_state, safety, bvh)) return step_limit;
+    return ComputeStepAndNextVolume(globalpoint, globaldir, step_limit, in_state, out_state, bvh, batch);
+  }
+
   // Relocate a state that was returned from ComputeStepAndNextVolume: It first
   // removes all volumes from the state that were left, and then recursively
   // locates the pushed point in the containing volume.
   __host__ __device__ static void RelocateToNextVolume(vecgeom::Vector3D<vecgeom::Precision> const &globalpoint,
                                                        vecgeom::Vector3D<vecgeom::Precision> const &globaldir,
-                                                       vecgeom::NavStateIndex &state)
+                                                       vecgeom::NavStateIndex &state,
+                                                       adept::DaughterBVH const *bvh = nullptr)
   {
     // Push the point inside the next volume.
     vecgeom::Vector3D<vecgeom::Precision> pushed = globalpoint + 1.E-6 * globaldir;
@@ -242,10 +377,10 @@ public:
     VPlacedVolumePtr_t pvol = state.Top();
 
     if (!VolumeDispatcher::UnplacedContains(pvol, localpoint)) {
-      RelocatePoint(localpoint, state);
+      RelocatePoint(localpoint, state, bvh);
     } else {
       state.Pop();
-      LocatePointIn(pvol, localpoint, state, false);
+      LocatePointIn(pvol, localpoint, state, false, bvh);
     }
 
     if (state.Top() != nullptr) {
@@ -255,6 +390,51 @@ public:
       assert(!state.Top()->GetLogicalVolume()->GetUnplacedVolume()->IsAssembly());
     }
   }
+
+  // Same as above, first trying the state found by the last relocation from
+  // the same previous state (the state before the step) and tentative state
+  // (the one returned by ComputeStepAndNextVolume). The cached state is used
+  // if it contains the pushed point, after descending into its daughters and
+  // popping the assemblies as the full relocation does.
+  // Otherwise the state is fully relocated and the result stored in the cache.
+  __host__ __device__ static void RelocateToNextVolume(vecgeom::Vector3D<vecgeom::Precision> const &globalpoint,
+                                                       vecgeom::Vector3D<vecgeom::Precision> const &globaldir,
+                                                       vecgeom::NavStateIndex const &previous,
+                                                       vecgeom::NavStateIndex &state,
+                                                       adept::RelocationCache const &cache,
+                                                       adept::DaughterBVH const *bvh = nullptr)
+  {
+    if (!cache.Enabled()) {
+      RelocateToNextVolume(globalpoint, globaldir, state, bvh);
+      return;
+    }
+
+    const vecgeom::NavIndex_t from      = previous.GetNavIndex(previous.GetLevel());
+    const vecgeom::NavIndex_t tentative = state.GetNavIndex(state.GetLevel());
+    const vecgeom::NavIndex_t cached    = cache.Lookup(from, tentative);
+    if (cached) {
+      vecgeom::NavStateIndex candidate(cached);
+      vecgeom::Transformation3D m;
+      candidate.TopMatrix(m);
+      vecgeom::Vector3D<vecgeom::Precision> localpoint = m.Transform(globalpoint + 1.E-6 * globaldir);
+
+      VPlacedVolumePtr_t pvol = candidate.Top();
+      if (VolumeDispatcher::UnplacedContains(pvol, localpoint)) {
+        candidate.Pop();
+        LocatePointIn(pvol, localpoint, candidate, false, bvh);
+        while (candidate.Top()->IsAssembly()) {
+          candidate.Pop();
+        }
+        candidate.SetBoundaryState(state.IsOnBoundary());
+        state = candidate;
+        cache.CountHit();
+        return;
+      }
+    }
+
+    RelocateToNextVolume(globalpoint, globaldir, state, bvh);
+    if (state.Top() != nullptr) cache.Store(from, tentative, state.GetNavIndex(state.GetLevel()));
+  }
 };
 
 } // End namespace COPCORE_IMPL
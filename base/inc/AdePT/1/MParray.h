@@ -26,7 +26,7 @@ public:
   using iterator        = value_type *;
   using const_iterator  = const value_type *;
   using size_t          = std::size_t;
-  using AtomicInt_t     = adept::Atomic_t<int>;
+  using AtomicInt_t     = adept::AtomicCounter_t<int>; ///< Only hands out indices, read after kernel completion
   using Base_t          = copcore::VariableSizeObjectInterface<MParray, int>;
   using ArrayData_t     = copcore::VariableSizeObj<int>;
 
@@ -95,11 +95,26 @@ public:
     fNbooked.store(0);
   }
 
+  /** @brief Keep only the first n elements, not to be used concurrently with push_back */
+  __host__ __device__
+  __forceinline__
+  void truncate(size_t n)
+  {
+    if (n >= size()) return;
+    fNused.store(n);
+    fNbooked.store(n);
+  }
+
   /** @brief Read-only index operator */
   __host__ __device__
   __forceinline__
   const_reference operator[](size_t index) const { return fData[index]; }
 
+  /** @brief Read/write index operator, not to be used concurrently with push_back */
+  __host__ __device__
+  __forceinline__
+  reference operator[](size_t index) { return fData[index]; }
+
   /** @brief Dispatch next free element, nullptr if none left */
   __host__ __device__
   __forceinline__
@@ -118,6 +133,11 @@ public:
   __forceinline__
   bool full() const { return (size() == fCapacity); }
 
+  /** @brief Check if a push_back failed for lack of space since the last clear */
+  __host__ __device__
+  __forceinline__
+  bool overflowed() const { return fNbooked.load() > fCapacity; }
+
   __host__ __device__
   __forceinline__
   const_iterator begin() const { return const_iterator(&fData[0]); }
@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file PackedNavState.h
+ * @brief Navigation state of a track packed in 32 bits.
+ *
+ * @details A vecgeom::NavStateIndex holds the navigation index of the state, the one of the last exited
+ * state and the boundary flag, padded to 12 bytes. The last exited index is never set by the navigation
+ * (Push and Pop leave it alone), so the packed form drops it: it keeps the navigation index and stores the
+ * boundary flag in its top bit, which stays free as the index is an offset in the navigation table. Tracks
+ * store their state packed and unpack it into a NavStateIndex for the navigation; the state after a step
+ * only needs to be stored for the tracks crossing a boundary.
+ */
+
+#ifndef ADEPT_1PACKEDNAVSTATE_H_
+#define ADEPT_1PACKEDNAVSTATE_H_
+
+#include <CopCore/1/Global.h>
+
+#include <VecGeom/navigation/NavStateIndex.h>
+
+#include <cassert>
+
+namespace adept {
+
+/** @brief Navigation index and boundary flag in one 32-bit word */
+class PackedNavState {
+public:
+  using NavIndex_t = vecgeom::NavIndex_t;
+
+  static constexpr NavIndex_t kBoundaryBit = NavIndex_t(1) << 31;
+
+private:
+  NavIndex_t fNavIndAndBoundary{0}; ///< Navigation index, 0 outside the world, with the boundary flag in kBoundaryBit
+
+public:
+  PackedNavState() = default;
+
+  __host__ __device__ PackedNavState(vecgeom::NavStateIndex const &state) { Pack(state); }
+
+  /** @brief Keep the navigation index and the boundary flag of state, its last exited index is not kept */
+  __host__ __device__ void Pack(vecgeom::NavStateIndex const &state)
+  {
+    // The navigation index of a state is its own index at its level.
+    const NavIndex_t navInd = state.IsOutside() ? 0 : state.GetNavIndex(state.GetLevel());
+    assert(!(navInd & kBoundaryBit) && "navigation index overlapping the boundary flag");
+    fNavIndAndBoundary = navInd | (state.IsOnBoundary() ? kBoundaryBit : 0);
+  }
+
+  __host__ __device__ vecgeom::NavStateIndex Unpack() const
+  {
+    vecgeom::NavStateIndex state(GetNavIndex());
+    state.SetBoundaryState(IsOnBoundary());
+    return state;
+  }
+
+  __host__ __device__ NavIndex_t GetNavIndex() const { return fNavIndAndBoundary & ~kBoundaryBit; }
+
+  __host__ __device__ bool IsOnBoundary() const { return fNavIndAndBoundary & kBoundaryBit; }
+
+  __host__ __device__ void SetBoundaryState(bool onBoundary)
+  {
+    fNavIndAndBoundary = onBoundary ? (fNavIndAndBoundary | kBoundaryBit) : (fNavIndAndBoundary & ~kBoundaryBit);
+  }
+
+  /** @brief Placed volume of the state, without unpacking it */
+  __host__ __device__ vecgeom::VPlacedVolume const *Top() const
+  {
+    return vecgeom::NavStateIndex::TopImpl(GetNavIndex());
+  }
+};
+
+} // namespace adept
+
+#endif // ADEPT_1PACKEDNAVSTATE_H_
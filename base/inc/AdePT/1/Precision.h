@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file Precision.h
+ * @brief Floating point type of the transport quantities that tolerate single precision.
+ *
+ * @details Building with ADEPT_MIXED_PRECISION defined (CMake option of the same name) selects float for
+ * the track directions and the distances computed in the local frames of the daughters, which halves
+ * their memory traffic and runs at the single precision rate of the device. Global positions, energies,
+ * the energy accumulation and the transformations to the local frames stay in double, so that the
+ * rounding errors do not grow with the distance from the origin. Without the option, everything is
+ * double as before. The conversions between the two are explicit, with VectorCast.
+ */
+
+#ifndef ADEPT_1PRECISION_H_
+#define ADEPT_1PRECISION_H_
+
+#include <CopCore/1/Global.h>
+
+#include <VecGeom/base/Vector3D.h>
+
+namespace adept {
+
+#ifdef ADEPT_MIXED_PRECISION
+using Real_t                          = float;
+static constexpr bool kMixedPrecision = true;
+#else
+using Real_t                          = double;
+static constexpr bool kMixedPrecision = false;
+#endif
+
+/** @brief Convert a vector to another floating point type */
+template <typename To, typename From>
+__host__ __device__ vecgeom::Vector3D<To> VectorCast(vecgeom::Vector3D<From> const &v)
+{
+  return vecgeom::Vector3D<To>(To(v.x()), To(v.y()), To(v.z()));
+}
+
+} // namespace adept
+
+#endif // ADEPT_1PRECISION_H_
@@ -0,0 +1,190 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file RelocationCache.h
+ * @brief Cache of the volumes entered after crossing a boundary.
+ *
+ * @details After a boundary crossing, the navigation state is relocated starting from a tentative state:
+ * the mother of the volume left, or the daughter hit. In regular geometries, tracks cross the same few
+ * boundaries over and over, so that the same pair of previous and tentative states mostly leads to the
+ * same final state. The cache is a direct-mapped table keyed by this pair, storing the last final state
+ * found for it. An entry is a single 64-bit word holding a tag of the key and the navigation index, so
+ * that concurrent updates cannot tear it. The cached state is only a guess, to be verified by the caller
+ * with a Contains query before use. Counters of the lookups, hits and stores are kept on the device
+ * only when statistics are requested, as every relocation would otherwise update the same atomics.
+ */
+
+#ifndef ADEPT_1RELOCATIONCACHE_H_
+#define ADEPT_1RELOCATIONCACHE_H_
+
+#include <CL/sycl.hpp>
+
+#include <AdePT/1/Atomic.h>
+#include <CopCore/1/Global.h>
+
+#include <VecGeom/navigation/NavStateIndex.h>
+
+namespace adept {
+
+/** @brief Device view of a relocation cache */
+class RelocationCache {
+public:
+  using NavIndex_t = vecgeom::NavIndex_t;
+  using Entry_t    = adept::Atomic_t<unsigned long long>;
+  using Counter_t  = adept::AtomicCounter_t<unsigned long long>;
+
+  /** @brief Usage counters, accumulated over the whole run */
+  struct Counters {
+    Counter_t fLookups; ///< Relocations going through the cache
+    Counter_t fHits;    ///< Cached states verified to contain the point
+    Counter_t fStores;  ///< Entries written after a full relocation
+  };
+
+private:
+  Entry_t *fEntries{nullptr};     ///< Table of 2^n entries
+  Counters *fCounters{nullptr};   ///< Usage counters, nullptr without statistics
+  unsigned int fMask{0};          ///< Number of entries minus one
+
+  __host__ __device__ static unsigned int Hash(NavIndex_t previous, NavIndex_t tentative)
+  {
+    unsigned int h = previous * 0x9E3779B1u;
+    h ^= (tentative + 0x7F4A7C15u + (h << 6) + (h >> 2)) * 0x85EBCA77u;
+    return h ^ (h >> 15);
+  }
+
+  /** @brief Second hash of the key, never zero as zero marks empty entries */
+  __host__ __device__ static unsigned int Tag(NavIndex_t previous, NavIndex_t tentative)
+  {
+    unsigned int t = (previous ^ (tentative << 16) ^ (tentative >> 16)) * 0xC2B2AE35u;
+    return t ? t : 1;
+  }
+
+public:
+  RelocationCache() = default;
+
+  RelocationCache(Entry_t *entries, Counters *counters, unsigned int mask)
+      : fEntries(entries), fCounters(counters), fMask(mask)
+  {
+  }
+
+  __host__ __device__ bool Enabled() const { return fEntries != nullptr; }
+
+  /** @brief Final state last found for the key, 0 if none */
+  __host__ __device__ NavIndex_t Lookup(NavIndex_t previous, NavIndex_t tentative) const
+  {
+    if (fCounters) fCounters->fLookups++;
+    const unsigned long long entry = fEntries[Hash(previous, tentative) & fMask].load();
+    if ((unsigned int)(entry >> 32) != Tag(previous, tentative)) return 0;
+    return (NavIndex_t)(entry & 0xFFFFFFFFu);
+  }
+
+  /** @brief Record that the cached state of the key was verified */
+  __host__ __device__ void CountHit() const
+  {
+    if (fCounters) fCounters->fHits++;
+  }
+
+  /** @brief Remember the final state found for the key, replacing the entry of any other key */
+  __host__ __device__ void Store(NavIndex_t previous, NavIndex_t tentative, NavIndex_t final) const
+  {
+    if (final == 0) return;
+    const unsigned long long entry = ((unsigned long long)Tag(previous, tentative) << 32) | final;
+    fEntries[Hash(previous, tentative) & fMask].store(entry);
+    if (fCounters) fCounters->fStores++;
+  }
+}; // End class RelocationCache
+
+/** @brief Owner of the device memory of a relocation cache */
+class RelocationCacheStorage {
+  using Entry_t  = RelocationCache::Entry_t;
+  using Counters = RelocationCache::Counters;
+
+  sycl::queue *fQueue{nullptr};
+  Entry_t *fEntries{nullptr};
+  Counters *fCounters{nullptr};
+  unsigned int fNumEntries{0};
+
+public:
+  /** @brief Counters as plain numbers, for reporting */
+  struct Summary {
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long stores;
+    double HitRate() const { return lookups ? double(hits) / lookups : 0; }
+  };
+
+  RelocationCacheStorage() = default;
+
+  RelocationCacheStorage(const RelocationCacheStorage &) = delete;
+  RelocationCacheStorage &operator=(const RelocationCacheStorage &) = delete;
+
+  ~RelocationCacheStorage() { Free(); }
+
+  /** @brief Allocate and clear a table of 2^log2Entries entries, none if log2Entries is zero, and the
+   * usage counters if statistics are requested */
+  void Allocate(sycl::queue &queue, int log2Entries, bool statistics = false)
+  {
+    Free();
+    if (log2Entries <= 0) return;
+    fQueue      = &queue;
+    fNumEntries = 1u << log2Entries;
+    fEntries    = sycl::malloc_device<Entry_t>(fNumEntries, queue);
+    if (statistics) fCounters = sycl::malloc_device<Counters>(1, queue);
+    if (!fEntries || (statistics && !fCounters))
+      COPCORE_EXCEPTION("RelocationCacheStorage::Allocate: cannot allocate device memory");
+    Clear();
+  }
+
+  /** @brief Forget all entries and reset the counters */
+  void Clear()
+  {
+    if (!fEntries) return;
+    fQueue->memset(fEntries, 0, sizeof(Entry_t) * fNumEntries);
+    if (fCounters) fQueue->memset(fCounters, 0, sizeof(Counters));
+    fQueue->wait_and_throw();
+  }
+
+  RelocationCache View() const { return RelocationCache(fEntries, fCounters, fNumEntries ? fNumEntries - 1 : 0); }
+
+  unsigned int GetNumEntries() const { return fNumEntries; }
+
+  bool HasStatistics() const { return fCounters != nullptr; }
+
+  /** @brief Read the counters back from the device, zeros without statistics */
+  Summary GetSummary() const
+  {
+    Summary summary{0, 0, 0};
+    if (!fCounters) return summary;
+    Counters counters;
+    fQueue->memcpy(&counters, fCounters, sizeof(Counters)).wait_and_throw();
+    summary.lookups = counters.fLookups.load();
+    summary.hits    = counters.fHits.load();
+    summary.stores  = counters.fStores.load();
+    return summary;
+  }
+
+  /** @brief Set the counters to the values of a summary, e.g. to undo the lookups of an iteration */
+  void SetSummary(Summary const &summary)
+  {
+    if (!fCounters) return;
+    Counters counters;
+    counters.fLookups.store(summary.lookups);
+    counters.fHits.store(summary.hits);
+    counters.fStores.store(summary.stores);
+    fQueue->memcpy(fCounters, &counters, sizeof(Counters)).wait_and_throw();
+  }
+
+  void Free()
+  {
+    if (fEntries) sycl::free(fEntries, *fQueue);
+    if (fCounters) sycl::free(fCounters, *fQueue);
+    fEntries    = nullptr;
+    fCounters   = nullptr;
+    fNumEntries = 0;
+  }
+}; // End class RelocationCacheStorage
+
+} // End namespace adept
+
+#endif // ADEPT_1RELOCATIONCACHE_H_
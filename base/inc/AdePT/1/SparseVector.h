@@ -37,6 +37,9 @@
  *       Copies the indices of all used elements in ind.
  *     compact(SparseVectorInterface<Type> *source, SparseVectorInterface<Type> *source, unsigned *nsel)
  *       Moves all used elements from source to the end of dest, returning the number of copied elements nsel
+ *   These run asynchronously on the default SYCL queue using sub-group scans and return the event.
+ *   The same operations suffixed by _host (select_host, select_and_move_host, ...) run on vectors
+ *   accessible from the host, on the TaskScheduler threads, preserving the order of the elements.
  *
  * @author Andrei Gheata (andrei.gheata@cern.ch)
  */
@@ -48,8 +51,13 @@
 #include <dpct/dpct.hpp>
 #include <CL/cl_ext.h>
 #include <CopCore/1/CopCore.h>
+#include <CopCore/1/TaskScheduler.h>
 #include <AdePT/1/Atomic.h>
 
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
 namespace adept {
 
 template <typename Type>
@@ -60,10 +68,16 @@ class SparseVector;
 
 namespace sa_detail {
 
-inline int lane_id(sycl::nd_item<3> item_ct1)
-{
-  return item_ct1.get_local_id(2) & 31;
-}
+/// Number of elements per chunk for the host implementations (multiple of 32, so that a mask word
+/// belongs to a single chunk)
+constexpr int kHostChunk = 4096;
+
+/// Work-group size used by the device implementations
+constexpr int kBlockSize = 256;
+
+using AtomicRefUnsigned_t =
+    sycl::ext::oneapi::atomic_ref<unsigned, sycl::ext::oneapi::memory_order::relaxed,
+                                  sycl::ext::oneapi::memory_scope::device, sycl::access::address_space::global_space>;
 
 template <typename Type>
 inline bool is_used(int index, const SparseVectorInterface<Type> *svector)
@@ -71,17 +85,6 @@ inline bool is_used(int index, const SparseVectorInterface<Type> *svector)
   return svector->is_used(index);
 }
 
-void print_mask(unsigned int mask, const sycl::stream &stream_ct1)
-{
-  for (int lane = 0; lane < 32; ++lane) {
-    if ((mask & (1 << lane)))
-      stream_ct1 << "1";
-    else
-      stream_ct1 << "0";
-  }
-  stream_ct1 << "\n";
-}
-
 template <typename Type, unsigned N>
 void construct_vector(void *addr, int numSMs)
 {
@@ -89,40 +92,20 @@ void construct_vector(void *addr, int numSMs)
   vect->setNumSMs(numSMs);
 }
 
-template <typename Type>
-void release_selected_kernel(SparseVectorInterface<Type> *svect, const unsigned int *selection,
-                                        unsigned *nselected,
-                                        sycl::nd_item<3> item_ct1)
+/// Launch configuration for the grid-stride device kernels: enough work-groups to fill the device
+inline sycl::nd_range<1> device_range(sycl::queue &queue)
 {
-  // Release the selected entries
-  for (auto tid = item_ct1.get_group(2) * item_ct1.get_local_range().get(2) +
-                  item_ct1.get_local_id(2);
-       tid < *nselected;
-       tid += item_ct1.get_local_range().get(2) * item_ct1.get_group_range(2))
-    svect->release(selection[tid]);
+  int num_groups = 8 * queue.get_device().get_info<sycl::info::device::max_compute_units>();
+  return sycl::nd_range<1>(sycl::range<1>(num_groups * kBlockSize), sycl::range<1>(kBlockSize));
 }
 
 template <typename Type>
-void release_selected_kernel_launcher(SparseVectorInterface<Type> *svect, const unsigned int *selection,
-                                                 unsigned *nselected,
-                                                 sycl::nd_item<3> item_ct1)
+void release_selected_kernel(SparseVectorInterface<Type> *svect, const unsigned int *selection,
+                             unsigned *nselected, sycl::nd_item<1> item_ct1)
 {
-  // Launcher for releasing the selected entries
-  constexpr unsigned int warpsPerSM = 32; // target occupancy
-  constexpr unsigned int block_size = 256;
-  unsigned int grid_size =
-      std::min(warpsPerSM * svect->getNumSMs() * 32 / block_size,
-               (*nselected + block_size - 1) / block_size);
-  // printf("running release_selected_kernel<<<%d, %d>>>\n", grid_size, block_size);
-    dpct::get_default_queue().submit([&](sycl::handler &cgh) {
-        cgh.parallel_for(sycl::nd_range<3>(sycl::range<3>(1, 1, grid_size) *
-                                               sycl::range<3>(1, 1, block_size),
-                                           sycl::range<3>(1, 1, block_size)),
-                         [=](sycl::nd_item<3> item_ct1) {
-                             release_selected_kernel<Type>(svect, selection,
-                                                           nselected, item_ct1);
-                         });
-    });
+  // Release the selected entries
+  for (unsigned tid = item_ct1.get_global_id(0); tid < *nselected; tid += item_ct1.get_global_range(0))
+    svect->release(selection[tid]);
 }
 
 template <typename Type>
@@ -136,267 +119,109 @@ void clear_kernel(SparseVectorInterface<Type> *svect)
 /// Assume that IndexContainer::operator[] is implemented and use it to copy selected element indices
 template <typename Type, typename Predicate, typename IndexContainer>
 void select_kernel(const SparseVectorInterface<Type> *svect, Predicate pred_func, IndexContainer *output,
-                              unsigned *nselected, sycl::nd_item<3> item_ct1)
-
+                   unsigned *nselected, sycl::nd_item<1> item_ct1)
 {
-  // Non-order-preserving stream compacting algorithm
-  // Based on algorithm described in https://www.jstage.jst.go.jp/article/ijnc/7/2/7_208/_pdf/-char/ja
+  // Non-order-preserving stream compaction: each sub-group votes on consecutive elements, computes the
+  // position of each selected element within the sub-group with a scan, and reserves space in the output
+  // with a single atomic. The loop bounds are uniform within the sub-group.
   // nselected content must be zeroed before calling the kernel
-  constexpr unsigned int warp_mask = 0xFFFFFFFF;
-
-  int num_items = svect->size();
-  int tid = item_ct1.get_group(2) * item_ct1.get_local_range().get(2) +
-            item_ct1.get_local_id(2);
-  int warp_id   = tid / 32;
-  // exit if the current warp is out of range
-  if (warp_id > num_items / 1024) return;
-  int lnid = lane_id(item_ct1);
-  unsigned votes    = 0;
-  unsigned predmask = 0;
-  int cnt           = 0;
-  // Stage 1: each warp iterates 32 subgroups of 32 elements each. Each thread computes the selection
-  // predicates for one element in the group and combine them into a `votes` word using __ballot. The number of
-  // votes in subgroup `i` is stored into the variable cnt{i} (value for lane `i` of the warp). The votes
-  // for subgroup `i` are stored in predmask{i}
-  int group_max = sycl::min(32, (int)(1 + (num_items - 1024 * warp_id) / 32));
-  for (int group_id = 0; group_id < group_max; ++group_id) {
-    // Get votes for this group
-    int index     = 1024 * warp_id + 32 * group_id + lnid;
+  auto sg             = item_ct1.get_sub_group();
+  const int lane      = sg.get_local_id()[0];
+  const int num_items = svect->size();
+  const int stride    = item_ct1.get_global_range(0);
+  for (int first = item_ct1.get_global_id(0) - lane; first < num_items; first += stride) {
+    int index     = first + lane;
     bool selected = (index < num_items) ? is_used(index, svect) && pred_func(index, svect) : false;
-
-    /*
-    DPCT1004:0: Could not generate replacement.
-    */
-    votes = __ballot_sync(warp_mask, selected);
-
-    // store the ballot and the votes count in the lane matching the group id
-    if (lnid == group_id) {
-      predmask = votes;
-      cnt = sycl::popcount(votes); // number of votes (set bits) in the subgroup
-      // printf("(warp_id=%d, group_id=%d) cnt = %d  predmask = 0x%x ", warp_id, lnid, cnt, predmask);
-      // print_mask(predmask);
-    }
-  }
-
-// Stage 2: parallel prefix sum of all cnt variables giving the offset for each subgroup
-#pragma unroll
-  for (int i = 1; i < 32; i <<= 1) {
-    /*
-    DPCT1023:1: The DPC++ sub-group does not support mask options for
-    shuffle_up.
-    */
-    int n = item_ct1.get_sub_group().shuffle_up(cnt, i);
-    if (lnid >= i) cnt += n;
-  }
-
-  // cnt for lane 31 now contains the sum of all votes in all ballots for warp_id
-
-  // Stage 3: the last lane thread adds the sum of all votes in the warp to get all group offsets.
-  // Each group offset is broadcasted to all threads in the warp using __shfl_sync
-  int group_offset = 0;
-  if (lnid == 31) {
-    // printf("final count for warp %d: cnt = %d\n", warp_id, cnt);
-    /*
-    DPCT1039:2: The generated code assumes that "nselected" points to the global
-    memory address space. If it points to a local memory address space, replace
-    "dpct::atomic_fetch_add" with "dpct::atomic_fetch_add<unsigned int,
-    sycl::access::address_space::local_space>".
-    */
-    group_offset =
-        sycl::atomic<unsigned int>(sycl::global_ptr<unsigned int>(nselected))
-            .fetch_add(cnt);
-    // printf("warp %d: group_offset = %d  all_votes = %d\n", warp_id, group_offset, *nselected);
-  }
-  /*
-  DPCT1023:3: The DPC++ sub-group does not support mask options for shuffle.
-  */
-  group_offset = item_ct1.get_sub_group().shuffle(group_offset, 31);
-
-  // Stage 4: Write the indices of the selected elements to the output vector
-  for (int group_id = 0; group_id < group_max; ++group_id) {
-    /*
-    DPCT1023:4: The DPC++ sub-group does not support mask options for shuffle.
-    */
-    int mask = item_ct1.get_sub_group().shuffle(
-        predmask, group_id); // broadcast mask stored by lane group_id
-    int subgroup_index = 0;
-    if (group_id > 0)
-      /*
-      DPCT1023:5: The DPC++ sub-group does not support mask options for shuffle.
-      */
-      subgroup_index = item_ct1.get_sub_group().shuffle(
-          cnt, group_id - 1); // broadcast from thr group_id - 1 if group_id > 0
-
-    if (mask & (1 << lnid)) { // each thr extracts its pred bit
-      int idest = group_offset + subgroup_index +
-                  sycl::popcount(mask & ((1 << lnid) - 1));
-      int isrc      = 1024 * warp_id + 32 * group_id + lnid;
-      output[idest] = isrc;
-    }
+    int rank      = sycl::exclusive_scan_over_group(sg, selected ? 1 : 0, sycl::plus<int>());
+    int total     = sycl::reduce_over_group(sg, selected ? 1 : 0, sycl::plus<int>());
+    if (total == 0) continue;
+    unsigned offset = 0;
+    if (sg.leader()) offset = AtomicRefUnsigned_t(*nselected).fetch_add(total);
+    offset = sycl::group_broadcast(sg, offset, 0);
+    if (selected) output[offset + rank] = index;
   }
 }
 
-/// Dynamic launcher for select_kernel
-template <typename Type, typename Predicate, typename IndexContainer>
-void select_kernel_launcher(const SparseVectorInterface<Type> *svect, Predicate pred_func,
-                                       IndexContainer *output, unsigned *nselected,
-                                       sycl::nd_item<3> item_ct1)
-{
-  const int num_threads = 128;
-  int num_items         = svect->size();
-  int num_blocks        = (num_items + 4095) / 4096; // a warp processes groups of 1024 elements
-  *nselected            = 0;
-    dpct::get_default_queue().submit([&](sycl::handler &cgh) {
-        cgh.parallel_for(
-            sycl::nd_range<3>(sycl::range<3>(1, 1, num_blocks) *
-                                  sycl::range<3>(1, 1, num_threads),
-                              sycl::range<3>(1, 1, num_threads)),
-            [=](sycl::nd_item<3> item_ct1) {
-                select_kernel<Type, Predicate, IndexContainer>(
-                    svect, pred_func, output, nselected, item_ct1);
-            });
-    });
-}
-
 /// Make a selection of elements according to the user predicate and write it to the output.
 /// Copy directly elements at the end of the output vector.
 /// Similar to select_kernel, but having extra actions applied to the vectors
 template <typename Type, typename Predicate>
 void select_and_move_kernel(SparseVectorInterface<Type> *svect, Predicate pred_func,
-                                       SparseVectorInterface<Type> *output, unsigned *nselected, int dest_offset,
-                                       sycl::nd_item<3> item_ct1)
-
+                            SparseVectorInterface<Type> *output, unsigned *nselected, sycl::nd_item<1> item_ct1)
 {
-  // Non-order-preserving stream compacting algorithm
-  // Based on algorithm described in https://www.jstage.jst.go.jp/article/ijnc/7/2/7_208/_pdf/-char/ja
   // nselected content must be zeroed before calling the kernel
-  constexpr unsigned int warp_mask = 0xFFFFFFFF;
-
   assert(output != svect && "Compacting into the same container not supported yet");
-  int num_items = svect->size();
-  int tid = item_ct1.get_group(2) * item_ct1.get_local_range().get(2) +
-            item_ct1.get_local_id(2);
-  int warp_id   = tid / 32;
-  // exit if the current warp is out of range
-  if (warp_id > num_items / 1024) return;
-  int lnid = lane_id(item_ct1);
-  unsigned votes    = 0;
-  unsigned predmask = 0;
-  int cnt           = 0;
-  // Stage 1: each warp iterates 32 subgroups of 32 elements each. Each thread computes the selection
-  // predicates for one element in the group and combine them into a `votes` word using __ballot. The number of
-  // votes in subgroup `i` is stored into the variable cnt{i} (value for lane `i` of the warp). The votes
-  // for subgroup `i` are stored in predmask{i}
-  int group_max = sycl::min(32, (int)(1 + (num_items - 1024 * warp_id) / 32));
-  for (int group_id = 0; group_id < group_max; ++group_id) {
-    // Get votes for this group
-    int index     = 1024 * warp_id + 32 * group_id + lnid;
+  auto sg             = item_ct1.get_sub_group();
+  const int lane      = sg.get_local_id()[0];
+  const int num_items = svect->size();
+  const int stride    = item_ct1.get_global_range(0);
+  for (int first = item_ct1.get_global_id(0) - lane; first < num_items; first += stride) {
+    int index     = first + lane;
     bool selected = (index < num_items) ? is_used(index, svect) && pred_func(index, svect) : false;
-
-    /*
-    DPCT1004:6: Could not generate replacement.
-    */
-    votes = __ballot_sync(warp_mask, selected);
-
-    // store the ballot and the votes count in the lane matching the group id
-    if (lnid == group_id) {
-      predmask = votes;
-      cnt = sycl::popcount(votes); // number of votes (set bits) in the subgroup
-      //  mask out the selected elements that will be released from the initial vector
-      int indmask      = index / 32;
-      unsigned newmask = svect->mask_at(indmask).load() & (~predmask);
-      svect->mask_at(indmask).store(newmask);
-      // printf("(warp_id=%d, group_id=%d) cnt = %d  predmask = 0x%x ", warp_id, lnid, cnt, predmask);
-      // print_mask(predmask);
+    int rank      = sycl::exclusive_scan_over_group(sg, selected ? 1 : 0, sycl::plus<int>());
+    int total     = sycl::reduce_over_group(sg, selected ? 1 : 0, sycl::plus<int>());
+    if (total == 0) continue;
+    // The leader books the destination range, which also sets the output masks, and updates counters
+    unsigned dest = 0;
+    if (sg.leader()) {
+      dest = output->add_elements(total);
+      svect->remove_elements(total);
+      AtomicRefUnsigned_t(*nselected).fetch_add(total);
     }
-  }
-
-// Stage 2: parallel prefix sum of all cnt variables giving the offset for each subgroup
-#pragma unroll
-  for (int i = 1; i < 32; i <<= 1) {
-    /*
-    DPCT1023:7: The DPC++ sub-group does not support mask options for
-    shuffle_up.
-    */
-    int n = item_ct1.get_sub_group().shuffle_up(cnt, i);
-    if (lnid >= i) cnt += n;
-  }
-
-  // cnt for lane 31 now contains the sum of all votes in all ballots for warp_id
-
-  // Stage 3: the last lane thread adds the sum of all votes in the warp to get all group offsets.
-  // Each group offset is broadcasted to all threads in the warp using __shfl_sync
-  int group_offset = 0;
-  if (lnid == 31) {
-    // printf("final count for warp %d: cnt = %d\n", warp_id, cnt);
-    /*
-    DPCT1039:8: The generated code assumes that "nselected" points to the global
-    memory address space. If it points to a local memory address space, replace
-    "dpct::atomic_fetch_add" with "dpct::atomic_fetch_add<unsigned int,
-    sycl::access::address_space::local_space>".
-    */
-    group_offset =
-        sycl::atomic<unsigned int>(sycl::global_ptr<unsigned int>(nselected))
-            .fetch_add(cnt);
-    output->add_elements(cnt);   // increase the counter in the output vector and set masks
-    svect->remove_elements(cnt); // remove used elements from the source
-    // printf("warp %d: group_offset = %d  all_votes = %d\n", warp_id, group_offset, *nselected);
-  }
-  /*
-  DPCT1023:9: The DPC++ sub-group does not support mask options for shuffle.
-  */
-  group_offset = item_ct1.get_sub_group().shuffle(group_offset, 31);
-
-  // Stage 4: Write the indices of the selected elements to the output vect
-  for (int group_id = 0; group_id < group_max; ++group_id) {
-    /*
-    DPCT1023:10: The DPC++ sub-group does not support mask options for shuffle.
-    */
-    int mask = item_ct1.get_sub_group().shuffle(
-        predmask, group_id); // broadcast mask stored by lane group_id
-    int subgroup_index = 0;
-    if (group_id > 0)
-      /*
-      DPCT1023:11: The DPC++ sub-group does not support mask options for
-      shuffle.
-      */
-      subgroup_index = item_ct1.get_sub_group().shuffle(
-          cnt, group_id - 1); // broadcast from thr group_id - 1 if group_id > 0
-
-    if (mask & (1 << lnid)) { // each thr extracts its pred bit
-      int idest = dest_offset + group_offset + subgroup_index +
-                  sycl::popcount(mask & ((1 << lnid) - 1));
-      int isrc  = 1024 * warp_id + 32 * group_id + lnid;
-      // printf("== copy from %d to %d\n", isrc, idest);
-      new (output->data() + idest) Type((*svect)[isrc]); // call in-place copy constructor starting with last element
+    dest = sycl::group_broadcast(sg, dest, 0);
+    if (selected) {
+      // mask out the selected element that is moved away from the initial vector
+      svect->mask_at(index / 32).fetch_and(~(1u << (index & 31)));
+      new (output->data() + dest + rank) Type((*svect)[index]); // call in-place copy constructor
     }
   }
 }
 
-/// Dynamic launcher for select_kernel
+/// Host selection: evaluates the predicate once per element in parallel chunks, storing the result as
+/// bit masks, and computes the exclusive prefix sum of the per-chunk counts. Returns the total count.
 template <typename Type, typename Predicate>
-void select_and_move_kernel_launcher(SparseVectorInterface<Type> *svect, Predicate pred_func,
-                                                SparseVectorInterface<Type> *output, unsigned *nselected,
-                                                sycl::nd_item<3> item_ct1)
+unsigned host_selection(const SparseVectorInterface<Type> *svect, Predicate pred_func,
+                        copcore::TaskScheduler &scheduler, std::vector<unsigned> &bits,
+                        std::vector<unsigned> &offsets)
 {
-  using Vector_t            = SparseVectorInterface<Type>;
-  const int num_items       = svect->size();
-  constexpr int num_threads = 128;
-  const int num_blocks      = (num_items + 4095) / 4096;
-  *nselected                = 0;
-    dpct::get_default_queue().submit([&](sycl::handler &cgh) {
-        auto output_size_ct4 = output->size();
-
-        cgh.parallel_for(
-            sycl::nd_range<3>(sycl::range<3>(1, 1, num_blocks) *
-                                  sycl::range<3>(1, 1, num_threads),
-                              sycl::range<3>(1, 1, num_threads)),
-            [=](sycl::nd_item<3> item_ct1) {
-                select_and_move_kernel<Type>(svect, pred_func, output,
-                                             nselected, output_size_ct4,
-                                             item_ct1);
-            });
-    });
+  const int num_items = svect->size();
+  const int nchunks   = (num_items + kHostChunk - 1) / kHostChunk;
+  bits.assign((num_items + 31) / 32, 0);
+  offsets.assign(nchunks + 1, 0);
+  scheduler.ParallelFor(0, nchunks, 1, [&](int chunk) {
+    const int last = std::min(num_items, (chunk + 1) * kHostChunk);
+    unsigned count = 0;
+    for (int word = chunk * kHostChunk / 32; word * 32 < last; ++word) {
+      unsigned used     = svect->mask_at(word).load();
+      unsigned selected = 0;
+      for (int bit = 0; bit < 32 && word * 32 + bit < last; ++bit) {
+        if ((used & (1u << bit)) && pred_func(word * 32 + bit, svect)) selected |= 1u << bit;
+      }
+      bits[word] = selected;
+      count += sycl::popcount(selected);
+    }
+    offsets[chunk + 1] = count;
+  });
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  return offsets[nchunks];
+}
+
+/// Calls func(index, position) for all selected elements of a chunk, position being the rank of the
+/// element in the whole selection
+template <typename Func>
+void host_for_selected(int chunk, std::vector<unsigned> const &bits, std::vector<unsigned> const &offsets,
+                       Func &&func)
+{
+  unsigned position = offsets[chunk];
+  const int last    = std::min((int)bits.size(), (chunk + 1) * kHostChunk / 32);
+  for (int word = chunk * kHostChunk / 32; word < last; ++word) {
+    unsigned selected = bits[word];
+    while (selected) {
+      int bit = sycl::ctz(selected);
+      func(word * 32 + bit, position++);
+      selected &= selected - 1;
+    }
+  }
 }
 
 } // end namespace sa_detail
@@ -582,8 +407,8 @@ public:
     // memset(mask_begin(), 0, fMaskCapacity * sizeof(Mask_t)); // do we need to clear the storage as well?
   }
 
-  /** @brief Add elements at the end of the vector */
-  void add_elements(unsigned n)
+  /** @brief Add elements at the end of the vector. Returns the index of the first added element. */
+  unsigned add_elements(unsigned n)
   {
     // this should be protected, but has to be launched as a templated kernel...
     // update the mask from bits fNshared to fNshared + n in one go
@@ -616,6 +441,7 @@ public:
 
     fNused += n;
     fNbooked += n;
+    return start;
   }
 
   /** @brief Update counters when removing elements */
@@ -670,57 +496,123 @@ public:
   /** @brief Fills selection vector fSelected with element indices passing the user predicate
    *  @param pred Predicate function taking as arguments the SparseVector pointer and the element index
    *  @returns Number of selected elements. Must be reset to 0 when calling the function.
+   *  @details Asynchronous device implementation, the order of the selected indices is not preserved.
    */
-
   template <typename Predicate, typename Container>
-  static void select(const Vector_t *svect, Predicate pred_func, Container *output, unsigned *num_selected)
+  static sycl::event select(const Vector_t *svect, Predicate pred_func, Container *output, unsigned *num_selected)
   {
-        dpct::get_default_queue().submit([&](sycl::handler &cgh) {
-            cgh.parallel_for(
-                sycl::nd_range<3>(sycl::range<3>(1, 1, 1),
-                                  sycl::range<3>(1, 1, 1)),
-                [=](sycl::nd_item<3> item_ct1) {
-                    select_kernel_launcher<Type, Predicate, Container>(
-                        (Vector_t *)svect, pred_func, output, num_selected,
-                        item_ct1);
-                });
-        });
+    auto &queue = dpct::get_default_queue();
+    return queue.parallel_for(sa_detail::device_range(queue), [=](sycl::nd_item<1> item_ct1) {
+      sa_detail::select_kernel<Type, Predicate, Container>(svect, pred_func, output, num_selected, item_ct1);
+    });
   }
 
-*/
-
-  /** @brief Fills selection vector fSelected with element indices passing the user predicate
+  /** @brief Moves the elements passing the user predicate at the end of the output vector
    *  @param pred Predicate function taking as arguments the SparseVector pointer and the element index
    *  @returns Number of selected elements. Must be reset to 0 when calling the function.
    */
   template <typename Predicate>
-  static void select_and_move(Vector_t *svect, Predicate pred_func, Vector_t *output, unsigned *num_selected)
+  static sycl::event select_and_move(Vector_t *svect, Predicate pred_func, Vector_t *output, unsigned *num_selected)
   {
-    sa_detail::select_and_move_kernel_launcher<Type><<<1, 1>>>(svect, pred_func, output, num_selected);
+    auto &queue = dpct::get_default_queue();
+    return queue.parallel_for(sa_detail::device_range(queue), [=](sycl::nd_item<1> item_ct1) {
+      sa_detail::select_and_move_kernel<Type, Predicate>(svect, pred_func, output, num_selected, item_ct1);
+    });
   }
 
   template <typename Container>
-  static void select_used(const Vector_t *svect, Container *output, unsigned *num_selected)
+  static sycl::event select_used(const Vector_t *svect, Container *output, unsigned *num_selected)
   {
-    Vector_t::select(svect, [] (int, const Vector_t *) { return true; }, output, num_selected);
+    return Vector_t::select(svect, [] (int, const Vector_t *) { return true; }, output, num_selected);
   }
 
   /** @brief Compacts used elements of this vect into a destination vect. */
-
-  static void compact(Vector_t *svect, Vector_t *output, unsigned *num_selected)
+  static sycl::event compact(Vector_t *svect, Vector_t *output, unsigned *num_selected)
   {
     // copy to destination vector
-    sa_detail::select_and_move_kernel_launcher<Type>
-        <<<1, 1>>>(svect, [] (int, const Vector_t *) { return true; }, output, num_selected);
+    auto moved = Vector_t::select_and_move(svect, [] (int, const Vector_t *) { return true; }, output, num_selected);
     // update output vector
-    sa_detail::clear_kernel<Type><<<1, 1>>>(svect);
+    return dpct::get_default_queue().submit([&](sycl::handler &cgh) {
+      cgh.depends_on(moved);
+      cgh.single_task([=]() { sa_detail::clear_kernel<Type>(svect); });
+    });
   }
 
   /** @brief Fills selection vector fSelected with indices of remaining used elements. */
-  static void release_selected(Vector_t *svect, unsigned *selection, unsigned *nselected)
+  static sycl::event release_selected(Vector_t *svect, unsigned *selection, unsigned *nselected)
   {
     // we pass n_elements by pointer to avoid having to copy the value to the host
-    sa_detail::release_selected_kernel_launcher<Type><<<1, 1>>>(svect, selection, nselected);
+    auto &queue = dpct::get_default_queue();
+    return queue.parallel_for(sa_detail::device_range(queue), [=](sycl::nd_item<1> item_ct1) {
+      sa_detail::release_selected_kernel<Type>(svect, selection, nselected, item_ct1);
+    });
+  }
+
+  /// Host implementations for vectors accessible from the host. Chunks of the vector are processed in
+  /// parallel by the scheduler threads: a first pass evaluates the predicate and counts the selected
+  /// elements per chunk, a prefix sum over the counts gives the output offset of each chunk, and a
+  /// second pass writes the output. The order of the elements is preserved.
+
+  /** @brief Host version of select. The selection is order-preserving. */
+  template <typename Predicate, typename Container>
+  static void select_host(const Vector_t *svect, Predicate pred_func, Container *output, unsigned *num_selected,
+                          copcore::TaskScheduler &scheduler = copcore::TaskScheduler::Instance())
+  {
+    std::vector<unsigned> bits, offsets;
+    *num_selected     = sa_detail::host_selection(svect, pred_func, scheduler, bits, offsets);
+    const int nchunks = offsets.size() - 1;
+    scheduler.ParallelFor(0, nchunks, 1, [&](int chunk) {
+      sa_detail::host_for_selected(chunk, bits, offsets,
+                                   [&](int index, unsigned position) { output[position] = index; });
+    });
+  }
+
+  /** @brief Host version of select_and_move. The moved elements keep their relative order. */
+  template <typename Predicate>
+  static void select_and_move_host(Vector_t *svect, Predicate pred_func, Vector_t *output, unsigned *num_selected,
+                                   copcore::TaskScheduler &scheduler = copcore::TaskScheduler::Instance())
+  {
+    assert(output != svect && "Compacting into the same container not supported yet");
+    std::vector<unsigned> bits, offsets;
+    const unsigned nselected = sa_detail::host_selection(svect, pred_func, scheduler, bits, offsets);
+    *num_selected            = nselected;
+    if (nselected == 0) return;
+    const unsigned dest = output->add_elements(nselected);
+    svect->remove_elements(nselected);
+    const int nchunks = offsets.size() - 1;
+    scheduler.ParallelFor(0, nchunks, 1, [&](int chunk) {
+      sa_detail::host_for_selected(chunk, bits, offsets, [&](int index, unsigned position) {
+        new (output->data() + dest + position) Type((*svect)[index]);
+      });
+      // mask words are owned by a single chunk
+      const int last = std::min((int)bits.size(), (chunk + 1) * sa_detail::kHostChunk / 32);
+      for (int word = chunk * sa_detail::kHostChunk / 32; word < last; ++word)
+        if (bits[word]) svect->mask_at(word).store(svect->mask_at(word).load() & ~bits[word]);
+    });
+  }
+
+  /** @brief Host version of select_used */
+  template <typename Container>
+  static void select_used_host(const Vector_t *svect, Container *output, unsigned *num_selected,
+                               copcore::TaskScheduler &scheduler = copcore::TaskScheduler::Instance())
+  {
+    Vector_t::select_host(svect, [] (int, const Vector_t *) { return true; }, output, num_selected, scheduler);
+  }
+
+  /** @brief Host version of compact */
+  static void compact_host(Vector_t *svect, Vector_t *output, unsigned *num_selected,
+                           copcore::TaskScheduler &scheduler = copcore::TaskScheduler::Instance())
+  {
+    Vector_t::select_and_move_host(svect, [] (int, const Vector_t *) { return true; }, output, num_selected,
+                                   scheduler);
+    svect->clear();
+  }
+
+  /** @brief Host version of release_selected */
+  static void release_selected_host(Vector_t *svect, const unsigned *selection, unsigned nselected,
+                                    copcore::TaskScheduler &scheduler = copcore::TaskScheduler::Instance())
+  {
+    scheduler.ParallelFor(0, nselected, 0, [&](int i) { svect->release(selection[i]); });
   }
 
 };
@@ -759,7 +651,7 @@ protected:
             cgh.parallel_for(sycl::nd_range<3>(sycl::range<3>(1, 1, 1),
                                                sycl::range<3>(1, 1, 1)),
                              [=](sycl::nd_item<3> item_ct1) {
-                                 construct_vector<Type, N>(addr, numSMs);
+                                 sa_detail::construct_vector<Type, N>(addr, numSMs);
                              });
         });
     return reinterpret_cast<SparseVector<Type, N> *>(addr);
@@ -78,6 +78,24 @@ public:
     COPCORE_EXCEPTION("No matching type found to dispatch DistanceToOut!");
     return 0;
   }
+
+  /** @brief Isotropic safety of a point outside vol, given in the frame of its mother */
+  __host__ __device__ static Precision SafetyToIn(VolumePtr vol, Vector const &position)
+  {
+    TransformationPtr tr = vol->GetTransformation();
+    Vector localPosition = tr->Transform(position);
+    DISPATCH_TO_PLACED_VOLUME(vol, Precision, SafetyToIn, localPosition);
+    COPCORE_EXCEPTION("No matching type found to dispatch SafetyToIn!");
+    return 0;
+  }
+
+  /** @brief Isotropic safety of a point inside vol, given in its local frame */
+  __host__ __device__ static Precision SafetyToOut(VolumePtr vol, Vector const &position)
+  {
+    DISPATCH_TO_PLACED_VOLUME(vol, Precision, SafetyToOut, position);
+    COPCORE_EXCEPTION("No matching type found to dispatch SafetyToOut!");
+    return 0;
+  }
 };
 
 #undef DISPATCH_TO_PLACED_VOLUME_KIND
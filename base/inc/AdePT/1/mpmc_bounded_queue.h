@@ -21,7 +21,7 @@ namespace internal {
 /** @brief Internal data structure to handle the data sequence */
 template <typename Type>
 struct Cell_t {
-  adept::Atomic_t<int> fSequence; ///< Atomic sequence counter
+  adept::AtomicSync_t<int> fSequence; ///< Atomic sequence counter, publishes fData (release/acquire)
   Type fData;                     ///< Data stored in the cell
 
   /** @brief Cell constructor */
@@ -34,7 +34,7 @@ template <typename Type>
 class mpmc_bounded_queue
     : protected copcore::VariableSizeObjectInterface<mpmc_bounded_queue<Type>, internal::Cell_t<Type>> {
 public:
-  using AtomicInt_t = adept::Atomic_t<int>;
+  using AtomicInt_t = adept::AtomicCounter_t<int>; ///< Indices are synchronized through the cell sequences
   using Value_t     = internal::Cell_t<Type>;
   using Base_t      = copcore::VariableSizeObjectInterface<mpmc_bounded_queue<Type>, Value_t>;
   using ArrayData_t = copcore::VariableSizeObj<Value_t>;
@@ -87,6 +87,39 @@ private:
   /** @brief Operator = */
   void operator=(mpmc_bounded_queue const &) = delete;
 
+  /** @brief Number of consecutive cells from pos that can be claimed, up to n.
+      @details A cell is ready when its sequence equals pos + i + offset (offset 0 for enqueue, 1 for dequeue).
+        A ready cell stays ready until the index pointing to it is claimed, so the range is safe to
+        take with a single CAS on the enqueue/dequeue index. */
+  int ready_cells(int pos, int n, int offset) const
+  {
+    int nready = 0;
+    while (nready < n && fBuffer[(pos + nready) & fMask].fSequence.load() == pos + nready + offset)
+      nready++;
+    return nready;
+  }
+
+  /** @brief Claim up to n consecutive cells with a single CAS. Returns the first position in pos.
+      @details As in enqueue/dequeue, the first cell tells whether the queue is full (resp. empty) or
+        whether pos is stale because another thread already claimed it: 0 is only returned in the first
+        case, otherwise the index is reloaded. */
+  int claim_cells(AtomicInt_t &index, int &pos, int n, int offset)
+  {
+    pos = index.load();
+    if (n <= 0) return 0;
+    for (;;) {
+      int seq      = fBuffer[pos & fMask].fSequence.load();
+      intptr_t dif = (intptr_t)seq - (intptr_t)(pos + offset);
+      if (dif < 0) return 0;
+      if (dif > 0) {
+        pos = index.load();
+        continue;
+      }
+      int nready = 1 + ready_cells(pos + 1, n - 1, offset);
+      if (index.compare_exchange_weak(pos, pos + nready)) return nready;
+    }
+  }
+
 public:
   ///< Enumerate the part of the private interface, we want to expose.
   using Base_t::MakeCopy;
@@ -126,7 +159,7 @@ public:
       int seq      = cell->fSequence.load();
       intptr_t dif = (intptr_t)seq - (intptr_t)pos;
       if (dif == 0) {
-        if (fEnqueue.compare_exchange_strong(pos, pos + 1)) break;
+        if (fEnqueue.compare_exchange_weak(pos, pos + 1)) break;
       } else if (dif < 0)
         return false;
       else
@@ -148,7 +181,7 @@ public:
       int seq      = cell->fSequence.load();
       intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
       if (dif == 0) {
-        if (fDequeue.compare_exchange_strong(pos, pos + 1)) break;
+        if (fDequeue.compare_exchange_weak(pos, pos + 1)) break;
       } else if (dif < 0)
         return false;
       else
@@ -160,6 +193,86 @@ public:
     return true;
   }
 
+  /** @brief MPMC bulk enqueue function.
+      @details Claims a contiguous range of cells with a single CAS and a single update of the number
+        of stored elements. Returns the number of elements enqueued, which can be smaller than n if
+        the queue gets full: the elements [0, returned) were enqueued. */
+  int enqueue_n(Type const *data, int n)
+  {
+    int pos;
+    int nclaimed = claim_cells(fEnqueue, pos, n, 0);
+    if (nclaimed == 0) return 0;
+    fNstored.fetch_add(nclaimed);
+    for (int i = 0; i < nclaimed; ++i) {
+      Value_t &cell = fBuffer[(pos + i) & fMask];
+      cell.fData    = data[i];
+      cell.fSequence.store(pos + i + 1);
+    }
+    return nclaimed;
+  }
+
+  /** @brief MPMC bulk dequeue function. Returns the number of elements written to data (at most n). */
+  int dequeue_n(Type *data, int n)
+  {
+    int pos;
+    int nclaimed = claim_cells(fDequeue, pos, n, 1);
+    if (nclaimed == 0) return 0;
+    fNstored.fetch_sub(nclaimed);
+    for (int i = 0; i < nclaimed; ++i) {
+      Value_t &cell = fBuffer[(pos + i) & fMask];
+      data[i]       = cell.fData;
+      cell.fSequence.store(pos + i + fMask + 1);
+    }
+    return nclaimed;
+  }
+
+  /** @brief Sub-group cooperative enqueue.
+      @details Must be called by all work items of the sub-group. Items with active set contribute
+        data; a single leader claims the cells for the whole sub-group and each item fills its own cell.
+        Returns true if the data of the calling item was enqueued. */
+  template <typename SubGroup>
+  bool enqueue_subgroup(SubGroup const &sg, Type const &data, bool active)
+  {
+    int rank   = sycl::exclusive_scan_over_group(sg, active ? 1 : 0, sycl::plus<int>());
+    int ntotal = sycl::reduce_over_group(sg, active ? 1 : 0, sycl::plus<int>());
+    if (ntotal == 0) return false;
+    int pos = 0, nclaimed = 0;
+    if (sg.get_local_id()[0] == 0) {
+      nclaimed = claim_cells(fEnqueue, pos, ntotal, 0);
+      if (nclaimed > 0) fNstored.fetch_add(nclaimed);
+    }
+    pos      = sycl::group_broadcast(sg, pos, 0);
+    nclaimed = sycl::group_broadcast(sg, nclaimed, 0);
+    if (!active || rank >= nclaimed) return false;
+    Value_t &cell = fBuffer[(pos + rank) & fMask];
+    cell.fData    = data;
+    cell.fSequence.store(pos + rank + 1);
+    return true;
+  }
+
+  /** @brief Sub-group cooperative dequeue.
+      @details Must be called by all work items of the sub-group. Items with want set request one
+        element each. Returns true if an element was written to data. */
+  template <typename SubGroup>
+  bool dequeue_subgroup(SubGroup const &sg, Type &data, bool want)
+  {
+    int rank   = sycl::exclusive_scan_over_group(sg, want ? 1 : 0, sycl::plus<int>());
+    int ntotal = sycl::reduce_over_group(sg, want ? 1 : 0, sycl::plus<int>());
+    if (ntotal == 0) return false;
+    int pos = 0, nclaimed = 0;
+    if (sg.get_local_id()[0] == 0) {
+      nclaimed = claim_cells(fDequeue, pos, ntotal, 1);
+      if (nclaimed > 0) fNstored.fetch_sub(nclaimed);
+    }
+    pos      = sycl::group_broadcast(sg, pos, 0);
+    nclaimed = sycl::group_broadcast(sg, nclaimed, 0);
+    if (!want || rank >= nclaimed) return false;
+    Value_t &cell = fBuffer[(pos + rank) & fMask];
+    data          = cell.fData;
+    cell.fSequence.store(pos + rank + fMask + 1);
+    return true;
+  }
+
   /** @brief Usage as array rather than a queue.
       @details This mode only allowed if no pending concurrent enqueue/dequeue operations.
         The index should be smaller than the number of stored elements. The range is only
@@ -7,15 +7,17 @@
  * @author Andrei Gheata (andrei.gheata@cern.ch).
  *
  * @details A standard allocator providing allocate/deallocate interface.
- * Specializations are provided for CPU, CUDA and *TODO* HIP.
+ * Specializations are provided for CPU, CUDA, ONEAPI and *TODO* HIP.
  */
 
 
 #include <cstddef>
 #include <stdexcept>
 #include <iostream>
+#include <type_traits>
 
 #include <CopCore/1/Global.h>
+#include <CopCore/1/UsmPool.h>
 
 namespace copcore {
 
@@ -148,4 +150,124 @@ private:
   int fDeviceId{0}; ///< Device id
 };
 
+/** @brief Partial allocator specialization for the ONEAPI backend
+ *
+ * @details Memory is taken from a UsmPool when one is given, so that buffers released at the end of
+ * a run are recycled by the next one, otherwise directly from the SYCL runtime. Device memory is not
+ * accessible from the host, so the objects are constructed and destroyed by a single device task.
+ * Shared memory can be given a mem_advise hint and prefetched to the device after construction.
+ */
+template <class T>
+class Allocator<T, BackendType::ONEAPI> {
+public:
+  using value_type = T;
+
+  Allocator(sycl::queue const &queue, UsmKind kind = UsmKind::kShared, UsmPool *pool = nullptr)
+      : fQueue(queue), fKind(kind), fPool(pool)
+  {
+  }
+
+  Allocator(UsmPool &pool, UsmKind kind = UsmKind::kShared) : Allocator(pool.GetQueue(), kind, &pool) {}
+
+  Allocator(const Allocator &) = default;
+
+  template <class U>
+  Allocator(const Allocator<U, BackendType::ONEAPI> &other)
+      : fQueue(other.GetQueue()), fKind(other.GetKind()), fPool(other.GetPool()), fAdvice(other.GetMemAdvice()),
+        fPrefetch(other.GetPrefetch())
+  {
+  }
+
+  bool operator==(const Allocator &other) const
+  {
+    return fQueue == other.fQueue && fKind == other.fKind && fPool == other.fPool;
+  }
+
+  bool operator!=(const Allocator &other) const { return !(*this == other); }
+
+  template <typename... P>
+  value_type *allocate(std::size_t n, const P &... params) const
+  {
+    auto obj_size      = sizeof(T);
+    value_type *result = nullptr;
+    if (fPool)
+      result = (value_type *)fPool->Allocate(n * obj_size, fKind, alignof(T));
+    else
+      result = (value_type *)sycl::aligned_alloc(alignof(T), n * obj_size, fQueue, ToSyclAlloc(fKind));
+    if (!result) COPCORE_EXCEPTION("Allocator<ONEAPI>::allocate: out of memory");
+
+    // allocate all objects at their aligned positions in the buffer
+    if (fKind == UsmKind::kDevice) {
+      fQueue
+          .single_task([=]() {
+            value_type *current = result;
+            for (std::size_t i = 0; i < n; ++i)
+              new (current++) T(params...);
+          })
+          .wait_and_throw();
+    } else {
+      value_type *current = result;
+      for (std::size_t i = 0; i < n; ++i)
+        new (current++) T(params...);
+      if (fKind == UsmKind::kShared) {
+        if (fAdvice) fQueue.mem_advise(result, n * obj_size, fAdvice);
+        if (fPrefetch) fQueue.prefetch(result, n * obj_size);
+      }
+    }
+
+    return result;
+  }
+
+  void deallocate(value_type *ptr, std::size_t n = 0) const
+  {
+    if (!ptr) return;
+    // Call destructor for all allocated objects
+    if (!std::is_trivially_destructible<T>::value && n > 0) {
+      if (fKind == UsmKind::kDevice) {
+        fQueue
+            .single_task([=]() {
+              value_type *current = ptr;
+              for (std::size_t i = 0; i < n; ++i)
+                (current++)->~T();
+            })
+            .wait_and_throw();
+      } else {
+        fQueue.wait_and_throw();
+        value_type *current = ptr;
+        for (std::size_t i = 0; i < n; ++i)
+          (current++)->~T();
+      }
+    }
+
+    // Release the memory
+    if (fPool)
+      fPool->Release(ptr);
+    else
+      sycl::free(ptr, fQueue);
+  }
+
+  /** @brief Set a mem_advise hint applied to shared allocations (0 for none, values are device specific) */
+  void SetMemAdvice(int advice) { fAdvice = advice; }
+
+  /** @brief Prefetch shared allocations to the device after construction */
+  void SetPrefetch(bool prefetch) { fPrefetch = prefetch; }
+
+  sycl::queue GetQueue() const { return fQueue; }
+
+  UsmKind GetKind() const { return fKind; }
+
+  UsmPool *GetPool() const { return fPool; }
+
+  int GetMemAdvice() const { return fAdvice; }
+
+  bool GetPrefetch() const { return fPrefetch; }
+
+private:
+  mutable sycl::queue fQueue; ///< Queue the memory is bound to
+  UsmKind fKind;              ///< Kind of USM allocations
+  UsmPool *fPool{nullptr};    ///< Optional caching pool
+  int fAdvice{0};             ///< mem_advise hint for shared allocations
+  bool fPrefetch{false};      ///< Prefetch shared allocations to the device
+};
+
 } // End namespace copcore
@@ -20,7 +20,7 @@
 namespace copcore {
 
 /** @brief Backend types enumeration */
-enum BackendType { CPU = 0, CUDA, HIP };
+enum BackendType { CPU = 0, CUDA, HIP, ONEAPI };
 
 /** @brief CUDA error checking */
 
@@ -55,6 +55,8 @@ const char *BackendName(Backend const &backend)
     return "BackendType::CUDA";
   case BackendType::HIP:
     return "BackendType::HIP";
+  case BackendType::ONEAPI:
+    return "BackendType::ONEAPI";
   default:
     return "Unknown backend";
   };
@@ -14,6 +14,7 @@
 #include <CL/sycl.hpp>
 #include <dpct/dpct.hpp>
 #include <CopCore/1/Global.h>
+#include <CopCore/1/TaskScheduler.h>
 
 namespace copcore {
 
@@ -138,18 +139,44 @@ public:
 }; // End  class Launcher<BackendType::CUDA>
 
 
-/** @brief Specialization of Launcher for the CPU backend */
+/** @brief Specialization of Launcher for the CPU backend
+ *  @details By default the loop is executed by the work-stealing TaskScheduler, which balances
+ *  work items of very different cost. The static schedule runs one contiguous chunk per worker of the
+ *  same TaskScheduler, without stealing.
+ */
 template <>
 class Launcher<BackendType::CPU> : public LauncherBase<BackendType::CPU> {
+public:
+  /** @brief Scheduling strategies for the CPU loop */
+  enum class Schedule { kStatic, kWorkStealing };
+
+private:
+  Schedule fSchedule{Schedule::kWorkStealing}; ///< Scheduling strategy
+  int fGrainSize{0};                           ///< Largest chunk executed without splitting (0 = automatic)
+  TaskScheduler *fScheduler{nullptr};          ///< Thread pool, the shared default pool if not set
+
 public:
   Launcher(Stream_t stream = 0) : LauncherBase(stream) {}
 
+  /** @brief Select the scheduling strategy */
+  void SetSchedule(Schedule schedule) { fSchedule = schedule; }
+  Schedule GetSchedule() const { return fSchedule; }
+
+  /** @brief Set the grain size of the work-stealing schedule (0 lets the scheduler choose) */
+  void SetGrainSize(int grain) { fGrainSize = grain; }
+  int GetGrainSize() const { return fGrainSize; }
+
+  /** @brief Use a user-provided thread pool, e.g. one created with a NUMA pinning policy */
+  void SetScheduler(TaskScheduler *scheduler) { fScheduler = scheduler; }
+
   template <class HostFunctionPtr, class... Args>
   int Run(HostFunctionPtr func, int n_elements, LaunchGrid_t /*grid*/, const Args &... args) const
   {
-#pragma omp parallel for
-    for (int i = 0; i < n_elements; ++i) {
-      func(i, args...);
+    TaskScheduler &scheduler = fScheduler ? *fScheduler : TaskScheduler::Instance();
+    if (fSchedule == Schedule::kWorkStealing) {
+      scheduler.ParallelFor(0, n_elements, fGrainSize, [&](int i) { func(i, args...); });
+    } else {
+      scheduler.ParallelForStatic(0, n_elements, [&](int i) { func(i, args...); });
     }
     return 0;
   }
@@ -0,0 +1,363 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file TaskScheduler.h
+ * @brief Work-stealing thread pool used by the CPU backend of the Launcher.
+ *
+ * @details The index range of a parallel loop is split in one contiguous chunk per worker. Each worker
+ * owns a deque of ranges: it splits the range at the back of its deque in halves until the range is not
+ * larger than the grain size, pushing the upper halves back, and then executes the remaining piece.
+ * Idle workers steal from the front of a random victim deque, which always holds the largest pending
+ * range. This balances loops where the cost per index varies by orders of magnitude (e.g. a gamma in
+ * vacuum against an electron in a dense material), which a static schedule cannot do. ParallelForStatic
+ * runs the same initial chunks without splitting or stealing, as a static schedule on the same threads.
+ *
+ * The threads owned by the pool can optionally be pinned to cores: either compactly (worker i on core i)
+ * or spread round-robin over the NUMA nodes reported by the kernel, so that the memory touched by a worker
+ * stays local. Worker 0 is whichever thread calls ParallelFor and keeps its own affinity.
+ *
+ * An exception thrown by the loop body cancels the remaining ranges of the job. It is rethrown by
+ * ParallelFor once all workers have left the job, the first one if several are thrown.
+ */
+
+#ifndef COPCORE_1TASKSCHEDULER_H_
+#define COPCORE_1TASKSCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace copcore {
+
+/** @brief Thread pinning policies for the TaskScheduler workers */
+enum class AffinityPolicy {
+  kNone = 0,  ///< Let the OS place the workers
+  kCompact,   ///< Worker i pinned to logical core i
+  kNumaSpread ///< Workers distributed round-robin over NUMA nodes, then over the cores of each node
+};
+
+namespace scheduler_impl {
+
+/** @brief Half-open range of loop indices */
+struct Range_t {
+  int fBegin;
+  int fEnd;
+  int size() const { return fEnd - fBegin; }
+};
+
+/** @brief Range deque owned by one worker. The owner uses the back, thieves the front. */
+class RangeDeque {
+  std::mutex fMutex;
+  std::deque<Range_t> fRanges;
+
+public:
+  void push_back(Range_t range)
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fRanges.push_back(range);
+  }
+
+  bool pop_back(Range_t &range)
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fRanges.empty()) return false;
+    range = fRanges.back();
+    fRanges.pop_back();
+    return true;
+  }
+
+  bool steal(Range_t &range)
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fRanges.empty()) return false;
+    range = fRanges.front();
+    fRanges.pop_front();
+    return true;
+  }
+};
+
+/** @brief Parse a kernel cpu list such as "0-3,8-11" */
+inline std::vector<int> ParseCpuList(std::string const &list)
+{
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty()) continue;
+    auto dash = item.find('-');
+    int first = std::stoi(item.substr(0, dash));
+    int last  = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+/** @brief Cores of each NUMA node, as reported by sysfs. A single node holding all cores if not available. */
+inline std::vector<std::vector<int>> NumaTopology()
+{
+  std::vector<std::vector<int>> nodes;
+  for (int node = 0;; ++node) {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if (!in) break;
+    std::string list;
+    std::getline(in, list);
+    auto cpus = ParseCpuList(list);
+    if (!cpus.empty()) nodes.push_back(cpus);
+  }
+  if (nodes.empty()) {
+    nodes.emplace_back();
+    int ncores = std::thread::hardware_concurrency();
+    for (int cpu = 0; cpu < ncores; ++cpu)
+      nodes.back().push_back(cpu);
+  }
+  return nodes;
+}
+
+/** @brief Pin the calling thread to a core. Returns false if not supported or refused by the OS. */
+inline bool PinThisThread(int cpu)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+} // End namespace scheduler_impl
+
+/** @brief Work-stealing thread pool executing parallel loops over an index range */
+class TaskScheduler {
+  using Range_t      = scheduler_impl::Range_t;
+  using RangeDeque_t = scheduler_impl::RangeDeque;
+  using Kernel_t     = void (*)(void const *, int, int);
+
+  int fNthreads{1};                        ///< Number of workers, including the calling thread
+  AffinityPolicy fAffinity;                ///< Pinning policy used at construction
+  std::vector<std::thread> fThreads;       ///< Worker threads (the calling thread acts as worker 0)
+  std::unique_ptr<RangeDeque_t[]> fDeques; ///< One range deque per worker
+
+  std::mutex fMutex;             ///< Protects the job generation and the wake-up condition
+  std::condition_variable fWake; ///< Signals a new job or termination to the workers
+  std::mutex fRunMutex;          ///< Serializes concurrent ParallelFor calls on the same pool
+  unsigned long fGeneration{0};  ///< Incremented for every job
+  bool fStop{false};             ///< Set when the pool is destroyed
+
+  Kernel_t fKernel{nullptr};           ///< Type-erased loop body for the current job
+  void const *fBody{nullptr};          ///< Loop body for the current job
+  int fGrain{1};                       ///< Grain size for the current job
+  bool fSteal{true};                   ///< Whether idle workers steal in the current job
+  std::atomic<int> fRemaining{0};      ///< Number of indices not yet executed in the current job
+  std::atomic<int> fBusy{0};           ///< Number of helper workers still inside the current job
+  std::atomic<bool> fCancelled{false}; ///< Set when the body threw: remaining ranges are dropped
+  std::exception_ptr fError;           ///< First exception thrown by the body, protected by fMutex
+
+  /** @brief Execute ranges from the own deque, stealing when empty, until the job is done */
+  void Work(int worker)
+  {
+    RangeDeque_t &own = fDeques[worker];
+    unsigned seed     = 2654435761u * (worker + 1);
+    Range_t range;
+    while (fRemaining.load(std::memory_order_acquire) > 0) {
+      bool found = own.pop_back(range);
+      for (int attempt = 0; fSteal && !found && attempt < 2 * fNthreads; ++attempt) {
+        seed       = seed * 1664525u + 1013904223u;
+        int victim = (seed >> 8) % fNthreads;
+        if (victim != worker) found = fDeques[victim].steal(range);
+      }
+      if (!found) {
+        // Without stealing, a worker is done with its own chunk.
+        if (!fSteal) break;
+        std::this_thread::yield();
+        continue;
+      }
+      if (!fCancelled.load(std::memory_order_relaxed)) {
+        // Split lazily: keep the lower half, expose the upper half to thieves
+        while (range.size() > fGrain) {
+          int mid = range.fBegin + range.size() / 2;
+          own.push_back({mid, range.fEnd});
+          range.fEnd = mid;
+        }
+        try {
+          fKernel(fBody, range.fBegin, range.fEnd);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(fMutex);
+          if (!fError) fError = std::current_exception();
+          fCancelled.store(true, std::memory_order_relaxed);
+        }
+      }
+      fRemaining.fetch_sub(range.size(), std::memory_order_acq_rel);
+    }
+  }
+
+  void WorkerLoop(int worker, int cpu)
+  {
+    if (cpu >= 0) scheduler_impl::PinThisThread(cpu);
+    unsigned long seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(fMutex);
+        fWake.wait(lock, [&] { return fStop || fGeneration != seen; });
+        if (fStop) return;
+        seen = fGeneration;
+      }
+      Work(worker);
+      fBusy.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+
+  /** @brief Core assigned to each worker by the affinity policy, -1 if not pinned */
+  std::vector<int> CoreMap() const
+  {
+    std::vector<int> cores(fNthreads, -1);
+    if (fAffinity == AffinityPolicy::kCompact) {
+      int ncores = std::thread::hardware_concurrency();
+      for (int i = 0; i < fNthreads; ++i)
+        cores[i] = ncores > 0 ? i % ncores : -1;
+    } else if (fAffinity == AffinityPolicy::kNumaSpread) {
+      auto nodes = scheduler_impl::NumaTopology();
+      std::vector<size_t> next(nodes.size(), 0);
+      for (int i = 0; i < fNthreads; ++i) {
+        auto node = i % nodes.size();
+        cores[i]  = nodes[node][next[node]++ % nodes[node].size()];
+      }
+    }
+    return cores;
+  }
+
+public:
+  /** @brief Create a pool of nthreads workers (0 means one per hardware thread).
+   *  With a pinning policy, only the nthreads - 1 threads created here are pinned. */
+  TaskScheduler(int nthreads = 0, AffinityPolicy affinity = AffinityPolicy::kNone) : fAffinity(affinity)
+  {
+    fNthreads = nthreads > 0 ? nthreads : std::max(1u, std::thread::hardware_concurrency());
+    fDeques.reset(new RangeDeque_t[fNthreads]);
+    auto cores = CoreMap();
+    for (int i = 1; i < fNthreads; ++i)
+      fThreads.emplace_back(&TaskScheduler::WorkerLoop, this, i, cores[i]);
+  }
+
+  TaskScheduler(const TaskScheduler &) = delete;
+  TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+  ~TaskScheduler()
+  {
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fStop = true;
+    }
+    fWake.notify_all();
+    for (auto &thread : fThreads)
+      thread.join();
+  }
+
+  /** @brief Default pool shared by all CPU launchers, created on first use */
+  static TaskScheduler &Instance()
+  {
+    static TaskScheduler instance;
+    return instance;
+  }
+
+  /** @brief Number of workers, including the calling thread */
+  int GetNthreads() const { return fNthreads; }
+
+  /** @brief Pinning policy of the workers */
+  AffinityPolicy GetAffinity() const { return fAffinity; }
+
+  /** @brief Execute body(i) for all i in [begin, end). Blocks until all indices are processed, or
+   *  until all workers have left the job if the body threw, and then rethrows the exception.
+   *  @param grain Largest range executed without being split further. 0 picks a default from the
+   *  range size, giving about 16 pieces per worker.
+   */
+  template <class Body>
+  void ParallelFor(int begin, int end, int grain, Body const &body)
+  {
+    const int n = end - begin;
+    if (n <= 0) return;
+    if (grain <= 0) grain = std::max(1, n / (16 * fNthreads));
+    Run(begin, end, grain, /*steal=*/true, body);
+  }
+
+  /** @brief Execute body(i) for all i in [begin, end), each worker running one contiguous chunk of the
+   *  range without splitting or stealing, as a static schedule does. Exceptions as for ParallelFor. */
+  template <class Body>
+  void ParallelForStatic(int begin, int end, Body const &body)
+  {
+    if (end - begin <= 0) return;
+    Run(begin, end, end - begin, /*steal=*/false, body);
+  }
+
+private:
+  template <class Body>
+  void Run(int begin, int end, int grain, bool steal, Body const &body)
+  {
+    const int n = end - begin;
+    if (fNthreads == 1 || (steal && n <= grain)) {
+      for (int i = begin; i < end; ++i)
+        body(i);
+      return;
+    }
+
+    std::lock_guard<std::mutex> run(fRunMutex);
+    fKernel = [](void const *fn, int first, int last) {
+      Body const &func = *static_cast<Body const *>(fn);
+      for (int i = first; i < last; ++i)
+        func(i);
+    };
+    fBody  = &body;
+    fGrain = grain;
+    fSteal = steal;
+    fRemaining.store(n, std::memory_order_relaxed);
+    fBusy.store(fNthreads - 1, std::memory_order_relaxed);
+    fCancelled.store(false, std::memory_order_relaxed);
+
+    // Initial distribution: one contiguous chunk per worker
+    for (int i = 0; i < fNthreads; ++i) {
+      int first = begin + (long)n * i / fNthreads;
+      int last  = begin + (long)n * (i + 1) / fNthreads;
+      if (last > first) fDeques[i].push_back({first, last});
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      ++fGeneration;
+    }
+    fWake.notify_all();
+
+    Work(0);
+    // The body lives on the caller stack: wait for all helpers to leave the job
+    while (fBusy.load(std::memory_order_acquire) > 0)
+      std::this_thread::yield();
+
+    std::exception_ptr error;
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      std::swap(error, fError);
+    }
+    if (error) std::rethrow_exception(error);
+  }
+}; // End class TaskScheduler
+
+} // End namespace copcore
+
+#endif // COPCORE_1TASKSCHEDULER_H_
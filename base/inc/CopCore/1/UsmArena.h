@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file UsmArena.h
+ * @brief Bump allocator carving many buffers out of a single USM allocation.
+ *
+ * @details The sizes of all buffers needed by a run are first accumulated in a Layout, then a single
+ * arena of the resulting size is allocated and the buffers are sub-allocated in the same order. All of
+ * them are given back at once with Reset(), so the arena can be kept and reused by the next run or
+ * event without going through the SYCL runtime again, as long as it is large enough (Fits()). Buffers
+ * allocated one after the other are contiguous in memory.
+ */
+
+#ifndef COPCORE_1USMARENA_H_
+#define COPCORE_1USMARENA_H_
+
+#include <CL/sycl.hpp>
+
+#include <cstddef>
+
+#include <CopCore/1/Global.h>
+#include <CopCore/1/UsmPool.h>
+
+namespace copcore {
+
+/** @brief Single USM allocation split into aligned sub-buffers */
+class UsmArena {
+public:
+  static constexpr std::size_t kCacheLine = 128;  ///< Alignment avoiding false sharing between buffers
+  static constexpr std::size_t kPage      = 4096; ///< Alignment for large buffers
+
+  /** @brief Round size up to a multiple of alignment (a power of two) */
+  static constexpr std::size_t AlignUp(std::size_t size, std::size_t alignment)
+  {
+    return (size + alignment - 1) & ~(alignment - 1);
+  }
+
+  /** @brief Accumulates the space needed by a sequence of sub-allocations */
+  class Layout {
+    std::size_t fSize{0};
+
+  public:
+    /** @brief Reserve a buffer, returning its offset from the arena start */
+    std::size_t Add(std::size_t bytes, std::size_t alignment = kCacheLine)
+    {
+      std::size_t offset = AlignUp(fSize, alignment);
+      fSize              = offset + bytes;
+      return offset;
+    }
+
+    /** @brief Total arena size needed */
+    std::size_t Size() const { return AlignUp(fSize, kPage); }
+  };
+
+private:
+  sycl::queue fQueue;       ///< Queue the memory is bound to
+  UsmKind fKind;            ///< Kind of USM memory
+  char *fBase{nullptr};     ///< Start of the arena
+  std::size_t fCapacity{0}; ///< Size of the arena
+  std::size_t fOffset{0};   ///< First free byte
+  std::size_t fPeak{0};     ///< Largest fOffset reached since construction
+
+public:
+  UsmArena(sycl::queue const &queue, std::size_t capacity, UsmKind kind = UsmKind::kDevice)
+      : fQueue(queue), fKind(kind), fCapacity(AlignUp(capacity, kPage))
+  {
+    fBase = (char *)sycl::aligned_alloc(kPage, fCapacity, fQueue, ToSyclAlloc(fKind));
+    if (!fBase) COPCORE_EXCEPTION("UsmArena: cannot allocate arena");
+  }
+
+  UsmArena(sycl::queue const &queue, Layout const &layout, UsmKind kind = UsmKind::kDevice)
+      : UsmArena(queue, layout.Size(), kind)
+  {
+  }
+
+  UsmArena(const UsmArena &) = delete;
+  UsmArena &operator=(const UsmArena &) = delete;
+
+  ~UsmArena() { sycl::free(fBase, fQueue); }
+
+  /** @brief Sub-allocate an aligned buffer. Throws if the arena is exhausted. */
+  void *Allocate(std::size_t bytes, std::size_t alignment = kCacheLine)
+  {
+    std::size_t offset = AlignUp(fOffset, alignment);
+    if (offset + bytes > fCapacity) COPCORE_EXCEPTION("UsmArena::Allocate: arena exhausted");
+    fOffset = offset + bytes;
+    if (fOffset > fPeak) fPeak = fOffset;
+    return fBase + offset;
+  }
+
+  /** @brief Sub-allocate n uninitialized objects of type T */
+  template <typename T>
+  T *Allocate(std::size_t n = 1, std::size_t alignment = kCacheLine)
+  {
+    return static_cast<T *>(Allocate(n * sizeof(T), alignment < alignof(T) ? alignof(T) : alignment));
+  }
+
+  /** @brief Give back all sub-allocations at once. Kernels using them must have completed. */
+  void Reset() { fOffset = 0; }
+
+  /** @brief Whether the buffers of layout can be sub-allocated after a Reset() */
+  bool Fits(Layout const &layout) const { return layout.Size() <= fCapacity; }
+
+  /** @brief Asynchronously zero the used part of the arena */
+  sycl::event Clear() { return fQueue.memset(fBase, 0, fOffset); }
+
+  std::size_t GetCapacity() const { return fCapacity; }
+
+  std::size_t GetUsed() const { return fOffset; }
+
+  std::size_t GetPeak() const { return fPeak; }
+}; // End class UsmArena
+
+} // End namespace copcore
+
+#endif // COPCORE_1USMARENA_H_
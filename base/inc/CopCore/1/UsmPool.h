@@ -0,0 +1,195 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file UsmPool.h
+ * @brief Caching pool of SYCL unified shared memory blocks.
+ *
+ * @details Blocks are binned by USM kind, by size rounded up to a power of two and by alignment, at
+ * least kDefaultAlign. Released blocks are kept in the pool and handed out again to the next request
+ * falling in the same bin, so that the buffers of consecutive runs or events do not go through
+ * sycl::malloc/sycl::free again. Cached memory is returned to the runtime by Trim() or when the pool is
+ * destroyed.
+ */
+
+#ifndef COPCORE_1USMPOOL_H_
+#define COPCORE_1USMPOOL_H_
+
+#include <CL/sycl.hpp>
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <CopCore/1/Global.h>
+
+namespace copcore {
+
+/** @brief Kinds of unified shared memory */
+enum class UsmKind { kDevice = 0, kShared, kHost };
+
+/** @brief Conversion to the SYCL allocation kind */
+inline sycl::usm::alloc ToSyclAlloc(UsmKind kind)
+{
+  switch (kind) {
+  case UsmKind::kDevice:
+    return sycl::usm::alloc::device;
+  case UsmKind::kHost:
+    return sycl::usm::alloc::host;
+  default:
+    return sycl::usm::alloc::shared;
+  };
+}
+
+/** @brief Caching allocator for USM blocks bound to one queue */
+class UsmPool {
+public:
+  static constexpr std::size_t kMinBinSize   = 256;               ///< Smallest bin, in bytes
+  static constexpr std::size_t kDefaultAlign = 128;               ///< Default block alignment, in bytes
+  static constexpr std::size_t kMaxCached    = std::size_t(1) << 32; ///< Default limit of cached bytes
+
+private:
+  struct Block_t {
+    UsmKind fKind;
+    std::size_t fBinSize;
+    std::size_t fAlign;
+  };
+  using BinKey_t = std::tuple<int, std::size_t, std::size_t>; ///< Kind, bin size and alignment
+
+  sycl::queue fQueue;                                ///< Queue the memory is bound to
+  std::size_t fMaxCachedBytes{kMaxCached};           ///< Cached memory above this limit is freed
+  std::size_t fCachedBytes{0};                       ///< Bytes held in free lists
+  std::size_t fLiveBytes{0};                         ///< Bytes handed out and not yet released
+  std::size_t fHits{0};                              ///< Requests served from the cache
+  std::size_t fMisses{0};                            ///< Requests needing a new USM allocation
+  std::map<BinKey_t, std::vector<void *>> fFree;     ///< Free blocks per (kind, bin size, alignment)
+  std::unordered_map<void *, Block_t> fLive;         ///< Blocks currently handed out
+  mutable std::mutex fMutex;                         ///< Protects all the above
+
+  static std::size_t BinSize(std::size_t bytes)
+  {
+    std::size_t bin = kMinBinSize;
+    while (bin < bytes)
+      bin <<= 1;
+    return bin;
+  }
+
+public:
+  UsmPool(sycl::queue const &queue, std::size_t max_cached_bytes = kMaxCached)
+      : fQueue(queue), fMaxCachedBytes(max_cached_bytes)
+  {
+  }
+
+  UsmPool(const UsmPool &) = delete;
+  UsmPool &operator=(const UsmPool &) = delete;
+
+  /** @brief Frees the cached blocks and the blocks still in use */
+  ~UsmPool()
+  {
+    Trim();
+    for (auto &live : fLive)
+      sycl::free(live.first, fQueue);
+  }
+
+  /** @brief Queue the pool allocates for */
+  sycl::queue &GetQueue() { return fQueue; }
+
+  /** @brief Get a block of at least `bytes` bytes of the requested kind and alignment, a power of two. */
+  void *Allocate(std::size_t bytes, UsmKind kind, std::size_t alignment = kDefaultAlign)
+  {
+    const std::size_t bin   = BinSize(bytes);
+    const std::size_t align = alignment < kDefaultAlign ? kDefaultAlign : alignment;
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto &freeList = fFree[BinKey_t{(int)kind, bin, align}];
+    void *ptr      = nullptr;
+    if (!freeList.empty()) {
+      ptr = freeList.back();
+      freeList.pop_back();
+      fCachedBytes -= bin;
+      fHits++;
+    } else {
+      ptr = sycl::aligned_alloc(align, bin, fQueue, ToSyclAlloc(kind));
+      if (!ptr) {
+        // Give back the cached memory and retry once
+        for (auto &entry : fFree) {
+          for (auto cached : entry.second)
+            sycl::free(cached, fQueue);
+          entry.second.clear();
+        }
+        fCachedBytes = 0;
+        ptr          = sycl::aligned_alloc(align, bin, fQueue, ToSyclAlloc(kind));
+        if (!ptr) COPCORE_EXCEPTION("UsmPool::Allocate: out of memory");
+      }
+      fMisses++;
+    }
+    fLive[ptr] = {kind, bin, align};
+    fLiveBytes += bin;
+    return ptr;
+  }
+
+  /** @brief Return a block to the pool. The caller must make sure no kernel still uses it. */
+  void Release(void *ptr)
+  {
+    if (!ptr) return;
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto it = fLive.find(ptr);
+    if (it == fLive.end()) COPCORE_EXCEPTION("UsmPool::Release: pointer not allocated by this pool");
+    Block_t block = it->second;
+    fLive.erase(it);
+    fLiveBytes -= block.fBinSize;
+    if (fCachedBytes + block.fBinSize > fMaxCachedBytes) {
+      sycl::free(ptr, fQueue);
+      return;
+    }
+    fFree[BinKey_t{(int)block.fKind, block.fBinSize, block.fAlign}].push_back(ptr);
+    fCachedBytes += block.fBinSize;
+  }
+
+  /** @brief Free all cached blocks */
+  void Trim()
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (auto &entry : fFree) {
+      for (auto ptr : entry.second)
+        sycl::free(ptr, fQueue);
+    }
+    fFree.clear();
+    fCachedBytes = 0;
+  }
+
+  /** @brief Set the maximum amount of memory kept in the free lists */
+  void SetMaxCachedBytes(std::size_t bytes) { fMaxCachedBytes = bytes; }
+
+  std::size_t GetCachedBytes() const
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fCachedBytes;
+  }
+
+  std::size_t GetLiveBytes() const
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fLiveBytes;
+  }
+
+  /** @brief Number of requests served from the cache */
+  std::size_t GetHits() const
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fHits;
+  }
+
+  /** @brief Number of requests that required a new USM allocation */
+  std::size_t GetMisses() const
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fMisses;
+  }
+}; // End class UsmPool
+
+} // End namespace copcore
+
+#endif // COPCORE_1USMPOOL_H_
@@ -7,7 +7,7 @@
  * @author Andrei Gheata (andrei.gheata@cern.ch).
  *
  * @details A standard allocator providing allocate/deallocate interface
- * for VariableSizeObj objects. Specializations are provided for CPU, CUDA and *TODO* HIP.
+ * for VariableSizeObj objects. Specializations are provided for CPU, CUDA, ONEAPI and *TODO* HIP.
  */
 
 #include <cstddef>
@@ -16,6 +16,7 @@
 #include <cassert>
 
 #include <CopCore/1/Global.h>
+#include <CopCore/1/UsmPool.h>
 
 namespace copcore {
 
@@ -38,7 +39,8 @@ public:
   VariableSizeObjAllocator(const VariableSizeObjAllocator &) = default;
 
   template <class U>
-  VariableSizeObjAllocator(const VariableSizeObjAllocator<U, BackendType::CUDA> &other) : fDeviceId(other.device())
+  VariableSizeObjAllocator(const VariableSizeObjAllocator<U, BackendType::CUDA> &other)
+      : fCapacity(other.GetCapacity()), fDeviceId(other.GetDevice())
   {
   }
 
@@ -89,6 +91,8 @@ public:
 
   int GetDevice() const { return fDeviceId; }
 
+  std::size_t GetCapacity() const { return fCapacity; }
+
   void SetCapacity(std::size_t capacity) { fCapacity = capacity; }
 
 private:
@@ -118,7 +122,8 @@ public:
   VariableSizeObjAllocator(const VariableSizeObjAllocator &) = default;
 
   template <class U>
-  VariableSizeObjAllocator(const VariableSizeObjAllocator<U, BackendType::CPU> &other) : fDeviceId(other.device())
+  VariableSizeObjAllocator(const VariableSizeObjAllocator<U, BackendType::CPU> &other)
+      : fCapacity(other.GetCapacity()), fDeviceId(other.GetDevice())
   {
   }
 
@@ -160,6 +165,8 @@ public:
 
   int GetDevice() const { return fDeviceId; }
 
+  std::size_t GetCapacity() const { return fCapacity; }
+
   void SetCapacity(std::size_t capacity) { fCapacity = capacity; }
 
 private:
@@ -167,4 +174,122 @@ private:
   int fDeviceId{0};         ///< Device id
 };
 
+/** @brief Partial variable-size allocator specialization for the ONEAPI backend
+ *
+ * @details Same memory handling as Allocator<T, BackendType::ONEAPI>. Instances of device kind are
+ * made by a device task, since containers such as BlockData keep pointers inside their own buffer.
+ */
+template <class T>
+class VariableSizeObjAllocator<T, BackendType::ONEAPI> {
+public:
+  using value_type = T;
+
+  VariableSizeObjAllocator(std::size_t capacity, sycl::queue const &queue, UsmKind kind = UsmKind::kShared,
+                           UsmPool *pool = nullptr)
+      : fCapacity(capacity), fQueue(queue), fKind(kind), fPool(pool)
+  {
+  }
+
+  VariableSizeObjAllocator(std::size_t capacity, UsmPool &pool, UsmKind kind = UsmKind::kShared)
+      : VariableSizeObjAllocator(capacity, pool.GetQueue(), kind, &pool)
+  {
+  }
+
+  VariableSizeObjAllocator(const VariableSizeObjAllocator &) = default;
+
+  template <class U>
+  VariableSizeObjAllocator(const VariableSizeObjAllocator<U, BackendType::ONEAPI> &other)
+      : fCapacity(other.GetCapacity()), fQueue(other.GetQueue()), fKind(other.GetKind()), fPool(other.GetPool()),
+        fPrefetch(other.GetPrefetch())
+  {
+  }
+
+  bool operator==(const VariableSizeObjAllocator &other) const
+  {
+    return fQueue == other.fQueue && fKind == other.fKind && fPool == other.fPool;
+  }
+
+  bool operator!=(const VariableSizeObjAllocator &other) const { return !(*this == other); }
+
+  template <typename... P>
+  value_type *allocate(std::size_t n, const P &... params) const
+  {
+    value_type *result   = nullptr;
+    std::size_t obj_size = T::SizeOfAlignAware(fCapacity);
+    if (fPool)
+      result = (value_type *)fPool->Allocate(n * obj_size, fKind);
+    else
+      result = (value_type *)sycl::aligned_alloc(UsmPool::kDefaultAlign, n * obj_size, fQueue, ToSyclAlloc(fKind));
+    if (!result) COPCORE_EXCEPTION("VariableSizeObjAllocator<ONEAPI>::allocate: out of memory");
+
+    // allocate all objects at their aligned positions in the buffer
+    auto construct = [=, capacity = fCapacity]() {
+      char *buff = (char *)result;
+      for (std::size_t i = 0; i < n; ++i) {
+        T::MakeInstanceAt(capacity, buff, params...);
+        buff += obj_size;
+      }
+    };
+    if (fKind == UsmKind::kDevice) {
+      fQueue.single_task(construct).wait_and_throw();
+    } else {
+      construct();
+      if (fKind == UsmKind::kShared && fPrefetch) fQueue.prefetch(result, n * obj_size);
+    }
+
+    return result;
+  }
+
+  void deallocate(value_type *ptr, std::size_t n = 0) const
+  {
+    if (!ptr) return;
+    std::size_t obj_size = T::SizeOfAlignAware(fCapacity);
+
+    // Call destructor for all allocated objects
+    auto release = [=]() {
+      char *buff = (char *)ptr;
+      for (std::size_t i = 0; i < n; ++i) {
+        T::ReleaseInstance((T *)buff);
+        buff += obj_size;
+      }
+    };
+    if (n > 0) {
+      if (fKind == UsmKind::kDevice) {
+        fQueue.single_task(release).wait_and_throw();
+      } else {
+        fQueue.wait_and_throw();
+        release();
+      }
+    }
+
+    // Release the memory
+    if (fPool)
+      fPool->Release(ptr);
+    else
+      sycl::free(ptr, fQueue);
+  }
+
+  std::size_t GetCapacity() const { return fCapacity; }
+
+  void SetCapacity(std::size_t capacity) { fCapacity = capacity; }
+
+  /** @brief Prefetch shared allocations to the device after construction */
+  void SetPrefetch(bool prefetch) { fPrefetch = prefetch; }
+
+  bool GetPrefetch() const { return fPrefetch; }
+
+  sycl::queue GetQueue() const { return fQueue; }
+
+  UsmKind GetKind() const { return fKind; }
+
+  UsmPool *GetPool() const { return fPool; }
+
+private:
+  std::size_t fCapacity{0};   ///< Capacity of each VariableSizeObj container
+  mutable sycl::queue fQueue; ///< Queue the memory is bound to
+  UsmKind fKind;              ///< Kind of USM allocations
+  UsmPool *fPool{nullptr};    ///< Optional caching pool
+  bool fPrefetch{false};      ///< Prefetch shared allocations to the device
+};
+
 } // End namespace copcore
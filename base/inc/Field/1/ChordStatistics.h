@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file ChordStatistics.h
+ * @brief Counters of the chords and navigator queries done by the field propagation.
+ */
+
+#ifndef FIELD_1CHORDSTATISTICS_H_
+#define FIELD_1CHORDSTATISTICS_H_
+
+#include <AdePT/1/Atomic.h>
+
+// Statistics of the propagation in field, accumulated over the run when the propagator is given a pointer
+// to them. A call that takes its whole helix arc within the safety counts zero chords.
+struct ChordStatistics {
+  using Counter_t = adept::AtomicCounter_t<unsigned long long>;
+
+  static constexpr int kMaxChordIters = 10; ///< Maximum number of chords per call
+
+  Counter_t fCalls;                             ///< Propagation calls of charged tracks
+  Counter_t fArcsInSafety;                      ///< Calls taking the whole arc without navigation
+  Counter_t fChords;                            ///< Chords over all calls
+  Counter_t fSafeChords;                        ///< Chords within the safety, taken without navigation
+  Counter_t fNavigations;                       ///< Navigator queries
+  Counter_t fChordsPerCall[kMaxChordIters + 1]; ///< Number of calls by number of chords
+
+  /** @brief Record a call that took numChords chords, of which numNavigations needed the navigator */
+  __host__ __device__ void Record(int numChords, int numNavigations)
+  {
+    fCalls++;
+    if (numChords == 0) fArcsInSafety++;
+    fChords += numChords;
+    fSafeChords += numChords - numNavigations;
+    fNavigations += numNavigations;
+    fChordsPerCall[numChords]++;
+  }
+
+  double NavigationsPerCall() const { return fCalls.load() ? double(fNavigations.load()) / fCalls.load() : 0; }
+};
+
+#endif // FIELD_1CHORDSTATISTICS_H_
@@ -0,0 +1,273 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file FieldMap.h
+ * @brief Magnetic field tabulated on a regular 3D grid, in a blocked layout.
+ *
+ * @details The field is sampled on a grid of nx * ny * nz points and interpolated trilinearly. Instead of
+ * the natural x-fastest order, where the eight corners of a cell are spread over rows and planes far apart
+ * in memory, the samples are stored by bricks of kBrick^3 cells. A brick holds its (kBrick + 1)^3 corner
+ * points contiguously, the points on the faces shared with the neighbouring bricks being duplicated, so
+ * that the corners of any cell are found in the same brick, a few cache lines apart. Tracks close to each
+ * other also read the same bricks. The duplication costs about twice the memory of the grid.
+ *
+ * A field map file is a FieldMapHeader followed by the samples in the natural order, x fastest, as three
+ * floats in tesla per point. Lengths in the header are in mm. Outside of the grid the field is zero.
+ */
+
+#ifndef FIELD_1FIELDMAP_H_
+#define FIELD_1FIELDMAP_H_
+
+#include <CL/sycl.hpp>
+
+#include <CopCore/1/Global.h>
+#include <CopCore/1/SystemOfUnits.h>
+
+#include <VecGeom/base/Vector3D.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/** @brief Header of a field map file */
+struct FieldMapHeader {
+  static constexpr char kMagic[8] = {'A', 'D', 'E', 'P', 'T', 'B', 'M', 'P'};
+  static constexpr int kVersion   = 1;
+
+  char fMagic[8];
+  int fVersion;
+  int fN[3];          ///< Number of grid points along x, y and z, at least 2
+  double fOrigin[3];  ///< Position of the first grid point, in mm
+  double fSpacing[3]; ///< Distance between grid points, in mm
+};
+
+/** @brief View of a field map, in host or device memory */
+class FieldMap {
+public:
+  static constexpr int kBrick       = 4;              ///< Cells per brick along each axis
+  static constexpr int kBrickPoints = kBrick + 1;     ///< Points per brick along each axis
+  static constexpr int kBrickSize   = kBrickPoints * kBrickPoints * kBrickPoints;
+
+  /** @brief Field at a grid point, in internal units */
+  struct Sample {
+    float fB[3];
+  };
+
+private:
+  Sample const *fSamples{nullptr}; ///< Bricks, x fastest, each with its points x fastest
+  int fCells[3]{0, 0, 0};          ///< Number of cells along each axis
+  int fBricks[3]{0, 0, 0};         ///< Number of bricks along each axis
+  double fOrigin[3]{0, 0, 0};
+  double fInvSpacing[3]{0, 0, 0};
+
+public:
+  FieldMap() = default;
+
+  FieldMap(Sample const *samples, FieldMapHeader const &header) : fSamples(samples)
+  {
+    for (int i = 0; i < 3; ++i) {
+      fCells[i]      = header.fN[i] - 1;
+      fBricks[i]     = (fCells[i] + kBrick - 1) / kBrick;
+      fOrigin[i]     = header.fOrigin[i] * copcore::units::mm;
+      fInvSpacing[i] = 1. / (header.fSpacing[i] * copcore::units::mm);
+    }
+  }
+
+  __host__ __device__ bool Enabled() const { return fSamples != nullptr; }
+
+  __host__ __device__ int GetNumBricks(int axis) const { return fBricks[axis]; }
+
+  /** @brief Index of the first point of a brick */
+  __host__ __device__ int BrickOffset(int bx, int by, int bz) const
+  {
+    return ((bz * fBricks[1] + by) * fBricks[0] + bx) * kBrickSize;
+  }
+
+  /** @brief Index of a point in a brick */
+  __host__ __device__ static int PointOffset(int i, int j, int k)
+  {
+    return (k * kBrickPoints + j) * kBrickPoints + i;
+  }
+
+  /** @brief Interpolated field at a global position, zero outside of the grid */
+  __host__ __device__ vecgeom::Vector3D<double> Evaluate(vecgeom::Vector3D<double> const &position) const
+  {
+    int cell[3];
+    double frac[3];
+    for (int i = 0; i < 3; ++i) {
+      const double u = (position[i] - fOrigin[i]) * fInvSpacing[i];
+      if (!(u >= 0 && u <= fCells[i])) return vecgeom::Vector3D<double>(0, 0, 0);
+      cell[i] = u < fCells[i] ? (int)u : fCells[i] - 1;
+      frac[i] = u - cell[i];
+    }
+
+    const Sample *base = fSamples + BrickOffset(cell[0] / kBrick, cell[1] / kBrick, cell[2] / kBrick) +
+                         PointOffset(cell[0] % kBrick, cell[1] % kBrick, cell[2] % kBrick);
+    constexpr int dy = kBrickPoints;
+    constexpr int dz = kBrickPoints * kBrickPoints;
+
+    double B[3];
+    for (int c = 0; c < 3; ++c) {
+      const double b00 = base[0].fB[c] + frac[0] * (base[1].fB[c] - base[0].fB[c]);
+      const double b10 = base[dy].fB[c] + frac[0] * (base[dy + 1].fB[c] - base[dy].fB[c]);
+      const double b01 = base[dz].fB[c] + frac[0] * (base[dz + 1].fB[c] - base[dz].fB[c]);
+      const double b11 = base[dz + dy].fB[c] + frac[0] * (base[dz + dy + 1].fB[c] - base[dz + dy].fB[c]);
+      const double b0  = b00 + frac[1] * (b10 - b00);
+      const double b1  = b01 + frac[1] * (b11 - b01);
+      B[c]             = b0 + frac[2] * (b1 - b0);
+    }
+    return vecgeom::Vector3D<double>(B[0], B[1], B[2]);
+  }
+}; // End class FieldMap
+
+/** @brief Owner of a field map: grid in the natural order, blocked samples and their device copy */
+class FieldMapBuilder {
+  using Sample = FieldMap::Sample;
+
+  FieldMapHeader fHeader;
+  std::vector<float> fGrid;     ///< Samples in tesla, natural order, as in the file
+  std::vector<Sample> fSamples; ///< Samples in internal units, blocked layout
+
+  sycl::queue *fQueue{nullptr};
+  Sample *fDeviceSamples{nullptr};
+
+  /** @brief Rearrange the grid into bricks, clamping the points of the bricks past the last cell */
+  void Reorder()
+  {
+    const FieldMap layout(nullptr, fHeader);
+    const int *n        = fHeader.fN;
+    const int bricks[3] = {layout.GetNumBricks(0), layout.GetNumBricks(1), layout.GetNumBricks(2)};
+    fSamples.resize((size_t)bricks[0] * bricks[1] * bricks[2] * FieldMap::kBrickSize);
+
+    for (int bz = 0; bz < bricks[2]; ++bz) {
+      for (int by = 0; by < bricks[1]; ++by) {
+        for (int bx = 0; bx < bricks[0]; ++bx) {
+          Sample *brick = fSamples.data() + layout.BrickOffset(bx, by, bz);
+          for (int k = 0; k < FieldMap::kBrickPoints; ++k) {
+            const int z = std::min(bz * FieldMap::kBrick + k, n[2] - 1);
+            for (int j = 0; j < FieldMap::kBrickPoints; ++j) {
+              const int y = std::min(by * FieldMap::kBrick + j, n[1] - 1);
+              for (int i = 0; i < FieldMap::kBrickPoints; ++i) {
+                const int x        = std::min(bx * FieldMap::kBrick + i, n[0] - 1);
+                const float *value = fGrid.data() + 3 * (((size_t)z * n[1] + y) * n[0] + x);
+                Sample &sample     = brick[FieldMap::PointOffset(i, j, k)];
+                for (int c = 0; c < 3; ++c) {
+                  sample.fB[c] = value[c] * copcore::units::tesla;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  static bool ValidHeader(FieldMapHeader const &header)
+  {
+    if (std::memcmp(header.fMagic, FieldMapHeader::kMagic, sizeof(header.fMagic)) != 0 ||
+        header.fVersion != FieldMapHeader::kVersion)
+      return false;
+    for (int i = 0; i < 3; ++i) {
+      if (header.fN[i] < 2 || !(header.fSpacing[i] > 0)) return false;
+    }
+    return true;
+  }
+
+public:
+  FieldMapBuilder() = default;
+
+  FieldMapBuilder(const FieldMapBuilder &) = delete;
+  FieldMapBuilder &operator=(const FieldMapBuilder &) = delete;
+
+  ~FieldMapBuilder() { FreeDevice(); }
+
+  /** @brief Sample field(x, y, z), returning a Vector3D in tesla, on a grid with origin and spacing in mm */
+  template <typename Field_t>
+  void Fill(const int n[3], const double origin[3], const double spacing[3], Field_t &&field)
+  {
+    std::memcpy(fHeader.fMagic, FieldMapHeader::kMagic, sizeof(fHeader.fMagic));
+    fHeader.fVersion = FieldMapHeader::kVersion;
+    for (int i = 0; i < 3; ++i) {
+      fHeader.fN[i]       = n[i];
+      fHeader.fOrigin[i]  = origin[i];
+      fHeader.fSpacing[i] = spacing[i];
+    }
+    if (!ValidHeader(fHeader)) COPCORE_EXCEPTION("FieldMapBuilder::Fill: invalid grid");
+
+    fGrid.resize(3 * (size_t)n[0] * n[1] * n[2]);
+    float *value = fGrid.data();
+    for (int z = 0; z < n[2]; ++z) {
+      for (int y = 0; y < n[1]; ++y) {
+        for (int x = 0; x < n[0]; ++x) {
+          const auto B = field(origin[0] + x * spacing[0], origin[1] + y * spacing[1], origin[2] + z * spacing[2]);
+          for (int c = 0; c < 3; ++c) {
+            *value++ = B[c];
+          }
+        }
+      }
+    }
+    Reorder();
+  }
+
+  /** @brief Write the grid to a file */
+  bool Save(std::string const &filename) const
+  {
+    if (Empty()) return false;
+    std::ofstream out(filename, std::ios::binary);
+    out.write((const char *)&fHeader, sizeof(fHeader));
+    out.write((const char *)fGrid.data(), sizeof(float) * fGrid.size());
+    return out.good();
+  }
+
+  /** @brief Read a grid from a file, checking its format version */
+  bool Load(std::string const &filename)
+  {
+    fGrid.clear();
+    fSamples.clear();
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) return false;
+    if (!in.read((char *)&fHeader, sizeof(fHeader)) || !ValidHeader(fHeader)) return false;
+    fGrid.resize(3 * (size_t)fHeader.fN[0] * fHeader.fN[1] * fHeader.fN[2]);
+    if (!in.read((char *)fGrid.data(), sizeof(float) * fGrid.size())) {
+      fGrid.clear();
+      return false;
+    }
+    Reorder();
+    return true;
+  }
+
+  bool Empty() const { return fSamples.empty(); }
+
+  FieldMapHeader const &GetHeader() const { return fHeader; }
+
+  /** @brief Size of the blocked samples, in bytes */
+  size_t GetSize() const { return sizeof(Sample) * fSamples.size(); }
+
+  /** @brief Access to the map in host memory, valid as long as the map is not reloaded */
+  FieldMap HostView() const { return Empty() ? FieldMap() : FieldMap(fSamples.data(), fHeader); }
+
+  /** @brief Copy the blocked samples to the device. They live until FreeDevice() or the destruction. */
+  FieldMap Upload(sycl::queue &queue)
+  {
+    FreeDevice();
+    if (Empty()) return FieldMap();
+    fQueue         = &queue;
+    fDeviceSamples = sycl::malloc_device<Sample>(fSamples.size(), queue);
+    if (!fDeviceSamples) COPCORE_EXCEPTION("FieldMapBuilder::Upload: cannot allocate device memory");
+    queue.memcpy(fDeviceSamples, fSamples.data(), GetSize()).wait_and_throw();
+    return FieldMap(fDeviceSamples, fHeader);
+  }
+
+  /** @brief Release the device copy */
+  void FreeDevice()
+  {
+    if (fDeviceSamples) sycl::free(fDeviceSamples, *fQueue);
+    fDeviceSamples = nullptr;
+  }
+}; // End class FieldMapBuilder
+
+#endif // FIELD_1FIELDMAP_H_
@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file FieldPolicy.h
+ * @brief Compile-time choice of the magnetic field seen by the transport kernels.
+ *
+ * @details The kernels transporting charged particles are instantiated for each policy, so that the
+ * propagation code of the fields not in use is compiled out: without field, the tracks go straight
+ * with plain navigator calls. The strength of the uniform field is a run-time value, passed to the
+ * kernels as a SYCL specialization constant so that changing it does not need recompiling.
+ */
+
+#ifndef FIELD_1FIELDPOLICY_H_
+#define FIELD_1FIELDPOLICY_H_
+
+/** @brief Field handled by an instantiation of a transport kernel */
+enum class FieldPolicy {
+  None,       ///< No field, straight-line transport
+  UniformBz,  ///< Uniform field along z, see fieldPropagatorConstBz
+  UniformAny, ///< Uniform field of any direction, see fieldPropagatorConstBany
+  Map         ///< Field tabulated on a grid, see FieldMap and fieldPropagatorRungeKutta
+};
+
+/** @brief Components of a uniform field, trivially copyable to be a specialization constant */
+struct UniformField {
+  float fB[3]; ///< Field components in internal units
+
+  bool IsZero() const { return fB[0] == 0 && fB[1] == 0 && fB[2] == 0; }
+  bool IsAlongZ() const { return fB[0] == 0 && fB[1] == 0; }
+
+  /** @brief Cheapest policy able to handle the field, if there is no field map */
+  FieldPolicy Policy() const
+  {
+    if (IsZero()) return FieldPolicy::None;
+    return IsAlongZ() ? FieldPolicy::UniformBz : FieldPolicy::UniformAny;
+  }
+
+  static const char *Name(FieldPolicy policy)
+  {
+    switch (policy) {
+    case FieldPolicy::None:
+      return "none";
+    case FieldPolicy::UniformBz:
+      return "uniform Bz";
+    case FieldPolicy::UniformAny:
+      return "uniform";
+    case FieldPolicy::Map:
+      return "map";
+    }
+    return "unknown";
+  }
+};
+
+#endif // FIELD_1FIELDPOLICY_H_
@@ -0,0 +1,159 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file HelixBatch.h
+ * @brief Helix steps in a uniform field for batches of tracks stored as structures of arrays.
+ *
+ * @details A HelixBatch holds pointers to separate arrays of position and direction components, charges,
+ * momenta and steps; the positions and directions are updated in place. HelixBatchStepper steps such a
+ * batch in three ways:
+ *  - DoStep(batch, i) steps a single track with ConstBzFieldStepper or ConstFieldHelixStepper. In a SYCL
+ *    kernel with one track per work item, the work items of a sub-group read and write consecutive
+ *    elements of each array, and all of them take the same branch as the field is the same;
+ *  - Submit(queue, batch) launches such a kernel over the whole batch;
+ *  - DoStepHost(batch) steps the batch on the host by vectors of VecCore SIMD type, the remainder being
+ *    done with scalars. The helix is written once, for the field of any direction, with the math
+ *    functions of VecCore.
+ */
+
+#ifndef FIELD_1HELIXBATCH_H_
+#define FIELD_1HELIXBATCH_H_
+
+#include <CL/sycl.hpp>
+
+#include <VecGeom/base/Global.h>
+
+#include <Field/1/ConstBzFieldStepper.h>
+#include <Field/1/ConstFieldHelixStepper.h>
+
+/** @brief Structure of arrays of a batch of tracks */
+struct HelixBatch {
+  double *fPos[3];         ///< Position components, updated by the step
+  double *fDir[3];         ///< Direction components, updated by the step
+  const int *fCharge;      ///< Charges in units of e+
+  const double *fMomentum; ///< Momentum magnitudes
+  const double *fStep;     ///< Path lengths to step
+  int fSize;               ///< Number of tracks
+};
+
+/** @brief Stepper of batches of tracks in a uniform field */
+class HelixBatchStepper {
+  ConstBzFieldStepper fStepperBz;
+  ConstFieldHelixStepper fStepperAny;
+  double fUnit[3]{0, 0, 1}; ///< Direction of the field
+  double fBmag{0};          ///< Magnitude of the field
+  bool fAlongZ{true};
+
+  /** @brief Step the tracks from i on, by a vector of Real_t lanes */
+  template <typename Real_t>
+  void StepLanes(HelixBatch const &batch, int i) const
+  {
+    using vecCore::math::Abs;
+    using vecCore::math::Cos;
+    using vecCore::math::Sin;
+
+    Real_t pos[3], dir[3], momentum, step, charge;
+    for (int c = 0; c < 3; ++c) {
+      vecCore::Load(pos[c], batch.fPos[c] + i);
+      vecCore::Load(dir[c], batch.fDir[c] + i);
+    }
+    vecCore::Load(momentum, batch.fMomentum + i);
+    vecCore::Load(step, batch.fStep + i);
+    for (size_t lane = 0; lane < vecCore::VectorSize<Real_t>(); ++lane) {
+      vecCore::Set(charge, lane, (double)batch.fCharge[i + lane]);
+    }
+
+    // Split the direction into its component along the field, unchanged, and the one perpendicular to the
+    // field, which turns by phi towards turn = unit x dir.
+    const Real_t along = dir[0] * fUnit[0] + dir[1] * fUnit[1] + dir[2] * fUnit[2];
+    Real_t perp[3], turn[3];
+    for (int c = 0; c < 3; ++c) {
+      perp[c] = dir[c] - along * fUnit[c];
+    }
+    turn[0] = fUnit[1] * dir[2] - fUnit[2] * dir[1];
+    turn[1] = fUnit[2] * dir[0] - fUnit[0] * dir[2];
+    turn[2] = fUnit[0] * dir[1] - fUnit[1] * dir[0];
+
+    const Real_t phi = step * charge * Real_t(ConstBzFieldStepper::kB2C * fBmag) / momentum;
+
+    // sin(phi) / phi and (1 - cos(phi)) / phi, with their expansions for small angles and no field.
+    const auto small     = Abs(phi) < Real_t(1.e-4);
+    const Real_t phiSafe = vecCore::Blend(small, Real_t(1), phi);
+    const Real_t sinphi  = Sin(phi);
+    const Real_t cosphi  = Cos(phi);
+    const Real_t sinc    = vecCore::Blend(small, Real_t(1) - phi * phi / Real_t(6), Sin(phiSafe) / phiSafe);
+    const Real_t cosc    = vecCore::Blend(small, Real_t(0.5) * phi, (Real_t(1) - Cos(phiSafe)) / phiSafe);
+
+    for (int c = 0; c < 3; ++c) {
+      const Real_t newPos = pos[c] + step * (along * fUnit[c] + sinc * perp[c] + cosc * turn[c]);
+      const Real_t newDir = along * fUnit[c] + cosphi * perp[c] + sinphi * turn[c];
+      vecCore::Store(newPos, batch.fPos[c] + i);
+      vecCore::Store(newDir, batch.fDir[c] + i);
+    }
+  }
+
+public:
+  HelixBatchStepper(float Bx, float By, float Bz) : fStepperBz(Bz), fStepperAny(Bx, By, Bz)
+  {
+    fBmag   = std::sqrt((double)Bx * Bx + (double)By * By + (double)Bz * Bz);
+    fAlongZ = Bx == 0 && By == 0;
+    if (fBmag > 0) {
+      fUnit[0] = Bx / fBmag;
+      fUnit[1] = By / fBmag;
+      fUnit[2] = Bz / fBmag;
+    }
+  }
+
+  /** @brief Step track i of the batch with the scalar steppers */
+  __host__ __device__ void DoStep(HelixBatch const &batch, int i) const
+  {
+    const double pos[3] = {batch.fPos[0][i], batch.fPos[1][i], batch.fPos[2][i]};
+    const double dir[3] = {batch.fDir[0][i], batch.fDir[1][i], batch.fDir[2][i]};
+    const int charge    = batch.fCharge[i];
+    const double step   = batch.fStep[i];
+    double newPos[3], newDir[3];
+
+    if (charge == 0 || fBmag == 0) {
+      for (int c = 0; c < 3; ++c) {
+        newPos[c] = pos[c] + step * dir[c];
+        newDir[c] = dir[c];
+      }
+    } else if (fAlongZ) {
+      fStepperBz.DoStep(pos[0], pos[1], pos[2], dir[0], dir[1], dir[2], charge, batch.fMomentum[i], step, newPos[0],
+                        newPos[1], newPos[2], newDir[0], newDir[1], newDir[2]);
+    } else {
+      fStepperAny.DoStep(pos[0], pos[1], pos[2], dir[0], dir[1], dir[2], charge, batch.fMomentum[i], step, newPos[0],
+                         newPos[1], newPos[2], newDir[0], newDir[1], newDir[2]);
+    }
+
+    for (int c = 0; c < 3; ++c) {
+      batch.fPos[c][i] = newPos[c];
+      batch.fDir[c][i] = newDir[c];
+    }
+  }
+
+  /** @brief Step the whole batch on the device, one track per work item. The arrays must be USM. */
+  sycl::event Submit(sycl::queue &queue, HelixBatch const &batch) const
+  {
+    const HelixBatchStepper stepper = *this;
+    const HelixBatch tracks         = batch;
+    return queue.parallel_for(sycl::range<1>(batch.fSize), [=](sycl::id<1> i) { stepper.DoStep(tracks, i[0]); });
+  }
+
+  /** @brief Step the whole batch on the host, by vectors of Real_v */
+  template <typename Real_v = vecgeom::VectorBackend::Real_v>
+  void DoStepHost(HelixBatch const &batch) const
+  {
+    const int width = (int)vecCore::VectorSize<Real_v>();
+    int i           = 0;
+    for (; i + width <= batch.fSize; i += width) {
+      StepLanes<Real_v>(batch, i);
+    }
+    for (; i < batch.fSize; ++i) {
+      StepLanes<double>(batch, i);
+    }
+  }
+}; // End class HelixBatchStepper
+
+#endif // FIELD_1HELIXBATCH_H_
@@ -0,0 +1,35 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file LooperThresholds.h
+ * @brief Criteria for killing charged tracks looping in a magnetic field.
+ */
+
+#ifndef FIELD_1LOOPERTHRESHOLDS_H_
+#define FIELD_1LOOPERTHRESHOLDS_H_
+
+#include <CopCore/1/SystemOfUnits.h>
+
+// Thresholds for loopers: charged tracks circling in the field without reaching a volume boundary.
+// Tracks at or above fImportantEnergy are never killed. Below fWarningEnergy a track is a looper after
+// fMaxStepsLow steps without crossing a boundary, and between the two energies the number of allowed
+// steps grows linearly up to fMaxStepsHigh. At any energy below fImportantEnergy, a path length of more
+// than fMaxTurns helix turns without crossing a boundary also makes a looper.
+struct LooperThresholds {
+  double fWarningEnergy   = 100 * copcore::units::MeV;
+  double fImportantEnergy = 250 * copcore::units::MeV;
+  int fMaxStepsLow        = 1000;
+  int fMaxStepsHigh       = 10000;
+  double fMaxTurns        = 10;
+  bool fDeposit           = true; // Deposit the energy of killed loopers locally, otherwise it is lost
+
+  int MaxSteps(double kinE) const
+  {
+    if (kinE <= fWarningEnergy) return fMaxStepsLow;
+    double fraction = (kinE - fWarningEnergy) / (fImportantEnergy - fWarningEnergy);
+    return fMaxStepsLow + (int)(fraction * (fMaxStepsHigh - fMaxStepsLow));
+  }
+};
+
+#endif // FIELD_1LOOPERTHRESHOLDS_H_
@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file RungeKuttaStepper.h
+ * @brief Embedded Runge-Kutta integration of charged tracks in a non-uniform magnetic field.
+ *
+ * @details The state is the position and the unit direction, integrated over the path length s:
+ *   d(position)/ds  = direction
+ *   d(direction)/ds = kB2C * charge / momentum * (B(position) x direction)
+ * Each step is a Cash-Karp step, whose embedded 4th order solution gives an estimate of the error of
+ * the 5th order one. The driver splits a requested length into substeps small enough for this error
+ * to stay within a relative tolerance. The field is any type with an Evaluate(position) method returning
+ * the field vector in internal units, such as FieldMap.
+ */
+
+#ifndef FIELD_1RUNGEKUTTASTEPPER_H_
+#define FIELD_1RUNGEKUTTASTEPPER_H_
+
+#include <CopCore/1/SystemOfUnits.h>
+
+#include <VecGeom/base/Vector3D.h>
+
+#include <Field/1/ConstFieldHelixStepper.h>
+
+#include <algorithm>
+
+#if (defined( __SYCL_DEVICE_ONLY__))
+#define pow sycl::pow
+#else
+#define pow std::pow
+#endif
+
+template <typename Field_t>
+class RungeKuttaStepper {
+  using Vector_t = vecgeom::Vector3D<double>;
+
+public:
+  static constexpr double kB2C      = ConstFieldHelixStepper::kB2C;
+  static constexpr int kMaxSubsteps = 100;
+
+  RungeKuttaStepper(Field_t const &field, double epsilon = 1.e-5) : fField(field), fEpsilon(epsilon) {}
+
+  Field_t const &GetField() const { return fField; }
+
+  /** @brief Integrate over a path length, in substeps keeping the estimated error within the tolerance */
+  void DoStep(Vector_t const &position, Vector_t const &direction, int charge, double momentum, double step,
+              Vector_t &endPosition, Vector_t &endDirection) const
+  {
+    const double k = kB2C * charge / momentum;
+    Vector_t pos   = position;
+    Vector_t dir   = direction;
+    double done    = 0;
+    double h       = step;
+    int substeps   = 0;
+
+    while (done < step) {
+      const bool last = h >= step - done;
+      if (last) h = step - done;
+      Vector_t newPos, newDir;
+      const double error = CashKarpStep(pos, dir, k, h, newPos, newDir);
+
+      // Accept the step within the tolerance, or anyway once the maximum number of substeps is reached.
+      if (error <= 1. || ++substeps >= kMaxSubsteps) {
+        pos = newPos;
+        dir = newDir.Unit();
+        done = last ? step : done + h;
+        h *= error > 1.89e-4 ? 0.9 * pow(error, -0.2) : 5.;
+      } else {
+        h *= std::max(0.9 * pow(error, -0.25), 0.1);
+      }
+    }
+
+    endPosition  = pos;
+    endDirection = dir;
+  }
+
+private:
+  Field_t fField;
+  double fEpsilon; ///< Tolerance on the relative error of the position and on the error of the direction
+
+  Vector_t Derivative(Vector_t const &pos, Vector_t const &dir, double k) const
+  {
+    return k * fField.Evaluate(pos).Cross(dir);
+  }
+
+  /** @brief One Cash-Karp step, returning the error estimate in units of the tolerance */
+  double CashKarpStep(Vector_t const &pos, Vector_t const &dir, double k, double h, Vector_t &newPos,
+                      Vector_t &newDir) const
+  {
+    constexpr double b21 = 0.2;
+    constexpr double b31 = 3. / 40., b32 = 9. / 40.;
+    constexpr double b41 = 0.3, b42 = -0.9, b43 = 1.2;
+    constexpr double b51 = -11. / 54., b52 = 2.5, b53 = -70. / 27., b54 = 35. / 27.;
+    constexpr double b61 = 1631. / 55296., b62 = 175. / 512., b63 = 575. / 13824., b64 = 44275. / 110592.,
+                     b65 = 253. / 4096.;
+    constexpr double c1 = 37. / 378., c3 = 250. / 621., c4 = 125. / 594., c6 = 512. / 1771.;
+    constexpr double dc1 = c1 - 2825. / 27648., dc3 = c3 - 18575. / 48384., dc4 = c4 - 13525. / 55296.,
+                     dc5 = -277. / 14336., dc6 = c6 - 0.25;
+
+    // The derivative of the position is the direction, the one of the direction depends on the field.
+    const Vector_t &x1 = dir;
+    const Vector_t d1  = Derivative(pos, x1, k);
+
+    const Vector_t x2 = dir + h * b21 * d1;
+    const Vector_t d2 = Derivative(pos + h * b21 * x1, x2, k);
+
+    const Vector_t x3 = dir + h * (b31 * d1 + b32 * d2);
+    const Vector_t d3 = Derivative(pos + h * (b31 * x1 + b32 * x2), x3, k);
+
+    const Vector_t x4 = dir + h * (b41 * d1 + b42 * d2 + b43 * d3);
+    const Vector_t d4 = Derivative(pos + h * (b41 * x1 + b42 * x2 + b43 * x3), x4, k);
+
+    const Vector_t x5 = dir + h * (b51 * d1 + b52 * d2 + b53 * d3 + b54 * d4);
+    const Vector_t d5 = Derivative(pos + h * (b51 * x1 + b52 * x2 + b53 * x3 + b54 * x4), x5, k);
+
+    const Vector_t x6 = dir + h * (b61 * d1 + b62 * d2 + b63 * d3 + b64 * d4 + b65 * d5);
+    const Vector_t d6 = Derivative(pos + h * (b61 * x1 + b62 * x2 + b63 * x3 + b64 * x4 + b65 * x5), x6, k);
+
+    newPos = pos + h * (c1 * x1 + c3 * x3 + c4 * x4 + c6 * x6);
+    newDir = dir + h * (c1 * d1 + c3 * d3 + c4 * d4 + c6 * d6);
+
+    const Vector_t errPos = h * (dc1 * x1 + dc3 * x3 + dc4 * x4 + dc5 * x5 + dc6 * x6);
+    const Vector_t errDir = h * (dc1 * d1 + dc3 * d3 + dc4 * d4 + dc5 * d5 + dc6 * d6);
+    return std::max(errPos.Mag() / (fEpsilon * h), errDir.Mag() / fEpsilon);
+  }
+}; // End class RungeKuttaStepper
+
+#endif // FIELD_1RUNGEKUTTASTEPPER_H_
@@ -7,9 +7,12 @@
 #define FIELD_PROPAGATOR_CONST_BANY_H
 
 #include <VecGeom/base/Vector3D.h>
+#include <CopCore/1/PhysicalConstants.h>
 
-#include <Field/ConstBzFieldStepper.h>
-#include <Field/ConstFieldHelixStepper.h>
+#include <AdePT/1/LoopNavigator.h>
+
+#include <Field/1/ConstFieldHelixStepper.h>
+#include <Field/1/LooperThresholds.h>
 
 #if (defined( __SYCL_DEVICE_ONLY__))
 #define log sycl::log
@@ -36,9 +39,56 @@
 
 class fieldPropagatorConstBany {
 public:
+  fieldPropagatorConstBany(float Bx, float By, float Bz) : fBfield(Bx, By, Bz), fHelix(Bx, By, Bz) {}
+
   __host__ __device__ void stepInField(ConstFieldHelixStepper &helixAnyB, double kinE, double mass, int charge,
                                        double step, vecgeom::Vector3D<double> &position,
                                        vecgeom::Vector3D<double> &direction);
+
+  void stepInField(double kinE, double mass, int charge, double step, vecgeom::Vector3D<double> &position,
+                   vecgeom::Vector3D<double> &direction)
+  {
+    stepInField(fHelix, kinE, mass, charge, step, position, direction);
+  }
+
+  // Determine the step along the helix, as fieldPropagatorConstBz does for a field along z.
+  template <bool Relocate = true>
+  double ComputeStepAndPropagatedState(double kinE, double mass, int charge, double physicsStep,
+                                       vecgeom::Vector3D<double> &position, vecgeom::Vector3D<double> &direction,
+                                       vecgeom::NavStateIndex const &current_state, vecgeom::NavStateIndex &new_state,
+                                       adept::DaughterBVH const *bvh     = nullptr,
+                                       adept::DaughterBatch const *batch = nullptr);
+
+  // Same as above, using and updating the isotropic safety cached for the track.
+  template <bool Relocate = true>
+  double ComputeStepAndPropagatedState(double kinE, double mass, int charge, double physicsStep,
+                                       vecgeom::Vector3D<double> &position, vecgeom::Vector3D<double> &direction,
+                                       vecgeom::NavStateIndex const &current_state,
+                                       vecgeom::NavStateIndex &new_state, vecgeom::Precision &safety,
+                                       adept::DaughterBVH const *bvh     = nullptr,
+                                       adept::DaughterBatch const *batch = nullptr);
+
+  // Path length of one full turn of the helix, for a track moving perpendicular to the field.
+  double TurnLength(double kinE, double mass, int charge) const
+  {
+    double momentumMag = sqrt(kinE * (kinE + 2.0 * mass));
+    return copcore::units::kTwoPi * momentumMag / fabs(ConstFieldHelixStepper::kB2C * charge * fBfield.Mag());
+  }
+
+  // Whether a track that did numSteps steps over pathLength since it last crossed a boundary is a looper.
+  bool IsLooper(LooperThresholds const &thresholds, double kinE, double mass, int charge, int numSteps,
+                double pathLength) const
+  {
+    if (charge == 0 || fBfield.Mag2() == 0 || kinE >= thresholds.fImportantEnergy) return false;
+    if (numSteps > thresholds.MaxSteps(kinE)) return true;
+    return pathLength > thresholds.fMaxTurns * TurnLength(kinE, mass, charge);
+  }
+
+private:
+  static constexpr double kPush = 1.e-8 * copcore::units::cm;
+
+  vecgeom::Vector3D<float> fBfield;
+  ConstFieldHelixStepper fHelix;
 };
 
 // ----------------------------------------------------------------------------
@@ -65,4 +115,112 @@ __host__ __device__ void fieldPropagatorConstBany::stepInField(ConstFieldHelixSt
   }
 }
 
+// Determine the step along curved trajectory for charged particles in the field, by chords limited
+// to a maximum deflection as in fieldPropagatorConstBz. Only the momentum component perpendicular
+// to the field matters for the curvature.
+template <bool Relocate>
+double fieldPropagatorConstBany::ComputeStepAndPropagatedState(
+    double kinE, double mass, int charge, double physicsStep, vecgeom::Vector3D<double> &position,
+    vecgeom::Vector3D<double> &direction, vecgeom::NavStateIndex const &current_state,
+    vecgeom::NavStateIndex &next_state, adept::DaughterBVH const *bvh, adept::DaughterBatch const *batch)
+{
+  double momentumMag = sqrt(kinE * (kinE + 2.0 * mass));
+  double bMag        = fBfield.Mag();
+  double dirAlongB   = direction[0] * fBfield[0] + direction[1] * fBfield[1] + direction[2] * fBfield[2];
+  double cosAlongB   = bMag > 0 ? dirAlongB / bMag : 1.0;
+  double momentumPerpMag =
+      momentumMag * sqrt((1. - cosAlongB) * (1. + cosAlongB)); // only this component matters for the curvature
+
+  double curv = fabs(ConstFieldHelixStepper::kB2C * charge * bMag) / (momentumPerpMag + 1.0e-30); // norm for step
+
+  constexpr double gEpsilonDeflect = 1.E-2 * copcore::units::cm;
+
+  double safeLength = sqrt(2 * gEpsilonDeflect / curv);
+
+  double stepDone = 0.0;
+  double remains  = physicsStep;
+
+  const double epsilon_step = 1.0e-7 * physicsStep; // Ignore remainder if < e_s * PhysicsStep
+
+  if (charge == 0) {
+#if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+    if (Relocate) {
+      stepDone = LoopNavigator::ComputeStepAndPropagatedState(position, direction, remains, current_state, next_state,
+                                                              bvh, batch);
+    } else {
+      stepDone = LoopNavigator::ComputeStepAndNextVolume(position, direction, remains, current_state, next_state, bvh,
+                                                         batch);
+    }
+#endif
+    position += (stepDone + kPush) * direction;
+  } else {
+    bool fullChord = false;
+
+    constexpr int maxChordIters = 10;
+    int chordIters              = 0;
+    do {
+      vecgeom::Vector3D<double> endPosition  = position;
+      vecgeom::Vector3D<double> endDirection = direction;
+      double safeMove                        = std::min(remains, safeLength);
+
+      fHelix.DoStep(position, direction, charge, momentumMag, safeMove, endPosition, endDirection);
+
+      vecgeom::Vector3D<double> chordVec = endPosition - position;
+      double chordLen                    = chordVec.Length();
+      vecgeom::Vector3D<double> chordDir = (1.0 / chordLen) * chordVec;
+
+      double move = chordLen;
+#if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+      if (Relocate) {
+        move = LoopNavigator::ComputeStepAndPropagatedState(position, chordDir, chordLen, current_state, next_state,
+                                                            bvh, batch);
+      } else {
+        move = LoopNavigator::ComputeStepAndNextVolume(position, chordDir, chordLen, current_state, next_state, bvh,
+                                                       batch);
+      }
+#endif
+
+      fullChord = (move == chordLen);
+      if (fullChord) {
+        position  = endPosition;
+        direction = endDirection;
+        move      = safeMove;
+      } else {
+        // Accept the intersection point on the chord, as in fieldPropagatorConstBz.
+        position = position + move * chordDir;
+
+        double fraction = chordLen > 0 ? move / chordLen : 0.0;
+        direction       = direction * (1.0 - fraction) + endDirection * fraction;
+        direction       = direction.Unit();
+      }
+      stepDone += move;
+      remains -= move;
+      chordIters++;
+
+    } while ((!next_state.IsOnBoundary()) && fullChord && (remains > epsilon_step) && (chordIters < maxChordIters));
+  }
+
+  return stepDone;
+}
+
+template <bool Relocate>
+double fieldPropagatorConstBany::ComputeStepAndPropagatedState(
+    double kinE, double mass, int charge, double physicsStep, vecgeom::Vector3D<double> &position,
+    vecgeom::Vector3D<double> &direction, vecgeom::NavStateIndex const &current_state,
+    vecgeom::NavStateIndex &next_state, vecgeom::Precision &safety, adept::DaughterBVH const *bvh,
+    adept::DaughterBatch const *batch)
+{
+#if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+  if (LoopNavigator::StepWithinSafety(position, physicsStep, current_state, next_state, safety, bvh)) {
+    stepInField(kinE, mass, charge, physicsStep, position, direction);
+    return physicsStep;
+  }
+#else
+  // Without the navigator, no safety is known.
+  safety = 0;
+#endif
+  return ComputeStepAndPropagatedState<Relocate>(kinE, mass, charge, physicsStep, position, direction, current_state,
+                                                 next_state, bvh, batch);
+}
+
 #endif
@@ -12,6 +12,7 @@
 #include <AdePT/1/LoopNavigator.h>
 
 #include <Field/1/ConstBzFieldStepper.h>
+#include <Field/1/LooperThresholds.h>
 
 #if (defined( __SYCL_DEVICE_ONLY__))
 #define log sycl::log
@@ -36,6 +37,7 @@
 #endif
 
 // Data structures for statistics of propagation chords
+#include <Field/1/ChordStatistics.h>
 
 class fieldPropagatorConstBz {
 public:
@@ -50,10 +52,68 @@ public:
                                                            vecgeom::Vector3D<double> &position,
                                                            vecgeom::Vector3D<double> &direction,
                                                            vecgeom::NavStateIndex const &current_state,
-                                                           vecgeom::NavStateIndex &new_state);
+                                                           vecgeom::NavStateIndex &new_state,
+                                                           adept::DaughterBVH const *bvh     = nullptr,
+                                                           adept::DaughterBatch const *batch = nullptr);
+
+  // Same as above, using and updating the isotropic safety cached for the track. If the whole helix
+  // arc stays within the safety (its distance from the start is bounded by ArcExtent), the full step is
+  // taken without any geometry query. Otherwise the chords that stay within the safety left are taken
+  // without navigation too, and only the others need the navigator.
+  template <bool Relocate = true>
+  double ComputeStepAndPropagatedState(double kinE, double mass, int charge, double physicsStep,
+                                       vecgeom::Vector3D<double> &position, vecgeom::Vector3D<double> &direction,
+                                       vecgeom::NavStateIndex const &current_state,
+                                       vecgeom::NavStateIndex &new_state, vecgeom::Precision &safety,
+                                       adept::DaughterBVH const *bvh     = nullptr,
+                                       adept::DaughterBatch const *batch = nullptr);
+
+  // Upper bound of the distance from its start of a helix arc of the given length: the arc advances by
+  // length * dirZ along z, and its projection on the xy plane is a circle arc whose chord is known.
+  double ArcExtent(double momentumMag, int charge, double length, double dirZ) const
+  {
+    const double sinTheta = sqrt((1. - dirZ) * (1. + dirZ));
+    double transverse     = length * sinTheta;
+    if (charge != 0 && BzValue != 0 && sinTheta > 0) {
+      const double radius    = momentumMag * sinTheta / fabs(ConstBzFieldStepper::kB2C * charge * BzValue);
+      const double halfAngle = 0.5 * transverse / radius;
+      transverse             = halfAngle < copcore::units::kHalfPi ? 2 * radius * sin(halfAngle) : 2 * radius;
+    }
+    const double along = length * dirZ;
+    return sqrt(along * along + transverse * transverse);
+  }
+
+  // Path length of one full turn of the helix.
+  double TurnLength(double kinE, double mass, int charge) const
+  {
+    double momentumMag = sqrt(kinE * (kinE + 2.0 * mass));
+    return copcore::units::kTwoPi * momentumMag / fabs(ConstBzFieldStepper::kB2C * charge * BzValue);
+  }
+
+  // Whether a track that did numSteps steps over pathLength since it last crossed a boundary is a looper.
+  bool IsLooper(LooperThresholds const &thresholds, double kinE, double mass, int charge, int numSteps,
+                double pathLength) const
+  {
+    if (charge == 0 || BzValue == 0 || kinE >= thresholds.fImportantEnergy) return false;
+    if (numSteps > thresholds.MaxSteps(kinE)) return true;
+    return pathLength > thresholds.fMaxTurns * TurnLength(kinE, mass, charge);
+  }
+
+  // Accumulate the chord statistics of the following calls into stats, which must stay valid (USM on
+  // the device). Nothing is recorded if stats is null.
+  void SetStatistics(ChordStatistics *stats) { fStats = stats; }
 
 private:
+  // Chord loop of the propagation, given the momentum of the track. If safety is not null, the chords
+  // staying within it are taken without navigation, and it is updated.
+  template <bool Relocate>
+  double PropagateInChords(double momentumMag, int charge, double physicsStep, vecgeom::Vector3D<double> &position,
+                           vecgeom::Vector3D<double> &direction, vecgeom::NavStateIndex const &current_state,
+                           vecgeom::NavStateIndex &next_state, vecgeom::Precision *safety,
+                           adept::DaughterBVH const *bvh, adept::DaughterBatch const *batch);
+
   float BzValue;
+  ChordStatistics *fStats{nullptr};
 };
 
 constexpr double kPushField = 1.e-8 * copcore::units::cm;
@@ -88,9 +148,21 @@ template <bool Relocate>
 double fieldPropagatorConstBz::ComputeStepAndPropagatedState(
     double kinE, double mass, int charge, double physicsStep, vecgeom::Vector3D<double> &position,
     vecgeom::Vector3D<double> &direction, vecgeom::NavStateIndex const &current_state,
-    vecgeom::NavStateIndex &next_state)
+    vecgeom::NavStateIndex &next_state, adept::DaughterBVH const *bvh, adept::DaughterBatch const *batch)
 {
   double momentumMag = sqrt(kinE * (kinE + 2.0 * mass));
+  return PropagateInChords<Relocate>(momentumMag, charge, physicsStep, position, direction, current_state, next_state,
+                                     nullptr, bvh, batch);
+}
+
+template <bool Relocate>
+double fieldPropagatorConstBz::PropagateInChords(double momentumMag, int charge, double physicsStep,
+                                                 vecgeom::Vector3D<double> &position,
+                                                 vecgeom::Vector3D<double> &direction,
+                                                 vecgeom::NavStateIndex const &current_state,
+                                                 vecgeom::NavStateIndex &next_state, vecgeom::Precision *safety,
+                                                 adept::DaughterBVH const *bvh, adept::DaughterBatch const *batch)
+{
   double momentumXYMag =
       momentumMag * sqrt((1. - direction[2]) * (1. + direction[2])); // only XY component matters for the curvature
 
@@ -108,11 +180,15 @@ double fieldPropagatorConstBz::ComputeStepAndPropagatedState(
   const double epsilon_step = 1.0e-7 * physicsStep; // Ignore remainder if < e_s * PhysicsStep
 
   if (charge == 0) {
-    // if (Relocate) {
-    //   stepDone = LoopNavigator::ComputeStepAndPropagatedState(position, direction, remains, current_state, next_state);
-    // } else {
-    //   stepDone = LoopNavigator::ComputeStepAndNextVolume(position, direction, remains, current_state, next_state);
-    // }
+#if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+    if (Relocate) {
+      stepDone = LoopNavigator::ComputeStepAndPropagatedState(position, direction, remains, current_state, next_state,
+                                                              bvh, batch);
+    } else {
+      stepDone = LoopNavigator::ComputeStepAndNextVolume(position, direction, remains, current_state, next_state, bvh,
+                                                         batch);
+    }
+#endif
     position += (stepDone + kPushField) * direction;
   } else {
     bool fullChord = false;
@@ -121,26 +197,56 @@ double fieldPropagatorConstBz::ComputeStepAndPropagatedState(
     //    volume (including daughters).
     //  Most electron tracks are short, limited by physics interactions -- the expected
     //    average value of iterations is small.
-    //    ( Measuring iterations to confirm the maximum. )
-    constexpr int maxChordIters = 10;
+    //    ( Measuring iterations in ChordStatistics, if enabled. )
+    constexpr int maxChordIters = ChordStatistics::kMaxChordIters;
     int chordIters              = 0;
+    int navigations             = 0;
     do {
       vecgeom::Vector3D<double> endPosition  = position;
       vecgeom::Vector3D<double> endDirection = direction;
       double safeMove                        = std::min(remains, safeLength);
 
+      // Within the safety there is no intersection to locate and the helix step is exact: take the
+      // longest arc that provably stays inside, else at least the chord if it does.
+      double extent = 0.0;
+      bool inSafety = false;
+      if (safety != nullptr && *safety > 0) {
+        const double arc = std::min(remains, std::max(safeMove, (double)*safety));
+        extent           = ArcExtent(momentumMag, charge, arc, direction[2]);
+        if (extent < *safety) {
+          safeMove = arc;
+          inSafety = true;
+        } else {
+          extent   = ArcExtent(momentumMag, charge, safeMove, direction[2]);
+          inSafety = extent < *safety;
+        }
+      }
+
       helixBz.DoStep(position, direction, charge, momentumMag, safeMove, endPosition, endDirection);
 
       vecgeom::Vector3D<double> chordVec = endPosition - position;
       double chordLen                    = chordVec.Length();
       vecgeom::Vector3D<double> chordDir = (1.0 / chordLen) * chordVec;
 
-      double move;
-      // if (Relocate) {
-      //   move = LoopNavigator::ComputeStepAndPropagatedState(position, chordDir, chordLen, current_state, next_state);
-      // } else {
-      //   move = LoopNavigator::ComputeStepAndNextVolume(position, chordDir, chordLen, current_state, next_state);
-      // }
+      double move = chordLen;
+      if (inSafety) {
+        current_state.CopyTo(&next_state);
+        next_state.SetBoundaryState(false);
+        *safety -= extent;
+      } else {
+#if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+        if (Relocate) {
+          move = LoopNavigator::ComputeStepAndPropagatedState(position, chordDir, chordLen, current_state, next_state,
+                                                              bvh, batch);
+        } else {
+          move = LoopNavigator::ComputeStepAndNextVolume(position, chordDir, chordLen, current_state, next_state, bvh,
+                                                         batch);
+        }
+        navigations++;
+#endif
+        // The safety is not known at the end of a navigated chord.
+        if (safety != nullptr) *safety = 0;
+      }
 
       fullChord = (move == chordLen);
       if (fullChord) {
@@ -165,7 +271,39 @@ double fieldPropagatorConstBz::ComputeStepAndPropagatedState(
       chordIters++;
 
     } while ((!next_state.IsOnBoundary()) && fullChord && (remains > epsilon_step) && (chordIters < maxChordIters));
+
+    if (fStats != nullptr) fStats->Record(chordIters, navigations);
   }
 
   return stepDone;
 }
+
+template <bool Relocate>
+double fieldPropagatorConstBz::ComputeStepAndPropagatedState(
+    double kinE, double mass, int charge, double physicsStep, vecgeom::Vector3D<double> &position,
+    vecgeom::Vector3D<double> &direction, vecgeom::NavStateIndex const &current_state,
+    vecgeom::NavStateIndex &next_state, vecgeom::Precision &safety, adept::DaughterBVH const *bvh,
+    adept::DaughterBatch const *batch)
+{
+  double momentumMag = sqrt(kinE * (kinE + 2.0 * mass));
+  double extent      = ArcExtent(momentumMag, charge, physicsStep, direction[2]);
+#if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+  // A point on a boundary has no safety, see LoopNavigator::StepWithinSafety.
+  if (extent >= safety && !current_state.IsOnBoundary())
+    safety = LoopNavigator::ComputeSafety(position, current_state, bvh);
+#else
+  // Without the navigator, no safety is known.
+  safety = 0;
+#endif
+  if (extent < safety) {
+    current_state.CopyTo(&next_state);
+    next_state.SetBoundaryState(false);
+    safety -= extent;
+    stepInField(kinE, mass, charge, physicsStep, position, direction);
+    if (fStats != nullptr && charge != 0) fStats->Record(0, 0);
+    return physicsStep;
+  }
+  // The safety just computed still accepts the first chords of the loop.
+  return PropagateInChords<Relocate>(momentumMag, charge, physicsStep, position, direction, current_state, next_state,
+                                     &safety, bvh, batch);
+}
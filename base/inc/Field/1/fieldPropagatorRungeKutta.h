@@ -0,0 +1,184 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef FIELD_PROPAGATOR_RUNGE_KUTTA_H
+#define FIELD_PROPAGATOR_RUNGE_KUTTA_H
+
+#include <VecGeom/base/Vector3D.h>
+#include <CopCore/1/PhysicalConstants.h>
+
+#include <AdePT/1/LoopNavigator.h>
+
+#include <Field/1/LooperThresholds.h>
+#include <Field/1/RungeKuttaStepper.h>
+
+#if (defined( __SYCL_DEVICE_ONLY__))
+#define fabs sycl::fabs
+#else
+#define fabs std::fabs
+#endif
+
+// Propagation in a non-uniform field, such as a FieldMap, with the same interface as the propagators of
+// uniform fields. The trajectory is integrated by RungeKuttaStepper over chords limited to a maximum
+// deflection, computed from the field at the start of each chord.
+template <typename Field_t>
+class fieldPropagatorRungeKutta {
+public:
+  fieldPropagatorRungeKutta(Field_t const &field, double epsilon = 1.e-5) : fStepper(field, epsilon) {}
+
+  void stepInField(double kinE, double mass, int charge, double step, vecgeom::Vector3D<double> &position,
+                   vecgeom::Vector3D<double> &direction)
+  {
+    if (charge != 0) {
+      double momentumMag                     = sqrt(kinE * (kinE + 2.0 * mass));
+      vecgeom::Vector3D<double> endPosition  = position;
+      vecgeom::Vector3D<double> endDirection = direction;
+      fStepper.DoStep(position, direction, charge, momentumMag, step, endPosition, endDirection);
+      position  = endPosition;
+      direction = endDirection;
+    } else {
+      position = position + step * direction;
+    }
+  }
+
+  template <bool Relocate = true>
+  double ComputeStepAndPropagatedState(double kinE, double mass, int charge, double physicsStep,
+                                       vecgeom::Vector3D<double> &position, vecgeom::Vector3D<double> &direction,
+                                       vecgeom::NavStateIndex const &current_state, vecgeom::NavStateIndex &next_state,
+                                       adept::DaughterBVH const *bvh     = nullptr,
+                                       adept::DaughterBatch const *batch = nullptr);
+
+  // Same as above, using and updating the isotropic safety cached for the track.
+  template <bool Relocate = true>
+  double ComputeStepAndPropagatedState(double kinE, double mass, int charge, double physicsStep,
+                                       vecgeom::Vector3D<double> &position, vecgeom::Vector3D<double> &direction,
+                                       vecgeom::NavStateIndex const &current_state,
+                                       vecgeom::NavStateIndex &next_state, vecgeom::Precision &safety,
+                                       adept::DaughterBVH const *bvh     = nullptr,
+                                       adept::DaughterBatch const *batch = nullptr)
+  {
+    fLastField = fStepper.GetField().Evaluate(position).Mag();
+#if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+    if (LoopNavigator::StepWithinSafety(position, physicsStep, current_state, next_state, safety, bvh)) {
+      stepInField(kinE, mass, charge, physicsStep, position, direction);
+      return physicsStep;
+    }
+#else
+    // Without the navigator, no safety is known.
+    safety = 0;
+#endif
+    return ComputeStepAndPropagatedState<Relocate>(kinE, mass, charge, physicsStep, position, direction,
+                                                   current_state, next_state, bvh, batch);
+  }
+
+  // Path length of one full turn of the helix in the field at the start of the last step.
+  double TurnLength(double kinE, double mass, int charge) const
+  {
+    double momentumMag = sqrt(kinE * (kinE + 2.0 * mass));
+    return copcore::units::kTwoPi * momentumMag / fabs(RungeKuttaStepper<Field_t>::kB2C * charge * fLastField);
+  }
+
+  // Whether a track that did numSteps steps over pathLength since it last crossed a boundary is a looper.
+  // Must be called after propagating the track, as the turn length depends on the local field.
+  bool IsLooper(LooperThresholds const &thresholds, double kinE, double mass, int charge, int numSteps,
+                double pathLength) const
+  {
+    if (charge == 0 || kinE >= thresholds.fImportantEnergy) return false;
+    if (numSteps > thresholds.MaxSteps(kinE)) return true;
+    return fLastField > 0 && pathLength > thresholds.fMaxTurns * TurnLength(kinE, mass, charge);
+  }
+
+private:
+  static constexpr double kPush = 1.e-8 * copcore::units::cm;
+
+  RungeKuttaStepper<Field_t> fStepper;
+  double fLastField{0}; ///< Magnitude of the field at the start of the last step
+};
+
+// -----------------------------------------------------------------------------
+
+template <typename Field_t>
+template <bool Relocate>
+double fieldPropagatorRungeKutta<Field_t>::ComputeStepAndPropagatedState(
+    double kinE, double mass, int charge, double physicsStep, vecgeom::Vector3D<double> &position,
+    vecgeom::Vector3D<double> &direction, vecgeom::NavStateIndex const &current_state,
+    vecgeom::NavStateIndex &next_state, adept::DaughterBVH const *bvh, adept::DaughterBatch const *batch)
+{
+  double momentumMag = sqrt(kinE * (kinE + 2.0 * mass));
+
+  constexpr double gEpsilonDeflect = 1.E-2 * copcore::units::cm;
+
+  double stepDone = 0.0;
+  double remains  = physicsStep;
+
+  const double epsilon_step = 1.0e-7 * physicsStep; // Ignore remainder if < e_s * PhysicsStep
+
+  if (charge == 0) {
+#if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+    if (Relocate) {
+      stepDone = LoopNavigator::ComputeStepAndPropagatedState(position, direction, remains, current_state, next_state,
+                                                              bvh, batch);
+    } else {
+      stepDone = LoopNavigator::ComputeStepAndNextVolume(position, direction, remains, current_state, next_state, bvh,
+                                                         batch);
+    }
+#endif
+    position += (stepDone + kPush) * direction;
+    return stepDone;
+  }
+
+  bool fullChord = false;
+
+  constexpr int maxChordIters = 10;
+  int chordIters              = 0;
+  do {
+    // Curvature from the field component perpendicular to the direction at the start of the chord.
+    const vecgeom::Vector3D<double> B = fStepper.GetField().Evaluate(position);
+    fLastField                        = B.Mag();
+    double curv = fabs(RungeKuttaStepper<Field_t>::kB2C * charge) * B.Cross(direction).Mag() / momentumMag;
+    double safeLength = curv > 0 ? sqrt(2 * gEpsilonDeflect / curv) : remains;
+
+    vecgeom::Vector3D<double> endPosition  = position;
+    vecgeom::Vector3D<double> endDirection = direction;
+    double safeMove                        = std::min(remains, safeLength);
+
+    fStepper.DoStep(position, direction, charge, momentumMag, safeMove, endPosition, endDirection);
+
+    vecgeom::Vector3D<double> chordVec = endPosition - position;
+    double chordLen                    = chordVec.Length();
+    vecgeom::Vector3D<double> chordDir = (1.0 / chordLen) * chordVec;
+
+    double move = chordLen;
+#if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+    if (Relocate) {
+      move = LoopNavigator::ComputeStepAndPropagatedState(position, chordDir, chordLen, current_state, next_state,
+                                                          bvh, batch);
+    } else {
+      move = LoopNavigator::ComputeStepAndNextVolume(position, chordDir, chordLen, current_state, next_state, bvh,
+                                                     batch);
+    }
+#endif
+
+    fullChord = (move == chordLen);
+    if (fullChord) {
+      position  = endPosition;
+      direction = endDirection;
+      move      = safeMove;
+    } else {
+      // Accept the intersection point on the chord, as in fieldPropagatorConstBz.
+      position = position + move * chordDir;
+
+      double fraction = chordLen > 0 ? move / chordLen : 0.0;
+      direction       = direction * (1.0 - fraction) + endDirection * fraction;
+      direction       = direction.Unit();
+    }
+    stepDone += move;
+    remains -= move;
+    chordIters++;
+
+  } while ((!next_state.IsOnBoundary()) && fullChord && (remains > epsilon_step) && (chordIters < maxChordIters));
+
+  return stepDone;
+}
+
+#endif
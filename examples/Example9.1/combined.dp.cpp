@@ -50,7 +50,7 @@ void TransportElectrons(Track *electrons, const adept::MParray *active, Secondar
 {
   constexpr int Charge  = IsElectron ? -1 : 1;
   constexpr double Mass = copcore::units::kElectronMassC2;
-  fieldPropagatorConstBz fieldPropagatorBz(BzFieldValue);
+  fieldPropagatorConstBz fieldPropagatorBz(DefaultField.fB[2]);
  
   int activeSize = active->size();
   for (int i = item_ct1.get_group(2) * item_ct1.get_local_range().get(2) +
@@ -5,7 +5,9 @@
 #include "example9.dp.hpp"
 #include <stdlib.h>
 
+#include <Field/1/fieldPropagatorConstBany.h>
 #include <Field/1/fieldPropagatorConstBz.h>
+#include <Field/1/fieldPropagatorRungeKutta.h>
 #include <CopCore/1/PhysicalConstants.h>
 #include <G4HepEmElectronManager.hh>
 #include <G4HepEmElectronTrack.hh>
@@ -46,13 +48,65 @@
 #include <G4HepEmPositronInteractionAnnihilation.icc>
 
 
+// Annihilate a positron at rest into two gammas heading to opposite directions (isotropic).
+static void AnnihilateAtRest(Track &positron, Secondaries &secondaries, GlobalScoring *scoring)
+{
+  Track &gamma1 = secondaries.gammas.NextTrack();
+  Track &gamma2 = secondaries.gammas.NextTrack();
+
+  sycl::atomic<int>(sycl::global_ptr<int>(&scoring->secondaries))
+      .fetch_add(2);
+
+  const double cost = 2 * positron.Uniform() - 1;
+  const double sint = sqrt(1 - cost * cost);
+  const double phi  = k2Pi * positron.Uniform();
+  double sinPhi, cosPhi;
+
+  cosPhi = cos(phi);
+  sinPhi = sin(phi);
+  sinPhi = sycl::sincos(phi, sycl::make_ptr<double, sycl::access::address_space::global_space>(&cosPhi));
+
+  gamma1.InitAsSecondary(positron);
+  gamma1.energy = copcore::units::kElectronMassC2;
+  gamma1.dir.Set(sint * cosPhi, sint * sinPhi, cost);
+
+  gamma2.InitAsSecondary(positron);
+  gamma2.energy = copcore::units::kElectronMassC2;
+  gamma2.dir    = -gamma1.dir;
+}
+
+// Propagator of the field policy: the uniform field propagators, or none for straight-line transport.
+template <FieldPolicy Field>
+struct FieldPropagator {
+  using Type = fieldPropagatorConstBz;
+  static Type Make(UniformField const &field, FieldMap const &) { return Type(field.fB[2]); }
+};
+
+template <>
+struct FieldPropagator<FieldPolicy::UniformAny> {
+  using Type = fieldPropagatorConstBany;
+  static Type Make(UniformField const &field, FieldMap const &)
+  {
+    return Type(field.fB[0], field.fB[1], field.fB[2]);
+  }
+};
+
+template <>
+struct FieldPropagator<FieldPolicy::Map> {
+  using Type = fieldPropagatorRungeKutta<FieldMap>;
+  static Type Make(UniformField const &, FieldMap const &fieldMap) { return Type(fieldMap); }
+};
+
 // Compute the physics and geometry step limit, transport the electrons while
 // applying the continuous effects and maybe a discrete process that could
 // generate secondaries.
-template <bool IsElectron>
+template <bool IsElectron, FieldPolicy Field>
 void TransportElectrons(Track *electrons, const adept::MParray *active, Secondaries secondaries,
                         adept::MParray *activeQueue , adept::MParray *relocateQueue, GlobalScoring *scoring,
-			                  sycl::nd_item<3> item_ct1,
+                        double energyCut, adept::DaughterBVH bvh, adept::DaughterBatch batch,
+                        adept::RelocationCache relocationCache, const int *volumeMCIndex, UniformField field,
+                        FieldMap fieldMap,
+                        ChordStatistics *chordStats, LooperThresholds loopers, sycl::nd_item<3> item_ct1,
                         struct G4HepEmElectronManager *electronManager_p,
                         struct G4HepEmParameters *g4HepEmPars_p,
                         struct G4HepEmData *g4HepEmData_p)
@@ -60,7 +114,11 @@ void TransportElectrons(Track *electrons, const adept::MParray *active, Secondar
 
   constexpr int Charge  = IsElectron ? -1 : 1;
   constexpr double Mass = copcore::units::kElectronMassC2;
-  fieldPropagatorConstBz fieldPropagatorBz(BzFieldValue);
+  // Without field, the propagator is built but never used.
+  auto fieldPropagator = FieldPropagator<Field>::Make(field, fieldMap);
+  if constexpr (Field == FieldPolicy::UniformBz) {
+    fieldPropagator.SetStatistics(chordStats);
+  }
  
   int activeSize = active->size();
   for (int i = item_ct1.get_group(2) * item_ct1.get_local_range().get(2) +
@@ -70,18 +128,31 @@ void TransportElectrons(Track *electrons, const adept::MParray *active, Secondar
 
     const int slot      = (*active)[i];
     Track &currentTrack = electrons[slot];
-    auto volume         = currentTrack.currentState.Top();
+    auto volume         = currentTrack.navState.Top();
     if (volume == nullptr) {
       // The particle left the world, kill it by not enqueuing into activeQueue.
       continue;
     }
 
+    if (currentTrack.energy < energyCut) {
+      // Below the tracking cut: deposit the energy locally and kill the track. A positron still
+      // annihilates at rest.
+      dpct::atomic_fetch_add(&scoring->energyDeposit, currentTrack.energy);
+      scoring->profile.Score(currentTrack.pos.x(), currentTrack.energy);
+      dpct::atomic_fetch_add(&scoring->cutEnergy, currentTrack.energy);
+      sycl::atomic<int>(sycl::global_ptr<int>(&scoring->cutTracks)).fetch_add(1);
+      if (!IsElectron) {
+        AnnihilateAtRest(currentTrack, secondaries, scoring);
+      }
+      continue;
+    }
+
     // Init a track with the needed data to call into G4HepEm.
     G4HepEmElectronTrack elTrack;
     G4HepEmTrack *theTrack = elTrack.GetTrack();
     theTrack->SetEKin(currentTrack.energy);
-    // For now, just assume a single material.
-    int theMCIndex = 1;
+    // Without material-cuts index per volume, assume a single material.
+    int theMCIndex = volumeMCIndex ? volumeMCIndex[volume->GetLogicalVolume()->id()] : 1;
     theTrack->SetMCIndex(theMCIndex);
     theTrack->SetCharge(Charge);
 
@@ -113,11 +184,32 @@ void TransportElectrons(Track *electrons, const adept::MParray *active, Secondar
     // Check if there's a volume boundary in between.
 
     double geometryStepLength = 1.0;
-        fieldPropagatorBz.ComputeStepAndPropagatedState<false>(
-        currentTrack.energy, Mass, Charge, geometricalStepLengthFromPhysics, currentTrack.pos, currentTrack.dir,
-        currentTrack.currentState, currentTrack.nextState);
+    // The step is computed in double, also when the direction is stored in single precision.
+    vecgeom::Vector3D<double> dir = adept::VectorCast<double>(currentTrack.dir);
+    // The state after the step is only stored in the track if it crosses a boundary.
+    const vecgeom::NavStateIndex currentState = currentTrack.navState.Unpack();
+    vecgeom::NavStateIndex nextState;
+    // Steps within the safety cached in the track skip the geometry queries.
+    if constexpr (Field == FieldPolicy::None) {
+      // Straight line: the same navigator calls as for gammas, no chords.
+      geometryStepLength = 0.0;
+    #if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
+      geometryStepLength = LoopNavigator::ComputeStepAndNextVolume(currentTrack.pos, dir,
+                                  geometricalStepLengthFromPhysics, currentState, nextState,
+                                  currentTrack.safety, &bvh, &batch);
+    #endif
+      currentTrack.pos += (geometryStepLength + kPushField) * dir;
+      currentTrack.safety = currentTrack.safety > kPushField ? currentTrack.safety - kPushField : 0;
+    } else {
+      // The navigator calls of the propagators are guarded for the device targets themselves. The chords
+      // are navigated with the same BVH and daughter batch as the straight steps.
+      geometryStepLength = fieldPropagator.template ComputeStepAndPropagatedState<false>(
+        currentTrack.energy, Mass, Charge, geometricalStepLengthFromPhysics, currentTrack.pos, dir,
+        currentState, nextState, currentTrack.safety, &bvh, &batch);
+      currentTrack.dir = adept::VectorCast<adept::Real_t>(dir);
+    }
 				
-    if (currentTrack.nextState.IsOnBoundary()) {
+    if (nextState.IsOnBoundary()) {
       theTrack->SetGStepLength(geometryStepLength);
       theTrack->SetOnBoundary(true);
     }
@@ -130,6 +222,7 @@ void TransportElectrons(Track *electrons, const adept::MParray *active, Secondar
 
     dpct::atomic_fetch_add(&scoring->energyDeposit,
                            theTrack->GetEnergyDeposit());
+    scoring->profile.Score(currentTrack.pos.x(), theTrack->GetEnergyDeposit());
 
     // Save the `number-of-interaction-left` in our track.
     for (int ip = 0; ip < 3; ++ip) {
@@ -140,36 +233,37 @@ void TransportElectrons(Track *electrons, const adept::MParray *active, Secondar
 
     if (stopped) {
       if (!IsElectron) {
-        // Annihilate the stopped positron into two gammas heading to opposite
-        // directions (isotropic).
-        Track &gamma1 = secondaries.gammas.NextTrack();
-        Track &gamma2 = secondaries.gammas.NextTrack();
-
-        sycl::atomic<int>(sycl::global_ptr<int>(&scoring->secondaries))
-            .fetch_add(2);
-
-        const double cost = 2 * currentTrack.Uniform() - 1;
-        const double sint = sqrt(1 - cost * cost);
-        const double phi  = k2Pi * currentTrack.Uniform();
-        double sinPhi, cosPhi;
-
-        cosPhi = cos(phi);
-        sinPhi = sin(phi);
-        sinPhi = sycl::sincos(phi, sycl::make_ptr<double, sycl::access::address_space::global_space>(&cosPhi));
-
-        gamma1.InitAsSecondary(currentTrack);
-        gamma1.energy = copcore::units::kElectronMassC2;
-        gamma1.dir.Set(sint * cosPhi, sint * sinPhi, cost);
-
-        gamma2.InitAsSecondary(currentTrack);
-        gamma2.energy = copcore::units::kElectronMassC2;
-        gamma2.dir    = -gamma1.dir;
+        AnnihilateAtRest(currentTrack, secondaries, scoring);
       }
       // Particles are killed by not enqueuing them into the new activeQueue.
       continue;
     }
 
-    if (currentTrack.nextState.IsOnBoundary()) {
+    // Count the steps and the path length since the last boundary crossing, and kill the track
+    // if it is looping in the field.
+    if (nextState.IsOnBoundary()) {
+      currentTrack.looperSteps  = 0;
+      currentTrack.looperLength = 0;
+    } else {
+      currentTrack.looperSteps++;
+      currentTrack.looperLength += geometryStepLength;
+      if (Field != FieldPolicy::None &&
+          fieldPropagator.IsLooper(loopers, currentTrack.energy, Mass, Charge, currentTrack.looperSteps,
+                                   currentTrack.looperLength)) {
+        if (loopers.fDeposit) {
+          dpct::atomic_fetch_add(&scoring->energyDeposit, currentTrack.energy);
+          scoring->profile.Score(currentTrack.pos.x(), currentTrack.energy);
+        }
+        dpct::atomic_fetch_add(&scoring->looperEnergy, currentTrack.energy);
+        sycl::atomic<int>(sycl::global_ptr<int>(&scoring->loopersKilled)).fetch_add(1);
+        if (!IsElectron) {
+          AnnihilateAtRest(currentTrack, secondaries, scoring);
+        }
+        continue;
+      }
+    }
+
+    if (nextState.IsOnBoundary()) {
       // For now, just count that we hit something.
 
       sycl::atomic<int>(sycl::global_ptr<int>(&scoring->hits)).fetch_add(1);
@@ -186,11 +280,12 @@ void TransportElectrons(Track *electrons, const adept::MParray *active, Secondar
       The .bc file needs to be passed to the llvm-link step of the compilation.
       */
       #if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
-        LoopNavigator::RelocateToNextVolume(currentTrack.pos, currentTrack.dir, currentTrack.nextState);
+        LoopNavigator::RelocateToNextVolume(currentTrack.pos, dir, currentState,
+                                            nextState, relocationCache, &bvh);
       #endif
 
       // Move to the next boundary.
-      currentTrack.SwapStates();
+      currentTrack.navState.Pack(nextState);
       continue;
     } else if (winnerProcessIndex < 0) {
       // No discrete process, move on.
@@ -313,20 +408,22 @@ void TransportElectrons(Track *electrons, const adept::MParray *active, Secondar
 
 }
 
-// Instantiate template for electrons and positrons.
-template void TransportElectrons<true>(Track *electrons, const adept::MParray *active,
-               Secondaries secondaries, adept::MParray *activeQueue,
-				       adept::MParray *relocateQueue, GlobalScoring *scoring,
-				       sycl::nd_item<3> item_ct1,
-               struct G4HepEmElectronManager *electronManager,
-               struct G4HepEmParameters *g4HepEmPars,
-               struct G4HepEmData *g4HepEmData);
-
-
-template void TransportElectrons<false>(Track *electrons, const adept::MParray *active,
-              Secondaries secondaries, adept::MParray *activeQueue,
-              adept::MParray *relocateQueue,GlobalScoring *scoring,
-              sycl::nd_item<3> item_ct1,
-              struct G4HepEmElectronManager *electronManager,
-              struct G4HepEmParameters *g4HepEmPars,
-              struct G4HepEmData *g4HepEmData);
\ No newline at end of file
+// Instantiate template for electrons and positrons, for each field policy.
+#define INSTANTIATE_TRANSPORT_ELECTRONS(IsElectron, Field)                                                           \
+  template void TransportElectrons<IsElectron, Field>(                                                                \
+      Track *electrons, const adept::MParray *active, Secondaries secondaries, adept::MParray *activeQueue,           \
+      adept::MParray *relocateQueue, GlobalScoring *scoring, double energyCut, adept::DaughterBVH bvh,               \
+      adept::DaughterBatch batch, adept::RelocationCache relocationCache, const int *volumeMCIndex,                  \
+      UniformField field, FieldMap fieldMap, ChordStatistics *chordStats, LooperThresholds loopers,                  \
+      sycl::nd_item<3> item_ct1, struct G4HepEmElectronManager *electronManager,                                     \
+      struct G4HepEmParameters *g4HepEmPars,                                                                         \
+      struct G4HepEmData *g4HepEmData);
+
+INSTANTIATE_TRANSPORT_ELECTRONS(true, FieldPolicy::None)
+INSTANTIATE_TRANSPORT_ELECTRONS(true, FieldPolicy::UniformBz)
+INSTANTIATE_TRANSPORT_ELECTRONS(true, FieldPolicy::UniformAny)
+INSTANTIATE_TRANSPORT_ELECTRONS(true, FieldPolicy::Map)
+INSTANTIATE_TRANSPORT_ELECTRONS(false, FieldPolicy::None)
+INSTANTIATE_TRANSPORT_ELECTRONS(false, FieldPolicy::UniformBz)
+INSTANTIATE_TRANSPORT_ELECTRONS(false, FieldPolicy::UniformAny)
+INSTANTIATE_TRANSPORT_ELECTRONS(false, FieldPolicy::Map)
@@ -7,6 +7,7 @@
 #include "example9.h"
 
 #include <AdePT/1/ArgParser.h>
+#include <AdePT/1/GeometryImage.h>
 #include <CopCore/1/SystemOfUnits.h>
 
 #include <G4NistManager.hh>
@@ -25,21 +26,152 @@
 #include <G4ProductionCuts.hh>
 #include <G4Region.hh>
 #include <G4ProductionCutsTable.hh>
+#include <G4MaterialCutsCouple.hh>
 
 #include <G4SystemOfUnits.hh>
 
 #include <VecGeom/base/Config.h>
 #include <VecGeom/management/GeoManager.h>
+#include <VecGeom/volumes/LogicalVolume.h>
+#include <VecGeom/volumes/UnplacedBox.h>
 #ifdef VECGEOM_GDML
 #include <VecGeom/gdml/Frontend.h>
 #endif
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 dpct::constant_memory<struct G4HepEmParameters, 0> g4HepEmPars;
 dpct::constant_memory<struct G4HepEmData, 0> g4HepEmData;
 dpct::global_memory<struct G4HepEmElectronManager, 0> electronManager;
 dpct::global_memory<struct G4HepEmGammaManager, 0> gammaManager;
 
-static void InitGeant4()
+// Parameters of a TestEm3-like sampling calorimeter: layers of absorber followed by gap along x, starting
+// right after the origin. Each layer can be segmented transversely into segments x segments cells.
+struct CalorimeterSpec {
+  int layers;
+  int segments;
+  double width; // transverse size of the calorimeter
+  std::string absorberMaterial;
+  double absorberThickness;
+  std::string gapMaterial;
+  double gapThickness;
+};
+
+// Materials of the calorimeter besides the world material, which need a material-cuts couple.
+static std::vector<G4Material *> CalorimeterMaterials(CalorimeterSpec const &spec)
+{
+  return {G4NistManager::Instance()->FindOrBuildMaterial(spec.absorberMaterial),
+          G4NistManager::Instance()->FindOrBuildMaterial(spec.gapMaterial)};
+}
+
+// Index of the couple of a material, in the Geant4 numbering.
+static int CoupleIndex(G4Material const *material)
+{
+  G4ProductionCutsTable *theCoupleTable = G4ProductionCutsTable::GetProductionCutsTable();
+  for (size_t i = 0; i < theCoupleTable->GetTableSize(); ++i) {
+    if (theCoupleTable->GetMaterialCutsCouple(i)->GetMaterial() == material) return i;
+  }
+  return -1;
+}
+
+// Whether the calorimeter can be built: known materials and at least one layer and one cell per layer.
+static bool CheckCalorimeter(CalorimeterSpec const &spec)
+{
+  bool ok = true;
+  for (auto const &name : {spec.absorberMaterial, spec.gapMaterial}) {
+    if (G4NistManager::Instance()->FindOrBuildMaterial(name) == nullptr) {
+      std::cout << "### Unknown material " << name << " for the calorimeter.\n";
+      ok = false;
+    }
+  }
+  if (spec.layers < 1 || spec.segments < 1) {
+    std::cout << "### The calorimeter needs at least one layer and one segment.\n";
+    ok = false;
+  }
+  if (!(spec.absorberThickness > 0) || !(spec.gapThickness > 0) || !(spec.width > 0)) {
+    std::cout << "### The absorber and gap thicknesses and the width of the calorimeter must be positive.\n";
+    ok = false;
+  }
+  return ok;
+}
+
+// Build the calorimeter in VecGeom and close the geometry. The Geant4 couple index of the material of every
+// logical volume is stored at its id in volumeCouples. Returns nullptr if a material has no couple.
+static const vecgeom::VPlacedVolume *BuildCalorimeter(CalorimeterSpec const &spec, std::vector<int> &volumeCouples)
+{
+  const double layerThickness = spec.absorberThickness + spec.gapThickness;
+  const double calorThickness = spec.layers * layerThickness;
+  const double cellWidth      = spec.width / spec.segments;
+  // Small gap between the primary vertex at the origin and the front face.
+  const double frontGap  = 1 * copcore::units::mm;
+  const double worldSize = 1.2 * std::max(2 * (calorThickness + frontGap), spec.width);
+
+  auto worldSolid    = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(0.5 * worldSize, 0.5 * worldSize,
+                                                                             0.5 * worldSize);
+  auto calorSolid    = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(0.5 * calorThickness, 0.5 * spec.width,
+                                                                            0.5 * spec.width);
+  auto layerSolid    = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(0.5 * layerThickness, 0.5 * spec.width,
+                                                                            0.5 * spec.width);
+  auto absorberSolid = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(0.5 * spec.absorberThickness,
+                                                                               0.5 * cellWidth, 0.5 * cellWidth);
+  auto gapSolid      = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(0.5 * spec.gapThickness,
+                                                                          0.5 * cellWidth, 0.5 * cellWidth);
+
+  auto world    = new vecgeom::LogicalVolume("world", worldSolid);
+  auto calor    = new vecgeom::LogicalVolume("calorimeter", calorSolid);
+  auto layer    = new vecgeom::LogicalVolume("layer", layerSolid);
+  auto absorber = new vecgeom::LogicalVolume("absorber", absorberSolid);
+  auto gap      = new vecgeom::LogicalVolume("gap", gapSolid);
+
+  // Without segmentation the absorber and the gap are placed directly in the layer.
+  vecgeom::LogicalVolume *cell = layer;
+  if (spec.segments > 1) {
+    auto cellSolid = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(0.5 * layerThickness, 0.5 * cellWidth,
+                                                                             0.5 * cellWidth);
+    cell           = new vecgeom::LogicalVolume("cell", cellSolid);
+    for (int iy = 0; iy < spec.segments; ++iy) {
+      for (int iz = 0; iz < spec.segments; ++iz) {
+        const double y = -0.5 * spec.width + (iy + 0.5) * cellWidth;
+        const double z = -0.5 * spec.width + (iz + 0.5) * cellWidth;
+        layer->PlaceDaughter("cell", cell, new vecgeom::Transformation3D(0, y, z));
+      }
+    }
+  }
+  cell->PlaceDaughter("absorber", absorber,
+                      new vecgeom::Transformation3D(-0.5 * layerThickness + 0.5 * spec.absorberThickness, 0, 0));
+  cell->PlaceDaughter("gap", gap, new vecgeom::Transformation3D(0.5 * layerThickness - 0.5 * spec.gapThickness, 0, 0));
+
+  for (int i = 0; i < spec.layers; ++i) {
+    const double x = -0.5 * calorThickness + (i + 0.5) * layerThickness;
+    calor->PlaceDaughter("layer", layer, new vecgeom::Transformation3D(x, 0, 0));
+  }
+  world->PlaceDaughter("calorimeter", calor, new vecgeom::Transformation3D(0.5 * calorThickness + frontGap, 0, 0));
+
+  vecgeom::GeoManager::Instance().SetWorldAndClose(world->Place());
+
+  // Only the absorber and the gap are not made of the world material.
+  const auto materials = CalorimeterMaterials(spec);
+  const int worldCouple = CoupleIndex(G4NistManager::Instance()->FindOrBuildMaterial("G4_Galactic"));
+  volumeCouples.assign(vecgeom::GeoManager::Instance().GetRegisteredVolumesCount(), worldCouple);
+  volumeCouples[absorber->id()] = CoupleIndex(materials[0]);
+  volumeCouples[gap->id()]      = CoupleIndex(materials[1]);
+  for (int couple : {worldCouple, volumeCouples[absorber->id()], volumeCouples[gap->id()]}) {
+    if (couple < 0) {
+      std::cout << "### No material-cuts couple for a material of the calorimeter.\n";
+      return nullptr;
+    }
+  }
+
+  std::cout << "INFO: TestEm3 calorimeter with " << spec.layers << " layers of " << spec.absorberThickness
+            << " mm " << spec.absorberMaterial << " + " << spec.gapThickness << " mm " << spec.gapMaterial << ", "
+            << spec.segments << " x " << spec.segments << " cells\n";
+  return vecgeom::GeoManager::Instance().GetWorld();
+}
+
+// The extra materials are placed in small boxes, so that they get a couple in the world region.
+static void InitGeant4(std::vector<G4Material *> const &extraMaterials = {})
 {
   // --- Create materials.
   G4Material *galactic = G4NistManager::Instance()->FindOrBuildMaterial("G4_Galactic");
@@ -56,6 +188,14 @@ static void InitGeant4()
   G4Box *siliconBox           = new G4Box("silicon", boxDim, boxDim, boxDim);
   G4LogicalVolume *siliconLog = new G4LogicalVolume(siliconBox, silicon, "silicon");
   new G4PVPlacement(nullptr, {boxPos, boxPos, boxPos}, siliconLog, "silicon", worldLog, false, 0);
+  // --- Define a box per extra material, next to the silicon one.
+  G4double extraDim = 1 * cm;
+  G4Box *extraBox   = new G4Box("extra", extraDim, extraDim, extraDim);
+  for (size_t i = 0; i < extraMaterials.size(); ++i) {
+    G4LogicalVolume *extraLog = new G4LogicalVolume(extraBox, extraMaterials[i], extraMaterials[i]->GetName());
+    new G4PVPlacement(nullptr, {-0.9 * worldDim + 3 * i * extraDim, -0.9 * worldDim, -0.9 * worldDim}, extraLog,
+                      extraMaterials[i]->GetName(), worldLog, false, 0);
+  }
   //
   // --- Create particles that have secondary production threshold.
   G4Gamma::Gamma();
@@ -98,24 +238,119 @@ int main(int argc, char *argv[])
   struct G4HepEmData *g4HepEmData_p;
 
   OPTION_STRING(gdml_name, "trackML.gdml");
+  OPTION_STRING(geometry_image, ""); // geometry read from this image if it exists, else written to it after the GDML
   OPTION_INT(cache_depth, 0); // 0 = full depth
   OPTION_INT(particles, 1);
   OPTION_DOUBLE(energy, 100); // entered in GeV
+  OPTION_INT(capacity, 256 * 1024); // initial number of track slots per particle type
+  OPTION_BOOL(growable, false);     // grow the track storage instead of losing particles
+  OPTION_INT(spill, 0);             // active tracks per particle type above which tracks go to the host
+  OPTION_INT(schedule, 0);          // 0 = in order, 1 = most populated first, 2 = low energy first, 3 = bounded batch;
+                                    // 1 to 3 only act with a positive -batch
+  OPTION_INT(batch, 0);             // tracks transported per iteration (per particle type for schedule 3), 0 = all
+  OPTION_DOUBLE(electron_cut, 0);   // tracking cuts, entered in keV
+  OPTION_DOUBLE(positron_cut, 0);
+  OPTION_DOUBLE(gamma_cut, 0);
+  OPTION_BOOL(bvh, true);           // search the daughters through hierarchies, else by blocks of boxes and tubes
+  OPTION_INT(relocation_cache, 16); // log2 of the entries of the relocation cache, 0 = no cache
+  OPTION_BOOL(relocation_stats, false); // count the lookups, hits and stores of the relocation cache
+  OPTION_BOOL(calorimeter, false);  // build a TestEm3-like calorimeter instead of reading the GDML file
+  OPTION_INT(layers, 50);
+  OPTION_INT(segments, 1);          // transverse cells per layer along y and z
+  OPTION_DOUBLE(calorimeter_width, 400); // entered in mm
+  OPTION_STRING(absorber, "G4_Pb");
+  OPTION_DOUBLE(absorber_thickness, 2.3); // entered in mm
+  OPTION_STRING(gap, "G4_lAr");
+  OPTION_DOUBLE(gap_thickness, 5.7); // entered in mm
+  OPTION_DOUBLE(bx, 0);             // uniform field, entered in tesla
+  OPTION_DOUBLE(by, 0);
+  OPTION_DOUBLE(bz, DefaultField.fB[2] / copcore::units::tesla);
+  OPTION_STRING(field_map, "");     // field map file, replacing the uniform field
+  OPTION_BOOL(chord_stats, false);  // statistics of the chords of the propagation in a field along z
+  OPTION_STRING(profile_file, "");  // energy deposit profile along x written to this file
+  OPTION_STRING(reference_profile, ""); // profile of a reference run, e.g. without mixed precision, to compare to
+  const LooperThresholds defaultLoopers;
+  OPTION_DOUBLE(looper_warning_energy, defaultLoopers.fWarningEnergy / copcore::units::MeV); // entered in MeV
+  OPTION_DOUBLE(looper_important_energy, defaultLoopers.fImportantEnergy / copcore::units::MeV); // never killed above
+  OPTION_INT(looper_steps_low, defaultLoopers.fMaxStepsLow);   // steps without a boundary below the warning energy
+  OPTION_INT(looper_steps_high, defaultLoopers.fMaxStepsHigh); // steps without a boundary at the important energy
+  OPTION_DOUBLE(looper_turns, defaultLoopers.fMaxTurns);       // helix turns without a boundary
+  OPTION_BOOL(looper_deposit, defaultLoopers.fDeposit);        // deposit the energy of killed loopers, else lose it
   energy *= copcore::units::GeV;
 
-  InitGeant4();
+  Example9Options options;
+  options.capacity             = capacity;
+  options.growable             = growable;
+  options.spillWatermark       = spill;
+  options.schedule             = schedule;
+  options.batch                = batch;
+  options.cuts                 = {electron_cut * copcore::units::keV, positron_cut * copcore::units::keV,
+                                  gamma_cut * copcore::units::keV};
+  options.useBVH               = bvh;
+  options.relocationCacheBits  = relocation_cache;
+  options.relocationStatistics = relocation_stats;
+  options.field                = {{float(bx * copcore::units::tesla), float(by * copcore::units::tesla),
+                                   float(bz * copcore::units::tesla)}};
+  options.fieldMapFile         = field_map;
+  options.chordStatistics      = chord_stats;
+  options.profileFile          = profile_file;
+  options.referenceProfile     = reference_profile;
+  options.loopers              = {looper_warning_energy * copcore::units::MeV,
+                                  looper_important_energy * copcore::units::MeV,
+                                  looper_steps_low,
+                                  looper_steps_high,
+                                  looper_turns,
+                                  looper_deposit};
+
+  CalorimeterSpec calorimeterSpec = {layers,
+                                     segments,
+                                     calorimeter_width * copcore::units::mm,
+                                     absorber,
+                                     absorber_thickness * copcore::units::mm,
+                                     gap,
+                                     gap_thickness * copcore::units::mm};
+
+  if (calorimeter && !geometry_image.empty()) {
+    std::cout << "### -geometry_image cannot be used with -calorimeter.\n";
+    return 5;
+  }
+  if (calorimeter && !CheckCalorimeter(calorimeterSpec)) return 5;
 
+  if (calorimeter) {
+    InitGeant4(CalorimeterMaterials(calorimeterSpec));
+  } else {
+    InitGeant4();
+  }
+
+  vecgeom::GeoManager::Instance().SetTransformationCacheDepth(cache_depth);
+  if (calorimeter) {
+    // The couple of the material of each logical volume is only known for the calorimeter.
+    if (!BuildCalorimeter(calorimeterSpec, options.volumeCouples)) return 5;
+  } else {
 // 14.08: this code issues undefined references when compiling step by step with -### 
 #ifdef VECGEOM_GDML
-  vecgeom::GeoManager::Instance().SetTransformationCacheDepth(cache_depth);
-  // The vecgeom millimeter unit is the last parameter of vgdml::Frontend::Load
-  bool load = vgdml::Frontend::Load(gdml_name.c_str(), false, copcore::units::mm);
-  if (!load) return 3;
+    adept::GeometryImage geometryImage;
+    if (!geometry_image.empty() && geometryImage.Load(geometry_image)) {
+      std::cout << "INFO: geometry read from image " << geometry_image << " (" << geometryImage.GetSize()
+                << " bytes)\n";
+      geometryImage.Instantiate();
+    } else {
+      // The vecgeom millimeter unit is the last parameter of vgdml::Frontend::Load
+      bool load = vgdml::Frontend::Load(gdml_name.c_str(), false, copcore::units::mm);
+      if (!load) return 3;
+      if (!geometry_image.empty()) {
+        if (!geometryImage.Build(vecgeom::GeoManager::Instance().GetWorld()))
+          std::cout << "WARNING: no geometry image written, the geometry has shapes other than box, trd and tube\n";
+        else if (geometryImage.Save(geometry_image))
+          std::cout << "INFO: geometry image written to " << geometry_image << "\n";
+      }
+    }
 #endif
+  }
 
   const vecgeom::VPlacedVolume *world = vecgeom::GeoManager::Instance().GetWorld();
 
   if (!world) return 4;
 
-  example9(world, particles, energy, electronManager_p, gammaManager_p, g4HepEmPars_p, g4HepEmData_p);
+  example9(world, particles, energy, electronManager_p, gammaManager_p, g4HepEmPars_p, g4HepEmData_p, options);
 }
@@ -7,12 +7,17 @@
 #include "example9.dp.hpp"
 
 #include <AdePT/1/Atomic.h>
+#include <AdePT/1/DeviceScan.h>
+#include <AdePT/1/GeometryImage.h>
 #include <AdePT/1/LoopNavigator.h>
 #include <AdePT/1/MParray.h>
 
+#include <CopCore/1/Allocator.h>
 #include <CopCore/1/Global.h>
 #include <CopCore/1/PhysicalConstants.h>
 #include <CopCore/1/Ranluxpp.h>
+#include <CopCore/1/UsmArena.h>
+#include <CopCore/1/UsmPool.h>
 
 #include <VecGeom/base/Config.h>
 #include <VecGeom/base/Stopwatch.h>
@@ -32,6 +37,12 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
 #include <stdio.h>
 #include <chrono>
 
@@ -173,7 +184,7 @@ void InitParticleQueues(ParticleQueues queues, size_t Capacity)
 
 // Kernel function to initialize a set of primary particles.
 SYCL_EXTERNAL void InitPrimaries(ParticleGenerator generator, int particles, double energy,
-		   const vecgeom::VPlacedVolume *world,
+		   const vecgeom::VPlacedVolume *world, adept::DaughterBVH bvh, adept::GeometryImageView geometry,
                               sycl::nd_item<3> item_ct1)
 {
   for (int i = item_ct1.get_group(2) * item_ct1.get_local_range().get(2) +
@@ -191,34 +202,670 @@ SYCL_EXTERNAL void InitPrimaries(ParticleGenerator generator, int particles, dou
     track.pos = {0, 0, 0};
     track.dir = {1.0, 0, 0};
 
-    LoopNavigator::LocatePointIn(world, track.pos, track.currentState, true);
-    // nextState is initialized as needed.
+    track.looperSteps  = 0;
+    track.looperLength = 0;
+    track.safety       = 0;
+
+    // The geometry image locates the point in place, VecGeom only if the image is not available.
+    vecgeom::NavStateIndex state;
+    if (geometry.Enabled() && geometry.GetNumNavIndex() > 0) {
+      state = vecgeom::NavStateIndex(geometry.LocatePoint(track.pos));
+    } else {
+      LoopNavigator::LocatePointIn(world, track.pos, state, true, &bvh);
+    }
+    track.navState.Pack(state);
   }
 }
 
+// The slot managers of the three particle types.
+struct AllSlotManagers {
+  SlotManager *slotManagers[ParticleType::NumParticleTypes];
+};
+
 // A data structure to transfer statistics after each iteration.
 struct Stats {
   GlobalScoring scoring;
   int inFlight[ParticleType::NumParticleTypes];
+  int usedSlots[ParticleType::NumParticleTypes];
+  // Set if a track slot or a queue entry was missing during the iteration.
+  int overflow;
+  // Mean energy of the active tracks, only computed on the host for the policies needing it.
+  double meanEnergy[ParticleType::NumParticleTypes];
 };
 
-// Finish iteration: clear queues and fill statistics.
-void FinishIteration(AllParticleQueues all, const GlobalScoring *scoring, Stats *stats)
+// Finish iteration: clear queues and fill statistics. After an overflow of an iteration that can be
+// restored, the queues of the tracks that were active are kept for the host.
+void FinishIteration(AllParticleQueues all, AllSlotManagers managers, const GlobalScoring *scoring, Stats *stats,
+                     bool restorable)
 {
-  stats->scoring = *scoring;
+  bool overflow = false;
   for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
-    all.queues[i].currentlyActive->clear();
+    overflow |= managers.slotManagers[i]->Overflowed() || all.queues[i].nextActive->overflowed() ||
+                all.queues[i].relocate->overflowed();
+  }
+
+  stats->scoring  = *scoring;
+  stats->overflow = overflow;
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    if (!overflow || !restorable) all.queues[i].currentlyActive->clear();
     stats->inFlight[i] = all.queues[i].nextActive->size();
     all.queues[i].relocate->clear();
+    stats->usedSlots[i] = managers.slotManagers[i]->UsedSlots();
+  }
+}
+
+// Scheduling policies choose, before each iteration, the order in which the particle types are
+// transported and how many of their active tracks. The remaining tracks are deferred to the next
+// iteration, which allows to control the size of the shower front. A new policy derives from
+// SchedulingPolicy, or from BudgetPolicy to only choose the order, and is added to Create().
+class SchedulingPolicy {
+public:
+  struct Decision {
+    int order[ParticleType::NumParticleTypes]; ///< Particle types in the order of transport
+    int batch[ParticleType::NumParticleTypes]; ///< Number of tracks to transport per particle type
+  };
+
+  virtual ~SchedulingPolicy() = default;
+
+  virtual const char *Name() const = 0;
+
+  // Whether the mean energies of the active tracks must be filled in the statistics before Schedule().
+  virtual bool NeedsMeanEnergy() const { return false; }
+
+  // Whether the policy only acts with a positive batch.
+  virtual bool NeedsBatch() const { return true; }
+
+  virtual void Schedule(const Stats &stats, Decision &decision) const = 0;
+
+  // Policy of the schedule option: 0 = in order, 1 = most populated first, 2 = low energy first,
+  // 3 = bounded batch. Unknown values give the in-order policy.
+  static std::unique_ptr<SchedulingPolicy> Create(int kind, int batch);
+};
+
+// Policies handing out a budget of tracks per iteration to the particle types in the order they choose;
+// a batch of zero means all active tracks. All particle types are then transported in every iteration
+// and their order does not matter, so these policies only act with a positive batch.
+class BudgetPolicy : public SchedulingPolicy {
+  int fBatch;
+
+protected:
+  // Sort the particle types, given in the default order.
+  virtual void Order(const Stats &stats, int *order) const = 0;
+
+public:
+  BudgetPolicy(int batch) : fBatch(batch) {}
+
+  void Schedule(const Stats &stats, Decision &decision) const override
+  {
+    for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+      decision.order[i] = i;
+    }
+    Order(stats, decision.order);
+
+    int budget = fBatch > 0 ? fBatch : std::numeric_limits<int>::max();
+    for (int k = 0; k < ParticleType::NumParticleTypes; k++) {
+      const int type       = decision.order[k];
+      decision.batch[type] = std::min(stats.inFlight[type], budget);
+      budget -= decision.batch[type];
+    }
+  }
+};
+
+// Electrons, positrons, then gammas, all active tracks or a budget of them
+class InOrderPolicy : public BudgetPolicy {
+protected:
+  void Order(const Stats &, int *) const override {}
+
+public:
+  using BudgetPolicy::BudgetPolicy;
+
+  const char *Name() const override { return "in-order"; }
+
+  bool NeedsBatch() const override { return false; }
+};
+
+// Particle types by decreasing number of active tracks
+class MostPopulatedFirstPolicy : public BudgetPolicy {
+protected:
+  void Order(const Stats &stats, int *order) const override
+  {
+    std::stable_sort(order, order + ParticleType::NumParticleTypes,
+                     [&](int a, int b) { return stats.inFlight[a] > stats.inFlight[b]; });
+  }
+
+public:
+  using BudgetPolicy::BudgetPolicy;
+
+  const char *Name() const override { return "most-populated-first"; }
+};
+
+// Particle types by increasing mean energy
+class LowEnergyFirstPolicy : public BudgetPolicy {
+protected:
+  void Order(const Stats &stats, int *order) const override
+  {
+    std::stable_sort(order, order + ParticleType::NumParticleTypes,
+                     [&](int a, int b) { return stats.meanEnergy[a] < stats.meanEnergy[b]; });
+  }
+
+public:
+  using BudgetPolicy::BudgetPolicy;
+
+  const char *Name() const override { return "low-energy-first"; }
+
+  bool NeedsMeanEnergy() const override { return true; }
+};
+
+// Electrons, positrons, then gammas, at most a fixed batch of each
+class BoundedBatchPolicy : public SchedulingPolicy {
+  int fBatch;
+
+public:
+  BoundedBatchPolicy(int batch) : fBatch(batch) {}
+
+  const char *Name() const override { return "bounded-batch"; }
+
+  void Schedule(const Stats &stats, Decision &decision) const override
+  {
+    const int batch = fBatch > 0 ? fBatch : std::numeric_limits<int>::max();
+    for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+      decision.order[i] = i;
+      decision.batch[i] = std::min(stats.inFlight[i], batch);
+    }
+  }
+};
+
+std::unique_ptr<SchedulingPolicy> SchedulingPolicy::Create(int kind, int batch)
+{
+  switch (kind) {
+  case 1:
+    return std::unique_ptr<SchedulingPolicy>(new MostPopulatedFirstPolicy(batch));
+  case 2:
+    return std::unique_ptr<SchedulingPolicy>(new LowEnergyFirstPolicy(batch));
+  case 3:
+    return std::unique_ptr<SchedulingPolicy>(new BoundedBatchPolicy(batch));
+  default:
+    return std::unique_ptr<SchedulingPolicy>(new InOrderPolicy(batch));
+  }
+}
+
+// Compute the mean energy of the active tracks of each particle type.
+static void ComputeMeanEnergies(sycl::queue &q_ct1, ParticleType *particles, Stats &stats, double *sums)
+{
+  q_ct1.memset(sums, 0, sizeof(double) * ParticleType::NumParticleTypes).wait();
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    const int numActive          = stats.inFlight[i];
+    const Track *tracks          = particles[i].tracks;
+    const adept::MParray *active = particles[i].queues.currentlyActive;
+    if (numActive == 0) continue;
+    q_ct1.parallel_for(sycl::range<1>(numActive), sycl::reduction(sums + i, sycl::plus<double>()),
+                       [=](sycl::id<1> j, auto &sum) { sum += tracks[(*active)[j]].energy; });
+  }
+  double hostSums[ParticleType::NumParticleTypes];
+  q_ct1.wait_and_throw();
+  q_ct1.memcpy(hostSums, sums, sizeof(hostSums)).wait();
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    stats.meanEnergy[i] = stats.inFlight[i] > 0 ? hostSums[i] / stats.inFlight[i] : 0;
+  }
+}
+
+// Move the active tracks of one particle type past the first numTransport to the queue of the next
+// iteration, so that only the first numTransport are transported in this one.
+static void DeferTracks(sycl::queue &q_ct1, ParticleType &particle, int numActive, int numTransport)
+{
+  adept::MParray *active     = particle.queues.currentlyActive;
+  adept::MParray *nextActive = particle.queues.nextActive;
+
+  auto defer = q_ct1.parallel_for(sycl::range<1>(numActive - numTransport),
+                                  [=](sycl::id<1> j) { nextActive->push_back((*active)[numTransport + j]); });
+  q_ct1.single_task(defer, [=]() { active->truncate(numTransport); }).wait_and_throw();
+}
+
+// Compact the track storage of one particle type: the live tracks, listed in the active queue, are
+// moved to a dense prefix of the spare buffer keeping their relative order, and their slot numbers
+// are rewritten in the queue. The spare buffer then becomes the track storage of the particle type.
+// The new slot of each live track is given by an exclusive scan over the flags of the live slots.
+static void CompactTracks(sycl::queue &q_ct1, ParticleType &particle, int usedSlots, int numActive, Track *&spare,
+                          int *flags, int *scratch)
+{
+  Track *tracks            = particle.tracks;
+  Track *compacted         = spare;
+  SlotManager *slotManager = particle.slotManager;
+  adept::MParray *active   = particle.queues.currentlyActive;
+
+  auto zero = q_ct1.memset(flags, 0, usedSlots * sizeof(int));
+  auto mark = q_ct1.parallel_for(sycl::range<1>(numActive), zero, [=](sycl::id<1> i) { flags[(*active)[i]] = 1; });
+  auto scan = adept::DeviceScan::ExclusiveScan(q_ct1, flags, flags, usedSlots, scratch, {mark});
+  auto move = q_ct1.parallel_for(sycl::range<1>(numActive), scan, [=](sycl::id<1> i) {
+    const int slot     = (*active)[i];
+    const int newSlot  = flags[slot];
+    compacted[newSlot] = tracks[slot];
+    (*active)[i]       = newSlot;
+  });
+  q_ct1.single_task(move, [=]() { slotManager->SetUsedSlots(numActive); }).wait_and_throw();
+
+  spare           = tracks;
+  particle.tracks = compacted;
+}
+
+// Pool of the smaller USM buffers of a run: statistics, spill stacks, volume indices and chord
+// statistics. It is kept between the runs and events of the process, so that the blocks released by a
+// run are handed out again to the next one.
+static std::unique_ptr<copcore::UsmPool> RetainedPool;
+
+static copcore::UsmPool &RunPool(sycl::queue const &queue)
+{
+  if (!RetainedPool) RetainedPool.reset(new copcore::UsmPool(queue));
+  return *RetainedPool;
+}
+
+// Stack of tracks of one particle type spilled to pinned host memory when too many of them are active
+// on the device. Kernels read and write the pinned memory directly. The most recently spilled tracks
+// are re-injected first, so that the shower is transported depth-first.
+class SpillStack {
+  copcore::UsmPool &fPool;
+  Track *fData{nullptr};
+  int fSize{0};
+  int fCapacity{0};
+
+public:
+  SpillStack(copcore::UsmPool &pool) : fPool(pool) {}
+  SpillStack(const SpillStack &) = delete;
+  SpillStack &operator=(const SpillStack &) = delete;
+  ~SpillStack() { fPool.Release(fData); }
+
+  // Make room for n more tracks and return where they go. Push(n) makes them part of the stack.
+  Track *Reserve(int n)
+  {
+    if (fSize + n > fCapacity) {
+      int capacity = std::max(2 * fCapacity, fSize + n);
+      Track *data  = (Track *)fPool.Allocate(sizeof(Track) * capacity, copcore::UsmKind::kHost);
+      if (fSize > 0) std::memcpy(data, fData, sizeof(Track) * fSize);
+      fPool.Release(fData);
+      fData     = data;
+      fCapacity = capacity;
+    }
+    return fData + fSize;
+  }
+
+  void Push(int n) { fSize += n; }
+
+  // The n tracks on top of the stack. Pop(n) removes them.
+  const Track *Top(int n) const { return fData + fSize - n; }
+
+  void Pop(int n) { fSize -= n; }
+
+  int Size() const { return fSize; }
+
+  int Capacity() const { return fCapacity; }
+};
+
+// Move the active tracks of one particle type past the first numKeep to the spill stack. Their slots
+// are dead afterwards and are reclaimed by the next compaction.
+static void SpillTracks(sycl::queue &q_ct1, ParticleType &particle, int numActive, int numKeep, SpillStack &stack)
+{
+  const int numSpill     = numActive - numKeep;
+  Track *spilled         = stack.Reserve(numSpill);
+  const Track *tracks    = particle.tracks;
+  adept::MParray *active = particle.queues.currentlyActive;
+
+  auto copy = q_ct1.parallel_for(sycl::range<1>(numSpill),
+                                 [=](sycl::id<1> j) { spilled[j] = tracks[(*active)[numKeep + j]]; });
+  q_ct1.single_task(copy, [=]() { active->truncate(numKeep); }).wait_and_throw();
+  stack.Push(numSpill);
+}
+
+// Move the numInject tracks on top of the spill stack back to new slots of one particle type and
+// append them to its active queue.
+static void ReinjectTracks(sycl::queue &q_ct1, ParticleType &particle, int numInject, SpillStack &stack)
+{
+  const Track *spilled     = stack.Top(numInject);
+  Track *tracks            = particle.tracks;
+  SlotManager *slotManager = particle.slotManager;
+  adept::MParray *active   = particle.queues.currentlyActive;
+
+  q_ct1
+      .parallel_for(sycl::range<1>(numInject),
+                    [=](sycl::id<1> j) {
+                      ParticleGenerator generator(tracks, slotManager, active);
+                      generator.NextTrack() = spilled[j];
+                    })
+      .wait_and_throw();
+  stack.Pop(numInject);
+}
+
+// The device buffers of a run besides those of the particle types, all sub-allocated from one arena.
+struct RunBuffers {
+  std::unique_ptr<copcore::UsmArena> arena;
+  int capacity{0};
+  GlobalScoring *scoring{nullptr};
+  Stats *stats{nullptr};
+  // Buffers needed for compacting the track storage.
+  Track *spareTracks{nullptr};
+  int *compactFlags{nullptr};
+  int *compactScratch{nullptr};
+  // Per particle type sums for the scheduling policies.
+  double *energySums{nullptr};
+  // Copies of the active tracks and of their slots taken before an iteration that may overflow, only
+  // in growable mode.
+  Track *checkpoints[ParticleType::NumParticleTypes]{};
+  int *checkpointSlots[ParticleType::NumParticleTypes]{};
+};
+
+// Arena kept between the runs and events of the process. A run takes it over if it is large enough and
+// gives it back at its end, so that only the first run, or one needing more memory, allocates.
+static std::unique_ptr<copcore::UsmArena> RetainedArena;
+
+// Carve out all device buffers of a run from an arena for the given capacity, initializing the slot
+// managers, queues and scoring. The retained arena is reset and reused if it is large enough, otherwise
+// it is released and a new one allocated. The track storage of each particle type has one overflow slot
+// past the capacity. The streams of the particle types are left untouched.
+static void AllocateRunBuffers(sycl::queue &q_ct1, int capacity, bool growable, ParticleType *particles,
+                               RunBuffers &buffers)
+{
+  // The buffers are added to the layout in the same order as they are allocated.
+  const size_t TracksSize  = sizeof(Track) * (capacity + 1);
+  const size_t ManagerSize = sizeof(SlotManager);
+  const size_t QueueSize   = adept::MParray::SizeOfAlignAware(capacity);
+
+  copcore::UsmArena::Layout layout;
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    layout.Add(TracksSize, copcore::UsmArena::kPage);
+    layout.Add(ManagerSize);
+    layout.Add(3 * QueueSize);
+  }
+  layout.Add(sizeof(GlobalScoring));
+  layout.Add(sizeof(Stats));
+  layout.Add(TracksSize, copcore::UsmArena::kPage);
+  layout.Add(sizeof(int) * capacity);
+  layout.Add(sizeof(int) * adept::DeviceScan::ScratchSize(capacity));
+  layout.Add(sizeof(double) * ParticleType::NumParticleTypes);
+  if (growable) {
+    for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+      layout.Add(TracksSize, copcore::UsmArena::kPage);
+      layout.Add(sizeof(int) * capacity);
+    }
+  }
+
+  if (RetainedArena && RetainedArena->Fits(layout)) {
+    RetainedArena->Reset();
+    buffers.arena = std::move(RetainedArena);
+  } else {
+    RetainedArena.reset();
+    buffers.arena.reset(new copcore::UsmArena(q_ct1, layout));
+  }
+  buffers.capacity = capacity;
+  auto &arena      = *buffers.arena;
+
+  SlotManager slotManagerInit(capacity);
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    particles[i].tracks = arena.Allocate<Track>(capacity + 1, copcore::UsmArena::kPage);
+
+    particles[i].slotManager = arena.Allocate<SlotManager>();
+    q_ct1.memcpy(particles[i].slotManager, &slotManagerInit, ManagerSize);
+
+    // The three queues of a particle type are contiguous.
+    char *queueBuffer                   = (char *)arena.Allocate(3 * QueueSize);
+    particles[i].queues.currentlyActive = (adept::MParray *)queueBuffer;
+    particles[i].queues.nextActive      = (adept::MParray *)(queueBuffer + QueueSize);
+    particles[i].queues.relocate        = (adept::MParray *)(queueBuffer + 2 * QueueSize);
+
+    auto queues = particles[i].queues;
+    q_ct1.single_task([=]() { InitParticleQueues(queues, capacity); });
+  }
+
+  buffers.scoring = arena.Allocate<GlobalScoring>();
+  q_ct1.memset(buffers.scoring, 0, sizeof(GlobalScoring));
+  buffers.stats = arena.Allocate<Stats>();
+
+  buffers.spareTracks    = arena.Allocate<Track>(capacity + 1, copcore::UsmArena::kPage);
+  buffers.compactFlags   = arena.Allocate<int>(capacity);
+  buffers.compactScratch = arena.Allocate<int>(adept::DeviceScan::ScratchSize(capacity));
+  buffers.energySums     = arena.Allocate<double>(ParticleType::NumParticleTypes);
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    buffers.checkpoints[i]     = growable ? arena.Allocate<Track>(capacity + 1, copcore::UsmArena::kPage) : nullptr;
+    buffers.checkpointSlots[i] = growable ? arena.Allocate<int>(capacity) : nullptr;
+  }
+
+  q_ct1.wait_and_throw();
+}
+
+// Upper bound on the number of slots taken by the secondaries of one iteration, per particle type.
+// A step creates at most one secondary, or two for the annihilation of a positron and the conversion
+// of a gamma.
+static void MaxNewSlots(const int *inFlight, int *newSlots)
+{
+  const int numElectrons = inFlight[ParticleType::Electron];
+  const int numPositrons = inFlight[ParticleType::Positron];
+  const int numGammas    = inFlight[ParticleType::Gamma];
+
+  newSlots[ParticleType::Electron] = numElectrons + numPositrons + numGammas;
+  newSlots[ParticleType::Positron] = numGammas;
+  newSlots[ParticleType::Gamma]    = numElectrons + 2 * numPositrons;
+}
+
+// Counters filled by the kernels besides the scoring: the chord statistics and the usage counters of
+// the relocation cache, when enabled. Their values are kept with the checkpoint of an iteration, so that
+// an iteration run again after growing the storage is only counted once.
+struct KernelCounters {
+  ChordStatistics *chordStats{nullptr};
+  adept::RelocationCacheStorage *relocationCache{nullptr};
+  ChordStatistics chords{};
+  adept::RelocationCacheStorage::Summary relocations{};
+};
+
+// Copy the active tracks of all particle types and their slots, and the kernel counters, before running
+// an iteration that may overflow. This must happen before the scheduling defers any track.
+static void CheckpointIteration(sycl::queue &q_ct1, ParticleType *particles, RunBuffers const &buffers,
+                                const Stats &before, KernelCounters &counters)
+{
+  if (counters.chordStats != nullptr) counters.chords = *counters.chordStats;
+  counters.relocations = counters.relocationCache->GetSummary();
+
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    const int numActive          = before.inFlight[i];
+    const Track *tracks          = particles[i].tracks;
+    Track *checkpoint            = buffers.checkpoints[i];
+    int *slots                   = buffers.checkpointSlots[i];
+    const adept::MParray *active = particles[i].queues.currentlyActive;
+    if (numActive == 0) continue;
+    q_ct1.parallel_for(sycl::range<1>(numActive), [=](sycl::id<1> j) {
+      slots[j]      = (*active)[j];
+      checkpoint[j] = tracks[slots[j]];
+    });
+  }
+  q_ct1.wait_and_throw();
+}
+
+// Undo an iteration that overflowed: restore the active tracks from their checkpoint, give back the
+// slots handed out during the iteration, empty the queues it filled and reset the scoring and the kernel
+// counters. The active queues are rebuilt from the checkpoint as well, which takes back the tracks
+// deferred to the next iteration by the scheduling. The entries stored in the relocation cache are kept,
+// they hold valid states.
+static void RestoreIteration(sycl::queue &q_ct1, ParticleType *particles, RunBuffers const &buffers,
+                             const Stats &before, KernelCounters const &counters)
+{
+  if (counters.chordStats != nullptr) *counters.chordStats = counters.chords;
+  counters.relocationCache->SetSummary(counters.relocations);
+
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    const int numActive      = before.inFlight[i];
+    const int usedSlots      = before.usedSlots[i];
+    Track *tracks            = particles[i].tracks;
+    const Track *checkpoint  = buffers.checkpoints[i];
+    const int *slots         = buffers.checkpointSlots[i];
+    SlotManager *slotManager = particles[i].slotManager;
+    ParticleQueues queues    = particles[i].queues;
+    adept::MParray *active   = queues.currentlyActive;
+    auto reset               = q_ct1.single_task([=]() {
+      slotManager->SetUsedSlots(usedSlots);
+      active->clear();
+      queues.nextActive->clear();
+      queues.relocate->clear();
+    });
+    if (numActive > 0) {
+      q_ct1.parallel_for(sycl::range<1>(numActive), reset, [=](sycl::id<1> j) {
+        tracks[slots[j]] = checkpoint[j];
+        active->push_back(slots[j]);
+      });
+    }
   }
+  q_ct1.memcpy(buffers.scoring, &before.scoring, sizeof(GlobalScoring));
+  q_ct1.wait_and_throw();
 }
 
-void example9(const vecgeom::VPlacedVolume *world, int numParticles, double energy, 
-              struct G4HepEmElectronManager *electronManager_p,
-              struct G4HepEmGammaManager *gammaManager_p,
-              struct G4HepEmParameters *g4HepEmPars_p,
-              struct G4HepEmData *g4HepEmData_p)
+// Move the state of a run to a new arena with a larger capacity. The used track slots, the slot
+// managers, the active queues and the scoring are copied; the old arena is released afterwards.
+static void GrowRunBuffers(sycl::queue &q_ct1, int capacity, bool growable, ParticleType *particles,
+                           RunBuffers &buffers, const Stats &current)
 {
+  ParticleType old[ParticleType::NumParticleTypes];
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    old[i].tracks      = particles[i].tracks;
+    old[i].slotManager = particles[i].slotManager;
+    old[i].queues      = particles[i].queues;
+  }
+
+  RunBuffers grown;
+  AllocateRunBuffers(q_ct1, capacity, growable, particles, grown);
+
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    const int numActive             = current.inFlight[i];
+    const int usedSlots             = current.usedSlots[i];
+    SlotManager *slotManager        = particles[i].slotManager;
+    adept::MParray *active          = particles[i].queues.currentlyActive;
+    const adept::MParray *oldActive = old[i].queues.currentlyActive;
+    q_ct1.memcpy(particles[i].tracks, old[i].tracks, sizeof(Track) * usedSlots);
+    q_ct1.single_task([=]() { slotManager->SetUsedSlots(usedSlots); });
+    if (numActive > 0) {
+      q_ct1.parallel_for(sycl::range<1>(numActive), [=](sycl::id<1> j) { active->push_back((*oldActive)[j]); });
+    }
+  }
+  q_ct1.memcpy(grown.scoring, &current.scoring, sizeof(GlobalScoring));
+  q_ct1.wait_and_throw();
+
+  buffers = std::move(grown);
+}
+
+// Arguments of the transport kernel of electrons or positrons, besides the field.
+struct ElectronTransportArgs {
+  Track *tracks;
+  adept::MParray *currentlyActive;
+  Secondaries secondaries;
+  adept::MParray *nextActive;
+  adept::MParray *relocate;
+  GlobalScoring *scoring;
+  double energyCut;
+  adept::DaughterBVH bvh;
+  adept::DaughterBatch batch;
+  adept::RelocationCache relocationCache;
+  const int *volumeMCIndex;
+  FieldMap fieldMap;
+  ChordStatistics *chordStats;
+  LooperThresholds loopers;
+  struct G4HepEmElectronManager *electronManager;
+  struct G4HepEmParameters *g4HepEmPars;
+  struct G4HepEmData *g4HepEmData;
+};
+
+// Submit the transport of electrons or positrons instantiated for a field policy. The field itself is
+// a specialization constant of the kernel.
+template <bool IsElectron, FieldPolicy Field>
+static void SubmitTransportElectrons(sycl::queue &queue, int blocks, int threads, UniformField field,
+                                     ElectronTransportArgs const &args)
+{
+  queue.submit([&](sycl::handler &cgh) {
+    cgh.set_specialization_constant<FieldSpec>(field);
+    const ElectronTransportArgs a = args;
+    cgh.parallel_for(sycl::nd_range<3>(sycl::range<3>(1, 1, blocks) * sycl::range<3>(1, 1, threads),
+                                       sycl::range<3>(1, 1, threads)),
+                     [=](sycl::nd_item<3> item_ct1, sycl::kernel_handler kh) {
+                       TransportElectrons<IsElectron, Field>(a.tracks, a.currentlyActive, a.secondaries, a.nextActive,
+                                                             a.relocate, a.scoring, a.energyCut, a.bvh, a.batch,
+                                                             a.relocationCache, a.volumeMCIndex,
+                                                             kh.get_specialization_constant<FieldSpec>(), a.fieldMap,
+                                                             a.chordStats, a.loopers, item_ct1, a.electronManager,
+                                                             a.g4HepEmPars, a.g4HepEmData);
+                     });
+  });
+}
+
+template <bool IsElectron>
+static void SubmitTransportElectrons(sycl::queue &queue, int blocks, int threads, FieldPolicy policy,
+                                     UniformField field, ElectronTransportArgs const &args)
+{
+  switch (policy) {
+  case FieldPolicy::None:
+    SubmitTransportElectrons<IsElectron, FieldPolicy::None>(queue, blocks, threads, field, args);
+    break;
+  case FieldPolicy::UniformBz:
+    SubmitTransportElectrons<IsElectron, FieldPolicy::UniformBz>(queue, blocks, threads, field, args);
+    break;
+  case FieldPolicy::UniformAny:
+    SubmitTransportElectrons<IsElectron, FieldPolicy::UniformAny>(queue, blocks, threads, field, args);
+    break;
+  case FieldPolicy::Map:
+    SubmitTransportElectrons<IsElectron, FieldPolicy::Map>(queue, blocks, threads, field, args);
+    break;
+  }
+}
+
+// Write the deposit profile, one line per bin with its lower edge in mm and the deposit in GeV.
+static bool WriteProfile(std::string const &filename, DepositProfile const &profile)
+{
+  std::ofstream file(filename);
+  file << std::setprecision(10);
+  for (int i = 0; i < DepositProfile::kBins; i++) {
+    file << (profile.xmin + i * profile.width) / copcore::units::mm << " " << profile.bins[i] / copcore::units::GeV
+         << "\n";
+  }
+  return bool(file);
+}
+
+// Read the bins of a profile written by WriteProfile, which must have the same binning.
+static bool ReadProfile(std::string const &filename, DepositProfile &profile)
+{
+  std::ifstream file(filename);
+  for (int i = 0; i < DepositProfile::kBins; i++) {
+    double edge, deposit;
+    if (!(file >> edge >> deposit)) return false;
+    if (std::abs(edge * copcore::units::mm - (profile.xmin + i * profile.width)) > 1.e-6 * profile.width) return false;
+    profile.bins[i] = deposit * copcore::units::GeV;
+  }
+  return true;
+}
+
+// Compare a profile to a reference one: relative difference of the total deposits, and largest difference
+// of the cumulative distributions normalized to one, as in a Kolmogorov-Smirnov test. Both must stay below
+// the tolerance for the profiles to be compatible.
+static bool CompareProfiles(DepositProfile const &profile, DepositProfile const &reference, double tolerance)
+{
+  double total = 0, totalReference = 0;
+  for (int i = 0; i < DepositProfile::kBins; i++) {
+    total += profile.bins[i];
+    totalReference += reference.bins[i];
+  }
+  if (total <= 0 || totalReference <= 0) return total == totalReference;
+
+  double cumulative = 0, cumulativeReference = 0, distance = 0;
+  for (int i = 0; i < DepositProfile::kBins; i++) {
+    cumulative += profile.bins[i] / total;
+    cumulativeReference += reference.bins[i] / totalReference;
+    distance = std::max(distance, std::abs(cumulative - cumulativeReference));
+  }
+  const double totalDifference = (total - totalReference) / totalReference;
+  std::cout << "Deposit profile vs reference: total " << std::setprecision(3) << 100 * totalDifference
+            << "%, largest difference of the cumulative distributions " << distance << "\n";
+  return std::abs(totalDifference) < tolerance && distance < tolerance;
+}
+
+void example9(const vecgeom::VPlacedVolume *world, int numParticles, double energy,
+              struct G4HepEmElectronManager *electronManager_p, struct G4HepEmGammaManager *gammaManager_p,
+              struct G4HepEmParameters *g4HepEmPars_p, struct G4HepEmData *g4HepEmData_p,
+              Example9Options const &options)
+{
+  const TrackingCuts &cuts  = options.cuts;
+  const UniformField &field = options.field;
 
   sycl::default_selector device_selector;
 
@@ -230,59 +877,111 @@ void example9(const vecgeom::VPlacedVolume *world, int numParticles, double ener
   
    dpct::device_ext &dev_ct1 = dpct::get_current_device();
 
-#ifdef __SYCL_DEVICE_ONLY__
-  auto &cudaManager = vecgeom::CudaManager::Instance();
-  cudaManager.LoadGeometry(world);
-  cudaManager.Synchronize();
-  const vecgeom::cuda::VPlacedVolume *world_dev = cudaManager.world_gpu();
-#else
+  // Flat image of the geometry, copied to the device at once instead of going through
+  // CudaManager::LoadGeometry, and read in place to locate the primaries. The transport kernels
+  // navigate in the VecGeom geometry in shared memory.
   const vecgeom::VPlacedVolume *world_dev = world;
-#endif
+  adept::GeometryImage geometryImage;
+  adept::GeometryImageView geometryView;
+  if (geometryImage.Build(world)) {
+    geometryView = geometryImage.Upload(q_ct1);
+    std::cout << "INFO: geometry image of " << geometryImage.GetSize() << " bytes on the device" << std::endl;
+  } else {
+    std::cout << "INFO: no geometry image, the geometry has shapes other than box, trd and tube" << std::endl;
+  }
   
   G4HepEmState *state = InitG4HepEm(q_ct1, electronManager_p, gammaManager_p, g4HepEmPars_p, g4HepEmData_p);
 
-  // Capacity of the different containers aka the maximum number of particles.
-  constexpr int Capacity = 256 * 1024;
+  copcore::UsmPool &pool = RunPool(q_ct1);
+
+  // Material-cuts index of each logical volume in the G4HepEm numbering, if the couples of the volumes are known.
+  // Otherwise the kernels assume a single material.
+  int *volumeMCIndex = nullptr;
+  if (!options.volumeCouples.empty()) {
+    std::vector<int> mcIndex(options.volumeCouples.size());
+    for (size_t i = 0; i < options.volumeCouples.size(); ++i) {
+      mcIndex[i] = state->data.fTheMatCutData->fG4MCIndexToHepEmMCIndex[options.volumeCouples[i]];
+    }
+    volumeMCIndex = (int *)pool.Allocate(sizeof(int) * mcIndex.size(), copcore::UsmKind::kDevice);
+    q_ct1.memcpy(volumeMCIndex, mcIndex.data(), sizeof(int) * mcIndex.size()).wait_and_throw();
+  }
+
+  // Build the hierarchies over the daughters of the volumes with many of them, for the navigation.
+  // The volumes without hierarchy compute the distances to their box and tube daughters by blocks.
+  adept::DaughterBVHBuilder bvhBuilder;
+  adept::DaughterBVH bvh;
+  if (options.useBVH) {
+    bvhBuilder.Build(world);
+    bvh = bvhBuilder.Upload(q_ct1);
+  }
+  adept::DaughterBatchBuilder batchBuilder;
+  batchBuilder.Build(world);
+  const adept::DaughterBatch daughterBatch = batchBuilder.Upload(q_ct1);
+  std::cout << "INFO: daughter BVH for " << bvhBuilder.GetNumTrees() << " volumes, " << bvhBuilder.GetNumNodes()
+            << " nodes" << std::endl;
+  std::cout << "INFO: daughter batches for " << batchBuilder.GetNumVolumes() << " volumes, "
+            << batchBuilder.GetNumBlocks() << " blocks of " << adept::DaughterBatch::kLanes << std::endl;
+
+  // Field map, which replaces the uniform field when given.
+  FieldMapBuilder fieldMapBuilder;
+  if (!fieldMapFile.empty() && !fieldMapBuilder.Load(fieldMapFile)) {
+    COPCORE_EXCEPTION("example9: cannot read the field map");
+  }
+  const FieldMap fieldMap       = fieldMapBuilder.Upload(q_ct1);
+  const FieldPolicy fieldPolicy = fieldMap.Enabled() ? FieldPolicy::Map : field.Policy();
+
+  // Statistics of the chords of the propagation in a uniform field along z, if requested.
+  copcore::Allocator<ChordStatistics, copcore::BackendType::ONEAPI> chordAlloc(pool, copcore::UsmKind::kShared);
+  ChordStatistics *chordStats = nullptr;
+  if (options.chordStatistics) {
+    chordStats = chordAlloc.allocate(1);
+    q_ct1.memset(chordStats, 0, sizeof(ChordStatistics)).wait_and_throw();
+  }
+
+  // Cache of the states entered after crossing a boundary, shared by all particle types, with its
+  // usage counters if requested.
+  adept::RelocationCacheStorage relocationCacheStorage;
+  relocationCacheStorage.Allocate(q_ct1, options.relocationCacheBits, options.relocationStatistics);
+  const adept::RelocationCache relocationCache = relocationCacheStorage.View();
+
+  // Initial capacity of the different containers aka the maximum number of particles. In growable
+  // mode the capacity is doubled whenever an iteration runs out of slots, and the iteration is run
+  // again; otherwise the particles not fitting are lost.
+  const int capacity = std::max(options.capacity, numParticles);
 
-  std::cout << "INFO: capacity of containers set to " << Capacity << std::endl;
+  // The track storage of a particle type is compacted when the fraction of dead tracks among the slots
+  // handed out exceeds CompactionSparsity, and at least CompactionMinSlots slots were handed out.
+  constexpr double CompactionSparsity = 0.5;
+  constexpr int CompactionMinSlots    = 4096;
+
+  std::cout << "INFO: capacity of containers set to " << capacity << (options.growable ? " (growable)" : "") << ", "
+            << sizeof(Track) << " bytes per track" << std::endl;
 
   // Allocate structures to manage tracks of an implicit type:
   //  * memory to hold the actual Track elements,
   //  * objects to manage slots inside the memory,
   //  * queues of slots to remember active particle and those needing relocation,
   //  * a stream and an event for synchronization of kernels.
-  constexpr size_t TracksSize  = sizeof(Track) * Capacity;
-  constexpr size_t ManagerSize = sizeof(SlotManager);
-  const size_t QueueSize       = adept::MParray::SizeOfInstance(Capacity);
-
+  // All device buffers of the run are sub-allocated from a single arena, kept from the previous run if
+  // it is large enough and replaced by a larger one when the storage grows.
   ParticleType particles[ParticleType::NumParticleTypes];
-  SlotManager slotManagerInit(Capacity);
-  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
-    particles[i].tracks = (Track *)sycl::malloc_device(TracksSize, q_ct1);
-
-    particles[i].slotManager = (SlotManager *)sycl::malloc_device(ManagerSize, q_ct1);
-
-    q_ct1.memcpy(particles[i].slotManager, &slotManagerInit, ManagerSize).wait();
-
-    particles[i].queues.currentlyActive = (adept::MParray *)sycl::malloc_device(QueueSize, q_ct1);
-
-    particles[i].queues.nextActive = (adept::MParray *)sycl::malloc_device(QueueSize, q_ct1);
-
-    particles[i].queues.relocate = (adept::MParray *)sycl::malloc_device(QueueSize, q_ct1);
-
-    q_ct1.submit([&](sycl::handler &cgh) {
-      auto particles_i_queues_ct0 = particles[i].queues;
-
-      cgh.parallel_for(sycl::nd_range<3>(sycl::range<3>(1, 1, 1), sycl::range<3>(1, 1, 1)),
-          [=](sycl::nd_item<3> item_ct1) {
-            InitParticleQueues(particles_i_queues_ct0, Capacity);
-          });
-    });
+  RunBuffers buffers;
+  AllocateRunBuffers(q_ct1, capacity, options.growable, particles, buffers);
+
+  // Bins of the deposit profile over the extent of the world along x, kept in the scoring of the run.
+  // The profile is only scored when it is written or compared.
+  GlobalScoring scoringInit = {};
+  vecgeom::Vector3D<vecgeom::Precision> worldMin, worldMax;
+  world->GetUnplacedVolume()->Extent(worldMin, worldMax);
+  scoringInit.profile.enabled = !options.profileFile.empty() || !options.referenceProfile.empty();
+  scoringInit.profile.xmin    = worldMin.x();
+  scoringInit.profile.width   = (worldMax.x() - worldMin.x()) / DepositProfile::kBins;
+  q_ct1.memcpy(buffers.scoring, &scoringInit, sizeof(GlobalScoring)).wait_and_throw();
+  std::cout << "INFO: run arena of " << buffers.arena->GetCapacity() / (1024 * 1024) << " MB" << std::endl;
 
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
     particles[i].stream = dev_ct1.create_queue();
-  } 
-
-  dev_ct1.queues_wait_and_throw();
+  }
 
   ParticleType &electrons = particles[ParticleType::Electron];
   ParticleType &positrons = particles[ParticleType::Positron];
@@ -293,19 +992,34 @@ void example9(const vecgeom::VPlacedVolume *world, int numParticles, double ener
 
   stream = dev_ct1.create_queue();
 
-  // Allocate and initialize scoring and statistics.
-  GlobalScoring *scoring = nullptr;
-
-  scoring = sycl::malloc_device<GlobalScoring>(1, q_ct1);
-
-  q_ct1.memset(scoring, 0, sizeof(GlobalScoring)).wait();
+  // Statistics are copied to the host after each iteration.
+  copcore::Allocator<Stats, copcore::BackendType::ONEAPI> statsAlloc(pool, copcore::UsmKind::kHost);
+  Stats *stats = statsAlloc.allocate(1);
 
-  Stats *stats_dev = nullptr;
+  int numCompactions = 0;
+  int numGrowths     = 0;
 
-  stats_dev = sycl::malloc_device<Stats>(1, q_ct1);
-  Stats *stats = nullptr;
+  // When more than spillWatermark tracks of a particle type are active after an iteration, the excess
+  // is spilled to the host. Spilled tracks are re-injected once at most half of the watermark are
+  // active, or whenever nothing is active on the device. A watermark of 0 disables spilling.
+  const int SpillLowWatermark = std::max(1, options.spillWatermark / 2);
+  std::unique_ptr<SpillStack> spillStacks[ParticleType::NumParticleTypes];
+  for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+    spillStacks[i].reset(new SpillStack(pool));
+  }
+  long numSpilled  = 0;
+  int maxSpillSize = 0;
+  const std::unique_ptr<SchedulingPolicy> policy = SchedulingPolicy::Create(options.schedule, options.batch);
+  std::cout << "INFO: scheduling policy " << policy->Name();
+  if (options.batch > 0) std::cout << " with batch of " << options.batch << " tracks";
+  std::cout << std::endl;
+  if (options.batch == 0 && policy->NeedsBatch()) {
+    std::cout << "WARNING: without a batch all active tracks are transported, the policy has no effect" << std::endl;
+  }
 
-  stats = sycl::malloc_host<Stats>(1, q_ct1);
+  if (options.spillWatermark > 0) {
+    std::cout << "INFO: spilling tracks to the host above " << options.spillWatermark << " active tracks" << std::endl;
+  }
 
   // Initialize primary particles.
   constexpr int InitThreads = 32;
@@ -317,7 +1031,7 @@ void example9(const vecgeom::VPlacedVolume *world, int numParticles, double ener
                                        sycl::range<3>(1, 1, InitThreads)),
                      [=](sycl::nd_item<3> item_ct1) {
                        InitPrimaries(electronGenerator, numParticles, energy,
-                                     world_dev, item_ct1);
+                                     world_dev, bvh, geometryView, item_ct1);
                      });
   });
 
@@ -326,135 +1040,160 @@ void example9(const vecgeom::VPlacedVolume *world, int numParticles, double ener
   stats->inFlight[ParticleType::Electron] = numParticles;
   stats->inFlight[ParticleType::Positron] = 0;
   stats->inFlight[ParticleType::Gamma]    = 0;
+  stats->usedSlots[ParticleType::Electron] = numParticles;
+  stats->usedSlots[ParticleType::Positron] = 0;
+  stats->usedSlots[ParticleType::Gamma]    = 0;
+  stats->scoring                           = scoringInit;
 
-  std::cout << "INFO: running with field Bz = " << BzFieldValue / copcore::units::tesla << " T";
+  if (adept::kMixedPrecision) {
+    std::cout << "INFO: mixed precision, directions and local distances in single precision" << std::endl;
+  }
+  std::cout << "INFO: running with " << UniformField::Name(fieldPolicy) << " field";
+  if (fieldPolicy == FieldPolicy::Map) {
+    std::cout << " from " << fieldMapFile << " (" << fieldMapBuilder.GetSize() / 1024 << " kB)";
+  } else if (!field.IsZero()) {
+    std::cout << " B = (" << field.fB[0] / copcore::units::tesla << ", " << field.fB[1] / copcore::units::tesla
+              << ", " << field.fB[2] / copcore::units::tesla << ") T";
+  }
   std::cout << std::endl;
 
   constexpr int MaxBlocks        = 1024;
   constexpr int TransportThreads = 32;
   constexpr int RelocateThreads  = 32;
+  constexpr int MaxIterations    = 1000;
   int transportBlocks, relocateBlocks;
 
   vecgeom::Stopwatch timer;
   timer.Start();
 
   int inFlight;
-  int iterNo = 0;
+  int iterNo    = 0;
+  long numSteps = 0;
+
+  KernelCounters counters;
+  counters.chordStats      = chordStats;
+  counters.relocationCache = &relocationCacheStorage;
 
   do {
+    // Let the scheduling policy choose what to transport in this iteration.
+    if (policy->NeedsMeanEnergy()) ComputeMeanEnergies(q_ct1, particles, *stats, buffers.energySums);
+    SchedulingPolicy::Decision decision;
+    policy->Schedule(*stats, decision);
+
+    // In growable mode, take a checkpoint if the secondaries may not fit into the free slots.
+    const Stats before = *stats;
+    bool checkpointed  = false;
+    if (options.growable) {
+      int newSlots[ParticleType::NumParticleTypes];
+      MaxNewSlots(before.inFlight, newSlots);
+      for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+        checkpointed |= before.usedSlots[i] + newSlots[i] > buffers.capacity;
+      }
+      if (checkpointed) CheckpointIteration(q_ct1, particles, buffers, before, counters);
+    }
+
+    GlobalScoring *scoring = buffers.scoring;
+    Stats *stats_dev       = buffers.stats;
+
     Secondaries secondaries = {
         .electrons = {electrons.tracks, electrons.slotManager, electrons.queues.nextActive},
         .positrons = {positrons.tracks, positrons.slotManager, positrons.queues.nextActive},
         .gammas    = {gammas.tracks, gammas.slotManager, gammas.queues.nextActive},
     };
 
-    // *** ELECTRONS ***
-    int numElectrons = stats->inFlight[ParticleType::Electron];
-    if (numElectrons > 0) {
-      transportBlocks = (numElectrons + TransportThreads - 1) / TransportThreads;
-      transportBlocks = std::min(transportBlocks, MaxBlocks);
-
-      relocateBlocks = std::min(numElectrons, MaxBlocks);
-
-      electrons.stream->submit([&](sycl::handler &cgh) {
-        Track *electronsTracks = electrons.tracks;
-        adept::MParray *currentlyActive = electrons.queues.currentlyActive;
-        adept::MParray *nextActive = electrons.queues.nextActive;
-        adept::MParray *relocate = electrons.queues.relocate;
-        cgh.parallel_for(
-            sycl::nd_range<3>(sycl::range<3>(1, 1, transportBlocks) *
-                                  sycl::range<3>(1, 1, TransportThreads),
-                              sycl::range<3>(1, 1, TransportThreads)),
-            [=](sycl::nd_item<3> item_ct1) {
-              TransportElectrons<true>(electronsTracks,
-                                       currentlyActive,
-                                       secondaries, 
-                                       nextActive,
-                                       relocate, 
-                                       scoring, 
-                                       item_ct1,
-                                       electronManager_p,
-                                       g4HepEmPars_p,
-                                       g4HepEmData_p);
-            });
-      });
-      
-      electrons.event_ct1 = std::chrono::steady_clock::now();
-
-      electrons.event.wait();
-    }
-
-    // *** POSITRONS ***
-    int numPositrons = stats->inFlight[ParticleType::Positron];
-    if (numPositrons > 0) {
-      transportBlocks = (numPositrons + TransportThreads - 1) / TransportThreads;
-      transportBlocks = std::min(transportBlocks, MaxBlocks);
-
-      relocateBlocks = std::min(numPositrons, MaxBlocks);
-
-      positrons.stream->submit([&](sycl::handler &cgh) {
-        Track *positronsTracks = positrons.tracks;
-        adept::MParray *pCurrentlyActive = positrons.queues.currentlyActive;
-        adept::MParray *pNextActive = positrons.queues.nextActive;
-        adept::MParray *pRelocate = positrons.queues.relocate;
-
-        cgh.parallel_for(
-            sycl::nd_range<3>(sycl::range<3>(1, 1, transportBlocks) *
-                                  sycl::range<3>(1, 1, TransportThreads),
-                              sycl::range<3>(1, 1, TransportThreads)),
-            [=](sycl::nd_item<3> item_ct1) {
-              TransportElectrons<false>(positronsTracks,
-                                        pCurrentlyActive,
-                                        secondaries,
-                                        pNextActive,
-                                        pRelocate,
-                                        scoring,
-                                        item_ct1,
-                                        electronManager_p,
-                                        g4HepEmPars_p,
-                                        g4HepEmData_p);
-	    });
-      });
-      
-      positrons.event_ct1 = std::chrono::steady_clock::now();
-
-      positrons.event.wait();
-    }
-
-    // *** GAMMAS ***
-    int numGammas = stats->inFlight[ParticleType::Gamma];
-    if (numGammas > 0) {
-      transportBlocks = (numGammas + TransportThreads - 1) / TransportThreads;
-      transportBlocks = std::min(transportBlocks, MaxBlocks);
-
-      relocateBlocks = std::min(numGammas, MaxBlocks);
-
-      gammas.stream->submit([&](sycl::handler &cgh) {
-        Track *gammasTracks = gammas.tracks;
-        adept::MParray *gCurrentlyActive = gammas.queues.currentlyActive;
-        adept::MParray *gNextActive = gammas.queues.nextActive;
-        adept::MParray *gRelocate = gammas.queues.relocate;
-        cgh.parallel_for(
-            sycl::nd_range<3>(sycl::range<3>(1, 1, transportBlocks) *
-                                  sycl::range<3>(1, 1, TransportThreads),
-                              sycl::range<3>(1, 1, TransportThreads)),
-            [=](sycl::nd_item<3> item_ct1) {
-              TransportGammas(gammasTracks,
-                              gCurrentlyActive,
-                              secondaries,
-                              gNextActive,
-                              gRelocate,
-                              scoring,
-                              item_ct1,
-                              gammaManager_p,
-                              g4HepEmPars_p,
-                              g4HepEmData_p);
-            });
-      });
-      
-      gammas.event_ct1 = std::chrono::steady_clock::now();
+    // Transport the particle types in the order and the amounts chosen by the scheduling policy. The
+    // tracks past the batch of a particle type are deferred to the next iteration.
+    for (int k = 0; k < ParticleType::NumParticleTypes; k++) {
+      const int type  = decision.order[k];
+      const int batch = decision.batch[type];
+      if (batch < stats->inFlight[type]) {
+        DeferTracks(q_ct1, particles[type], stats->inFlight[type], batch);
+      }
+      if (batch == 0) continue;
+
+      switch (type) {
+      case ParticleType::Electron: {
+        // *** ELECTRONS ***
+        int numElectrons = batch;
+        transportBlocks = (numElectrons + TransportThreads - 1) / TransportThreads;
+        transportBlocks = std::min(transportBlocks, MaxBlocks);
+
+        relocateBlocks = std::min(numElectrons, MaxBlocks);
+
+        SubmitTransportElectrons<true>(*electrons.stream, transportBlocks, TransportThreads, fieldPolicy, field,
+                                       {electrons.tracks, electrons.queues.currentlyActive, secondaries,
+                                        electrons.queues.nextActive, electrons.queues.relocate, scoring,
+                                        cuts.electron, bvh, daughterBatch, relocationCache, volumeMCIndex, fieldMap,
+                                        chordStats, options.loopers, electronManager_p, g4HepEmPars_p,
+                                        g4HepEmData_p});
+    
+        electrons.event_ct1 = std::chrono::steady_clock::now();
+
+        electrons.event.wait();
+        break;
+      }
+      case ParticleType::Positron: {
+        // *** POSITRONS ***
+        int numPositrons = batch;
+        transportBlocks = (numPositrons + TransportThreads - 1) / TransportThreads;
+        transportBlocks = std::min(transportBlocks, MaxBlocks);
+
+        relocateBlocks = std::min(numPositrons, MaxBlocks);
+
+        SubmitTransportElectrons<false>(*positrons.stream, transportBlocks, TransportThreads, fieldPolicy, field,
+                                        {positrons.tracks, positrons.queues.currentlyActive, secondaries,
+                                         positrons.queues.nextActive, positrons.queues.relocate, scoring,
+                                         cuts.positron, bvh, daughterBatch, relocationCache, volumeMCIndex, fieldMap,
+                                         chordStats, options.loopers, electronManager_p, g4HepEmPars_p,
+                                        g4HepEmData_p});
+    
+        positrons.event_ct1 = std::chrono::steady_clock::now();
+
+        positrons.event.wait();
+        break;
+      }
+      case ParticleType::Gamma: {
+        // *** GAMMAS ***
+        int numGammas = batch;
+        transportBlocks = (numGammas + TransportThreads - 1) / TransportThreads;
+        transportBlocks = std::min(transportBlocks, MaxBlocks);
+
+        relocateBlocks = std::min(numGammas, MaxBlocks);
+
+        gammas.stream->submit([&](sycl::handler &cgh) {
+          Track *gammasTracks = gammas.tracks;
+          adept::MParray *gCurrentlyActive = gammas.queues.currentlyActive;
+          adept::MParray *gNextActive = gammas.queues.nextActive;
+          adept::MParray *gRelocate = gammas.queues.relocate;
+          cgh.parallel_for(
+              sycl::nd_range<3>(sycl::range<3>(1, 1, transportBlocks) *
+                                    sycl::range<3>(1, 1, TransportThreads),
+                                sycl::range<3>(1, 1, TransportThreads)),
+              [=](sycl::nd_item<3> item_ct1) {
+                TransportGammas(gammasTracks,
+                                gCurrentlyActive,
+                                secondaries,
+                                gNextActive,
+                                gRelocate,
+                                scoring,
+                                cuts.gamma,
+                                bvh,
+                                daughterBatch,
+                                relocationCache,
+                                volumeMCIndex,
+                                item_ct1,
+                                gammaManager_p,
+                                g4HepEmPars_p,
+                                g4HepEmData_p);
+              });
+        });
+    
+        gammas.event_ct1 = std::chrono::steady_clock::now();
 
-      gammas.event.wait();
+        gammas.event.wait();
+        break;
+      }
+      }
     }
 
     // *** END OF TRANSPORT ***
@@ -462,11 +1201,12 @@ void example9(const vecgeom::VPlacedVolume *world, int numParticles, double ener
     // The events ensure synchronization before finishing this iteration and
     // copying the Stats back to the host.
     AllParticleQueues queues = {{electrons.queues, positrons.queues, gammas.queues}};
+    AllSlotManagers managers = {{electrons.slotManager, positrons.slotManager, gammas.slotManager}};
     stream->submit([&](sycl::handler &cgh) {
       cgh.parallel_for(
           sycl::nd_range<3>(sycl::range<3>(1, 1, 1), sycl::range<3>(1, 1, 1)),
           [=](sycl::nd_item<3> item_ct1) {
-            FinishIteration(queues, scoring, stats_dev);
+            FinishIteration(queues, managers, scoring, stats_dev, checkpointed);
           });
     });
     
@@ -475,10 +1215,29 @@ void example9(const vecgeom::VPlacedVolume *world, int numParticles, double ener
     // Finally synchronize all kernels.
     stream->wait();
 
-    // Count the number of particles in flight.
-    inFlight = 0;
+    if (stats->overflow) {
+      if (!checkpointed) {
+        std::cerr << "ERROR: track storage of capacity " << buffers.capacity
+                  << " exhausted, particles were lost (run with -growable 1)" << std::endl;
+      } else {
+        // Undo the iteration, grow the storage and run the iteration again.
+        RestoreIteration(q_ct1, particles, buffers, before, counters);
+        GrowRunBuffers(q_ct1, 2 * buffers.capacity, options.growable, particles, buffers, before);
+        *stats = before;
+        numGrowths++;
+        std::cout << "INFO: capacity of containers grown to " << buffers.capacity << " in iteration " << iterNo
+                  << std::endl;
+        inFlight = 0;
+        for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+          inFlight += before.inFlight[i] + spillStacks[i]->Size();
+        }
+        continue;
+      }
+    }
+
+    // Every transported track did one step.
     for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
-      inFlight += stats->inFlight[i];
+      numSteps += decision.batch[i];
     }
 
     // Swap the queues for the next iteration.
@@ -486,6 +1245,61 @@ void example9(const vecgeom::VPlacedVolume *world, int numParticles, double ener
     positrons.queues.SwapActive();
     gammas.queues.SwapActive();
 
+    // Spill the excess of active tracks to the host.
+    if (options.spillWatermark > 0) {
+      for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+        if (stats->inFlight[i] > options.spillWatermark) {
+          numSpilled += stats->inFlight[i] - options.spillWatermark;
+          SpillTracks(q_ct1, particles[i], stats->inFlight[i], options.spillWatermark, *spillStacks[i]);
+          stats->inFlight[i] = options.spillWatermark;
+          maxSpillSize       = std::max(maxSpillSize, spillStacks[i]->Size());
+        }
+      }
+    }
+
+    // Compact the track storage of the particle types having become too sparse.
+    for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+      int usedSlots = stats->usedSlots[i];
+      if (usedSlots >= CompactionMinSlots && stats->inFlight[i] < (1 - CompactionSparsity) * usedSlots) {
+        CompactTracks(q_ct1, particles[i], usedSlots, stats->inFlight[i], buffers.spareTracks, buffers.compactFlags,
+                      buffers.compactScratch);
+        stats->usedSlots[i] = stats->inFlight[i];
+        numCompactions++;
+      }
+    }
+
+    // Re-inject spilled tracks into the free slots once the device occupancy dropped, and always when
+    // the device ran out of work.
+    int activeOnDevice = 0;
+    for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+      activeOnDevice += stats->inFlight[i];
+    }
+    for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+      SpillStack &stack = *spillStacks[i];
+      if (stack.Size() > 0 && (stats->inFlight[i] <= SpillLowWatermark || activeOnDevice == 0)) {
+        int numInject = std::min(stack.Size(), options.spillWatermark - stats->inFlight[i]);
+        // The dead slots are only reclaimed by a compaction: do it now, whatever the number of slots
+        // handed out, if the free slots left would hold back the re-injection.
+        if (numInject > buffers.capacity - stats->usedSlots[i] && stats->usedSlots[i] > stats->inFlight[i]) {
+          CompactTracks(q_ct1, particles[i], stats->usedSlots[i], stats->inFlight[i], buffers.spareTracks,
+                        buffers.compactFlags, buffers.compactScratch);
+          stats->usedSlots[i] = stats->inFlight[i];
+          numCompactions++;
+        }
+        numInject = std::min(numInject, buffers.capacity - stats->usedSlots[i]);
+        if (numInject <= 0) continue;
+        ReinjectTracks(q_ct1, particles[i], numInject, stack);
+        stats->inFlight[i] += numInject;
+        stats->usedSlots[i] += numInject;
+      }
+    }
+
+    // Count the number of particles in flight, on the device and spilled to the host.
+    inFlight = 0;
+    for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
+      inFlight += stats->inFlight[i] + spillStacks[i]->Size();
+    }
+
     std::cout << std::fixed << std::setprecision(4) << std::setfill(' ');
     std::cout << "iter " << std::setw(4) << iterNo << " -- tracks in flight: " << std::setw(5) << inFlight
               << " energy deposition: " << std::setw(10) << stats->scoring.energyDeposit / copcore::units::GeV
@@ -494,26 +1308,84 @@ void example9(const vecgeom::VPlacedVolume *world, int numParticles, double ener
     std::cout << std::endl;
 
     iterNo++;
-  } while (inFlight > 0 && iterNo < 1000);
+  } while (inFlight > 0 && iterNo < MaxIterations);
 
   auto time_cpu = timer.Stop();
   std::cout << "Run time: " << time_cpu << "\n";
+  std::cout << "Steps: " << numSteps << " in " << iterNo << " iterations\n";
+  // With a small batch, the policies ordering the particle types may starve one of them until the cap.
+  if (inFlight > 0) {
+    std::cout << "WARNING: stopped at " << MaxIterations << " iterations with tracks in flight (e- "
+              << stats->inFlight[ParticleType::Electron] + spillStacks[ParticleType::Electron]->Size() << ", e+ "
+              << stats->inFlight[ParticleType::Positron] + spillStacks[ParticleType::Positron]->Size() << ", gamma "
+              << stats->inFlight[ParticleType::Gamma] + spillStacks[ParticleType::Gamma]->Size()
+              << "), their energy is not scored";
+    if (options.batch > 0) {
+      std::cout << "; the " << policy->Name() << " policy may starve some of them with a batch of " << options.batch;
+    }
+    std::cout << "\n";
+  }
+  if (cuts.electron > 0 || cuts.positron > 0 || cuts.gamma > 0) {
+    std::cout << "Tracking cuts (e- " << cuts.electron / copcore::units::keV << " keV, e+ "
+              << cuts.positron / copcore::units::keV << " keV, gamma " << cuts.gamma / copcore::units::keV
+              << " keV): " << stats->scoring.cutTracks << " tracks killed, "
+              << stats->scoring.cutEnergy / copcore::units::GeV << " GeV deposited locally\n";
+  }
+  std::cout << "Loopers killed: " << stats->scoring.loopersKilled << " carrying "
+            << stats->scoring.looperEnergy / copcore::units::GeV << " GeV"
+            << (options.loopers.fDeposit ? " (deposited locally)" : " (lost)") << "\n";
+  if (relocationCacheStorage.HasStatistics()) {
+    const auto relocations = relocationCacheStorage.GetSummary();
+    std::cout << "Relocation cache: " << relocations.hits << " hits in " << relocations.lookups << " lookups ("
+              << std::setprecision(3) << 100 * relocations.HitRate() << "%), " << relocations.stores << " stores, "
+              << relocationCacheStorage.GetNumEntries() << " entries\n";
+  }
+  if (chordStats != nullptr) {
+    const ChordStatistics &chords = *chordStats;
+    std::cout << "Field propagation: " << chords.fCalls.load() << " calls, " << chords.fArcsInSafety.load()
+              << " arcs within the safety, " << chords.fChords.load() << " chords of which "
+              << chords.fSafeChords.load() << " within the safety, " << std::setprecision(3)
+              << chords.NavigationsPerCall() << " navigations per call\n";
+    std::cout << "Chords per call:";
+    for (int i = 0; i <= ChordStatistics::kMaxChordIters; i++) {
+      std::cout << " " << chords.fChordsPerCall[i].load();
+    }
+    std::cout << "\n";
+  }
+  if (!options.profileFile.empty() && !WriteProfile(options.profileFile, stats->scoring.profile)) {
+    std::cout << "Cannot write the deposit profile to " << options.profileFile << "\n";
+  }
+  if (!options.referenceProfile.empty()) {
+    // Tolerance on the differences to the reference, for runs of a few thousand primaries.
+    constexpr double ProfileTolerance = 0.01;
+    DepositProfile reference          = stats->scoring.profile;
+    if (!ReadProfile(options.referenceProfile, reference)) {
+      std::cout << "Cannot read a deposit profile with the same bins from " << options.referenceProfile << "\n";
+    } else {
+      const bool compatible = CompareProfiles(stats->scoring.profile, reference, ProfileTolerance);
+      std::cout << "Deposit profile " << (compatible ? "compatible" : "NOT compatible") << " with "
+                << options.referenceProfile << "\n";
+    }
+  }
+  std::cout << "Track storage compactions: " << numCompactions << "\n";
+  std::cout << "Track storage growths: " << numGrowths << " (final capacity " << buffers.capacity << ")\n";
+  if (options.spillWatermark > 0) {
+    std::cout << "Tracks spilled to host: " << numSpilled << " (largest spill stack " << maxSpillSize << ")\n";
+  }
 
-  // Free resources.
-  sycl::free(scoring, q_ct1);
-  sycl::free(stats_dev, q_ct1);
-  sycl::free(stats, q_ct1);
+  std::cout << "USM pool: " << pool.GetHits() << " blocks reused, " << pool.GetMisses() << " allocated\n";
+
+  // Free resources. The device buffers are all given back at once with the arena, and the smaller
+  // buffers to the pool, both kept for the next run.
+  statsAlloc.deallocate(stats, 1);
+  pool.Release(volumeMCIndex);
+  chordAlloc.deallocate(chordStats, 1);
   dev_ct1.destroy_queue(stream);
 
   for (int i = 0; i < ParticleType::NumParticleTypes; i++) {
-    sycl::free(particles[i].tracks, q_ct1);
-    sycl::free(particles[i].slotManager, q_ct1);
-
-    sycl::free(particles[i].queues.currentlyActive, q_ct1);
-    sycl::free(particles[i].queues.nextActive, q_ct1);
-    sycl::free(particles[i].queues.relocate, q_ct1);
     dev_ct1.destroy_queue(particles[i].stream);
   }
+  RetainedArena = std::move(buffers.arena);
 
   FreeG4HepEm(state);
 }
@@ -8,9 +8,18 @@
 
 #include <CL/sycl.hpp>
 #include <dpct/dpct.hpp>
+#include <AdePT/1/DaughterBatch.h>
+#include <AdePT/1/DaughterBVH.h>
 #include <AdePT/1/MParray.h>
+#include <AdePT/1/PackedNavState.h>
+#include <AdePT/1/Precision.h>
+#include <AdePT/1/RelocationCache.h>
 #include <CopCore/1/SystemOfUnits.h>
 #include <CopCore/1/Ranluxpp.h>
+#include <Field/1/ChordStatistics.h>
+#include <Field/1/FieldMap.h>
+#include <Field/1/FieldPolicy.h>
+#include <Field/1/LooperThresholds.h>
 
 #include <G4HepEmData.hh>
 #include <G4HepEmParameters.hh>
@@ -41,19 +50,21 @@ struct Track {
   double energy;
   double numIALeft[3];
 
+  // The position stays in double, the direction is single precision in mixed precision builds.
   vecgeom::Vector3D<double> pos;
-  vecgeom::Vector3D<double> dir;
-  vecgeom::NavStateIndex currentState;
-  vecgeom::NavStateIndex nextState;
+  vecgeom::Vector3D<adept::Real_t> dir;
+  // Navigation state at pos. The state after a step is only kept by the kernels, and replaces this one
+  // when the track crosses a boundary.
+  adept::PackedNavState navState;
 
-  double Uniform() { return rngState.Rndm(); }
+  // Steps and path length since the last boundary crossing, for the detection of loopers.
+  int looperSteps;
+  double looperLength;
 
-  void SwapStates()
-  {
-    auto state         = this->currentState;
-    this->currentState = this->nextState;
-    this->nextState    = state;
-  }
+  // Isotropic safety at pos, decremented by the steps taken within it.
+  vecgeom::Precision safety;
+
+  double Uniform() { return rngState.Rndm(); }
 
   void InitAsSecondary(const Track &parent)
   {
@@ -68,9 +79,14 @@ struct Track {
 
     // A secondary inherits the position of its parent; the caller is responsible
     // to update the directions.
-    this->pos          = parent.pos;
-    this->currentState = parent.currentState;
-    this->nextState    = parent.nextState;
+    this->pos      = parent.pos;
+    this->navState = parent.navState;
+
+    this->looperSteps  = 0;
+    this->looperLength = 0;
+
+    // The parent's safety is valid at the same position.
+    this->safety = parent.safety;
   }
 };
 
@@ -82,17 +98,46 @@ public:
 };
 
 
+// Profile of the energy deposit along the x axis, the direction of the primaries, with fixed bins over
+// the extent of the world. Compared between runs to validate transport options, see -profile_file.
+// Unless enabled, scoring a deposit costs no atomic.
+struct DepositProfile {
+  static constexpr int kBins = 100;
+
+  bool enabled;
+  double xmin;
+  double width;
+  double bins[kBins];
+
+  void Score(double x, double energy)
+  {
+    if (!enabled) return;
+    int bin = (int)((x - xmin) / width);
+    bin     = bin < 0 ? 0 : (bin < kBins ? bin : kBins - 1);
+    dpct::atomic_fetch_add(&bins[bin], energy);
+  }
+};
+
 // A data structure for some global scoring. The accessors must make sure to use
 // atomic operations if needed.
 struct GlobalScoring {
   int hits;
   int secondaries;
   double energyDeposit;
+  // Tracks killed below the tracking cuts and the energy they deposited locally.
+  int cutTracks;
+  double cutEnergy;
+  // Charged tracks killed as loopers and the energy they carried.
+  int loopersKilled;
+  double looperEnergy;
+  // Profile of all the energy deposited.
+  DepositProfile profile;
 };
 
-// A data structure to manage slots in the track storage.
+// A data structure to manage slots in the track storage. The storage has one more slot
+// past fMaxSlot which absorbs the tracks created after all slots were handed out.
 class SlotManager {
-  adept::Atomic_t<int> fNextSlot;
+  adept::AtomicCounter_t<int> fNextSlot;
   const int fMaxSlot;
 
 public:
@@ -104,6 +149,22 @@ public:
     if (next >= fMaxSlot) return -1;
     return next;
   }
+
+  // Number of slots handed out so far.
+  int UsedSlots() const
+  {
+    int used = fNextSlot.load();
+    return used < fMaxSlot ? used : fMaxSlot;
+  }
+
+  // Restart handing out slots after the first numSlots, used after compacting the track storage.
+  void SetUsedSlots(int numSlots) { fNextSlot.store(numSlots); }
+
+  // Number of regular slots, also the index of the overflow slot.
+  int MaxSlot() const { return fMaxSlot; }
+
+  // Whether a slot was requested after all of them were handed out.
+  bool Overflowed() const { return fNextSlot.load() > fMaxSlot; }
 };
 
 // A bundle of pointers to generate particles of an implicit type.
@@ -116,11 +177,13 @@ public:
   ParticleGenerator(Track *tracks, SlotManager *slotManager, adept::MParray *activeQueue)
     : fTracks(tracks), fSlotManager(slotManager), fActiveQueue(activeQueue) {}
 
+  // When no slot is left, the overflow slot is returned and the track is not enqueued. The overflow
+  // is recorded by the slot manager and checked by the host at the end of the iteration.
   Track &NextTrack()
   {
     int slot = fSlotManager->NextSlot();
     if (slot == -1) {
-      COPCORE_EXCEPTION("No slot available in ParticleGenerator::NextTrack");
+      return fTracks[fSlotManager->MaxSlot()];
     }
     fActiveQueue->push_back(slot);
     return fTracks[slot];
@@ -139,36 +202,46 @@ struct Secondaries {
 
 void RelocateToNextVolume(Track *allTracks, const adept::MParray *relocateQueue);
 
-template <bool IsElectron>
+template <bool IsElectron, FieldPolicy Field>
 SYCL_EXTERNAL void TransportElectrons(Track *electrons, const adept::MParray *active, Secondaries secondaries,
-   adept::MParray *activeQueue, adept::MParray *relocateQueue, GlobalScoring *scoring,
-   sycl::nd_item<3> item_ct1,
+   adept::MParray *activeQueue, adept::MParray *relocateQueue, GlobalScoring *scoring, double energyCut,
+   adept::DaughterBVH bvh, adept::DaughterBatch batch, adept::RelocationCache relocationCache,
+   const int *volumeMCIndex, UniformField field, FieldMap fieldMap, ChordStatistics *chordStats,
+   LooperThresholds loopers, sycl::nd_item<3> item_ct1,
    struct G4HepEmElectronManager *electronManager,
    struct G4HepEmParameters *g4HepEmPars,
    struct G4HepEmData *g4HepEmData);
 
-extern template
-SYCL_EXTERNAL void TransportElectrons<true>(
-    Track *electrons, const adept::MParray *active, Secondaries secondaries, adept::MParray *activeQueue,
-    adept::MParray *relocateQueue, GlobalScoring *scoring, sycl::nd_item<3> item_ct1,
-    struct G4HepEmElectronManager *electronManager,
-    struct G4HepEmParameters *g4HepEmPars,
-    struct G4HepEmData *g4HepEmData);
-
-extern  template
-SYCL_EXTERNAL void TransportElectrons<false>(
-    Track *electrons, const adept::MParray *active, Secondaries secondaries, adept::MParray *activeQueue,
-    adept::MParray *relocateQueue, GlobalScoring *scoring, sycl::nd_item<3> item_ct1,
-    struct G4HepEmElectronManager *electronManager,
-    struct G4HepEmParameters *g4HepEmPars,
-    struct G4HepEmData *g4HepEmData);
+// Instantiated in electrons.dp.cpp for electrons and positrons, and for each field policy.
+#define DECLARE_TRANSPORT_ELECTRONS(IsElectron, Field)                                                               \
+  extern template SYCL_EXTERNAL void TransportElectrons<IsElectron, Field>(                                           \
+      Track *electrons, const adept::MParray *active, Secondaries secondaries, adept::MParray *activeQueue,           \
+      adept::MParray *relocateQueue, GlobalScoring *scoring, double energyCut, adept::DaughterBVH bvh,               \
+      adept::DaughterBatch batch, adept::RelocationCache relocationCache, const int *volumeMCIndex,                  \
+      UniformField field, FieldMap fieldMap, ChordStatistics *chordStats, LooperThresholds loopers,                  \
+      sycl::nd_item<3> item_ct1, struct G4HepEmElectronManager *electronManager,                                     \
+      struct G4HepEmParameters *g4HepEmPars,                                                                         \
+      struct G4HepEmData *g4HepEmData);
+
+DECLARE_TRANSPORT_ELECTRONS(true, FieldPolicy::None)
+DECLARE_TRANSPORT_ELECTRONS(true, FieldPolicy::UniformBz)
+DECLARE_TRANSPORT_ELECTRONS(true, FieldPolicy::UniformAny)
+DECLARE_TRANSPORT_ELECTRONS(true, FieldPolicy::Map)
+DECLARE_TRANSPORT_ELECTRONS(false, FieldPolicy::None)
+DECLARE_TRANSPORT_ELECTRONS(false, FieldPolicy::UniformBz)
+DECLARE_TRANSPORT_ELECTRONS(false, FieldPolicy::UniformAny)
+DECLARE_TRANSPORT_ELECTRONS(false, FieldPolicy::Map)
 
 SYCL_EXTERNAL void TransportGammas(Track *gammas, const adept::MParray *active, Secondaries secondaries,
-    adept::MParray *activeQueue, adept::MParray *relocateQueue, GlobalScoring *scoring, sycl::nd_item<3> item_ct1,
+    adept::MParray *activeQueue, adept::MParray *relocateQueue, GlobalScoring *scoring, double energyCut,
+    adept::DaughterBVH bvh, adept::DaughterBatch batch, adept::RelocationCache relocationCache,
+    const int *volumeMCIndex, sycl::nd_item<3> item_ct1,
     struct G4HepEmGammaManager *gammaManager,
     struct G4HepEmParameters *g4HepEmPars,
     struct G4HepEmData *g4HepEmData);
 
-constexpr float BzFieldValue = 0.1 * copcore::units::tesla;
+// Uniform field seen by the electron kernels. Its value is set for each launch, so that changing it
+// at run time does not need recompiling; the policy, chosen from the field, is a template parameter.
+inline constexpr sycl::specialization_id<UniformField> FieldSpec(DefaultField);
 
 #endif
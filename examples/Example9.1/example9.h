@@ -11,16 +11,53 @@
 #include <VecGeom/management/CudaManager.h> // forward declares vecgeom::cxx::VPlacedVolume
 #endif
 
+#include <string>
+#include <vector>
+
+#include <CopCore/1/SystemOfUnits.h>
+#include <Field/1/FieldPolicy.h>
+#include <Field/1/LooperThresholds.h>
+
 #include <G4HepEmData.hh>
 #include <G4HepEmParameters.hh>
 #include <G4HepEmElectronManager.hh>
 #include <G4HepEmGammaManager.hh>
 
-void example9(const vecgeom::VPlacedVolume *world, int numParticles, double energy, 
-                struct G4HepEmElectronManager *electronManager_p, 
-                struct G4HepEmGammaManager *gammaManager_p, 
-                struct G4HepEmParameters *g4HepEmPars_p,
-                struct G4HepEmData *g4HepEmData_p);
+// Kinetic energy below which tracks of each particle type deposit their energy locally and are
+// killed. Zero disables the cut.
+struct TrackingCuts {
+  double electron;
+  double positron;
+  double gamma;
+};
+
+// Uniform field used unless another one is given.
+constexpr UniformField DefaultField{{0, 0, 0.1 * copcore::units::tesla}};
+
+// Options of a run, filled once from the command line.
+struct Example9Options {
+  int capacity{256 * 1024};         ///< Initial number of track slots per particle type
+  bool growable{false};             ///< Grow the track storage instead of losing particles
+  int spillWatermark{0};            ///< Active tracks per particle type above which tracks go to the host
+  int schedule{0};                  ///< Scheduling policy, see SchedulingPolicy::Create
+  int batch{0};                     ///< Tracks transported per iteration, 0 = all
+  TrackingCuts cuts{};              ///< Tracking cuts per particle type
+  bool useBVH{true};                ///< Search the daughters through hierarchies, else by blocks
+  int relocationCacheBits{16};      ///< Log2 of the entries of the relocation cache, 0 = no cache
+  bool relocationStatistics{false}; ///< Count the lookups, hits and stores of the relocation cache
+  std::vector<int> volumeCouples;   ///< Couple of the material of each logical volume, if known
+  UniformField field{DefaultField}; ///< Uniform field, unless a field map is given
+  std::string fieldMapFile;         ///< Field map file
+  bool chordStatistics{false};      ///< Statistics of the chords of the propagation in a field
+  LooperThresholds loopers{};       ///< Criteria for killing loopers, and whether they deposit their energy
+  std::string profileFile;          ///< Energy deposit profile along x written to this file
+  std::string referenceProfile;     ///< Profile of a reference run to compare to
+};
+
+void example9(const vecgeom::VPlacedVolume *world, int numParticles, double energy,
+              struct G4HepEmElectronManager *electronManager_p, struct G4HepEmGammaManager *gammaManager_p,
+              struct G4HepEmParameters *g4HepEmPars_p, struct G4HepEmData *g4HepEmData_p,
+              Example9Options const &options = {});
 
 // Interface between C++ and CUDA.
 
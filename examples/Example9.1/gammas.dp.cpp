@@ -31,6 +31,8 @@ constexpr double kPush = 1.e-8 * copcore::units::cm;
 
 void TransportGammas(Track *gammas, const adept::MParray *active, Secondaries secondaries,
                      adept::MParray *activeQueue, adept::MParray *relocateQueue, GlobalScoring *scoring,
+                     double energyCut, adept::DaughterBVH bvh, adept::DaughterBatch batch,
+                     adept::RelocationCache relocationCache, const int *volumeMCIndex,
 		     sycl::nd_item<3> item_ct1,
                         struct G4HepEmGammaManager *gammaManager_p,
                         struct G4HepEmParameters *g4HepEmPars_p,
@@ -49,17 +51,26 @@ void TransportGammas(Track *gammas, const adept::MParray *active, Secondaries se
         ptxas fatal   : Unresolved extern function '_ZN7vecgeom20globaldevicegeomdata11GetNavIndexEv'
       Manually changing the linking steps might fix this issue.
      */
-    auto volume         = currentTrack.currentState.Top();
+    auto volume         = currentTrack.navState.Top();
     if (volume == nullptr) {
       // The particle left the world, kill it by not enqueuing into activeQueue.
       continue;
     }
 
+    if (currentTrack.energy < energyCut) {
+      // Below the tracking cut: deposit the energy locally and kill the track.
+      dpct::atomic_fetch_add(&scoring->energyDeposit, currentTrack.energy);
+      scoring->profile.Score(currentTrack.pos.x(), currentTrack.energy);
+      dpct::atomic_fetch_add(&scoring->cutEnergy, currentTrack.energy);
+      sycl::atomic<int>(sycl::global_ptr<int>(&scoring->cutTracks)).fetch_add(1);
+      continue;
+    }
+
     // Init a track with the needed data to call into G4HepEm.
     G4HepEmTrack emTrack;
     emTrack.SetEKin(currentTrack.energy);
-    // For now, just assume a single material.
-    int theMCIndex = 1;
+    // Without material-cuts index per volume, assume a single material.
+    int theMCIndex = volumeMCIndex ? volumeMCIndex[volume->GetLogicalVolume()->id()] : 1;
     emTrack.SetMCIndex(theMCIndex);
 
     // Sample the `number-of-interaction-left` and put it into the track.
@@ -84,16 +95,23 @@ void TransportGammas(Track *gammas, const adept::MParray *active, Secondaries se
     // Check if there's a volume boundary in between.
 
     double geometryStepLength = 0.0;
+    // The step is computed in double, also when the direction is stored in single precision.
+    const vecgeom::Vector3D<double> dir = adept::VectorCast<double>(currentTrack.dir);
+    // The state after the step is only stored in the track if it crosses a boundary.
+    const vecgeom::NavStateIndex currentState = currentTrack.navState.Unpack();
+    vecgeom::NavStateIndex nextState;
     /*
     ptxas fatal   : Unresolved extern function '_ZN7vecgeom4cuda13NavStateIndex13TopMatrixImplEjRNS0_16Transformation3DE'
     */
     #if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
-      geometryStepLength = LoopNavigator::ComputeStepAndNextVolume(currentTrack.pos, currentTrack.dir, geometricalStepLengthFromPhysics,
-                                  currentTrack.currentState, currentTrack.nextState);
+      // Steps within the safety cached in the track skip the geometry queries.
+      geometryStepLength = LoopNavigator::ComputeStepAndNextVolume(currentTrack.pos, dir, geometricalStepLengthFromPhysics,
+                                  currentState, nextState, currentTrack.safety, &bvh, &batch);
     #endif
-    currentTrack.pos += (geometryStepLength + kPush) * currentTrack.dir;
+    currentTrack.pos += (geometryStepLength + kPush) * dir;
+    currentTrack.safety = currentTrack.safety > kPush ? currentTrack.safety - kPush : 0;
 
-    if (currentTrack.nextState.IsOnBoundary()) {
+    if (nextState.IsOnBoundary()) {
       emTrack.SetGStepLength(geometryStepLength);
       emTrack.SetOnBoundary(true);
     }
@@ -106,7 +124,7 @@ void TransportGammas(Track *gammas, const adept::MParray *active, Secondaries se
       currentTrack.numIALeft[ip] = numIALeft;
     }
 
-    if (currentTrack.nextState.IsOnBoundary()) {
+    if (nextState.IsOnBoundary()) {
       // For now, just count that we hit something.
       sycl::atomic<int>(sycl::global_ptr<int>(&scoring->hits)).fetch_add(1);
 
@@ -122,11 +140,12 @@ void TransportGammas(Track *gammas, const adept::MParray *active, Secondaries se
       The .bc file needs to be passed to the llvm-link step of the compilation.
       */
       #if defined(__SYCL_DEVICE_ONLY__) && defined(__NVPTX__)
-        LoopNavigator::RelocateToNextVolume(currentTrack.pos, currentTrack.dir, currentTrack.nextState);
+        LoopNavigator::RelocateToNextVolume(currentTrack.pos, dir, currentState,
+                                            nextState, relocationCache, &bvh);
       #endif
 
       // Move to the next boundary.
-      currentTrack.SwapStates();
+      currentTrack.navState.Pack(nextState);
       continue;
     } else if (winnerProcessIndex < 0) {
       // No discrete process, move on.
@@ -206,21 +225,24 @@ void TransportGammas(Track *gammas, const adept::MParray *active, Secondaries se
 
         electron.InitAsSecondary(currentTrack);
         electron.energy = energyEl;
-        electron.dir = energy * currentTrack.dir - newEnergyGamma * newDirGamma;
-        electron.dir.Normalize();
+        vecgeom::Vector3D<double> dirEl = energy * dir - newEnergyGamma * newDirGamma;
+        dirEl.Normalize();
+        electron.dir = adept::VectorCast<adept::Real_t>(dirEl);
       } else {
         dpct::atomic_fetch_add(&scoring->energyDeposit, energyEl);
+        scoring->profile.Score(currentTrack.pos.x(), energyEl);
       }
 
       // Check the new gamma energy and deposit if below threshold.
       if (newEnergyGamma > LowEnergyThreshold) {
         currentTrack.energy = newEnergyGamma;
-        currentTrack.dir = newDirGamma;
+        currentTrack.dir = adept::VectorCast<adept::Real_t>(newDirGamma);
 
         // The current track continues to live.
         activeQueue->push_back(slot);
       } else {
         dpct::atomic_fetch_add(&scoring->energyDeposit, newEnergyGamma);
+        scoring->profile.Score(currentTrack.pos.x(), newEnergyGamma);
         // The current track is killed by not enqueuing into the next activeQueue.
       }
       break;
@@ -228,6 +250,7 @@ void TransportGammas(Track *gammas, const adept::MParray *active, Secondaries se
     case 2: {
       // Invoke photoelectric process: right now only absorb the gamma.
       dpct::atomic_fetch_add(&scoring->energyDeposit, energy);
+      scoring->profile.Score(currentTrack.pos.x(), energy);
       // The current track is killed by not enqueuing into the next activeQueue.
       break;
     }
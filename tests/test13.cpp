@@ -0,0 +1,120 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test13.cpp
+ * @brief Benchmark of the CPU Launcher schedules on a skewed workload.
+ *
+ * @details Mimics transport work where most tracks are cheap (a gamma crossing vacuum) and a few
+ * are expensive (an electron in a dense volume). The expensive items are clustered, which is the
+ * worst case for a static schedule. Both schedules run on the same TaskScheduler threads, so that the
+ * timings only differ by the balancing. They must produce the same checksum.
+ */
+
+#include <CL/sycl.hpp>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+
+#include <CopCore/1/Launcher.h>
+
+// Per-item cost: 1 for most items, 1000 for a clustered 2% of them
+int ItemCost(int i, int n)
+{
+  return (i > n / 2 && i < n / 2 + n / 50) ? 1000 : 1;
+}
+
+// Work function called by the launcher
+void transport(int i, int n, double *result)
+{
+  double x      = 1. + i * 1.e-6;
+  const int len = ItemCost(i, n);
+  for (int k = 0; k < len; ++k)
+    x = std::sqrt(x + k);
+  result[i] = x;
+}
+
+template <class Launcher_t>
+double RunTimed(Launcher_t const &launcher, int n, double *result, double &checksum)
+{
+  auto start = std::chrono::steady_clock::now();
+  launcher.Run(transport, n, {0, 0}, n, result);
+  launcher.WaitStream();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  checksum                              = 0;
+  for (int i = 0; i < n; ++i)
+    checksum += result[i];
+  return elapsed.count();
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  using Launcher_t      = copcore::Launcher<copcore::BackendType::CPU>;
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  constexpr int nitems = 1 << 20;
+  std::vector<double> values(nitems);
+  double checksumStatic = 0, checksumStealing = 0;
+
+  Launcher_t launcher;
+  std::cout << "   worker threads: " << copcore::TaskScheduler::Instance().GetNthreads() << "\n";
+
+  launcher.SetSchedule(Launcher_t::Schedule::kStatic);
+  double tStatic = RunTimed(launcher, nitems, values.data(), checksumStatic);
+
+  launcher.SetSchedule(Launcher_t::Schedule::kWorkStealing);
+  double tStealing = RunTimed(launcher, nitems, values.data(), checksumStealing);
+
+  std::cout << "   work-stealing checksum       ... ";
+  testOK = std::abs(checksumStatic - checksumStealing) <= 1.e-9 * std::abs(checksumStatic);
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Scan a few grain sizes
+  std::cout << std::fixed << std::setprecision(4);
+  std::cout << "   static schedule              : " << tStatic << " s\n";
+  std::cout << "   work-stealing (auto grain)   : " << tStealing << " s\n";
+  for (int grain : {64, 1024, 16384}) {
+    double checksum = 0;
+    launcher.SetGrainSize(grain);
+    double t = RunTimed(launcher, nitems, values.data(), checksum);
+    std::cout << "   work-stealing (grain " << std::setw(5) << grain << ")  : " << t << " s\n";
+    success &= std::abs(checksum - checksumStatic) <= 1.e-9 * std::abs(checksumStatic);
+  }
+
+  // NUMA-spread pinned pool
+  copcore::TaskScheduler pinned(0, copcore::AffinityPolicy::kNumaSpread);
+  launcher.SetScheduler(&pinned);
+  launcher.SetGrainSize(0);
+  double checksum = 0;
+  double tPinned  = RunTimed(launcher, nitems, values.data(), checksum);
+  std::cout << "   work-stealing (NUMA pinned)  : " << tPinned << " s\n";
+  std::cout << "   pinned pool checksum         ... ";
+  testOK = std::abs(checksum - checksumStatic) <= 1.e-9 * std::abs(checksumStatic);
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // An exception thrown by the body reaches the caller once the job is joined, and the pool stays usable.
+  std::cout << "   exception from the body      ... ";
+  bool caught = false;
+  try {
+    pinned.ParallelFor(0, nitems, 64, [](int i) {
+      if (i == nitems / 3) throw std::runtime_error("test13");
+    });
+  } catch (std::runtime_error const &) {
+    caught = true;
+  }
+  RunTimed(launcher, nitems, values.data(), checksum);
+  testOK = caught && std::abs(checksum - checksumStatic) <= 1.e-9 * std::abs(checksumStatic);
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  if (!success) return 1;
+  return 0;
+}
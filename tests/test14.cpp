@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test14.cpp
+ * @brief Unit test and benchmark for the ONEAPI allocators with and without a UsmPool.
+ *
+ * @details Repeatedly allocates and releases MParray buffers of the size of the example9 track
+ * queues, as done between consecutive runs. With the pool only the first iteration goes to the
+ * SYCL runtime.
+ */
+
+#include <CL/sycl.hpp>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+#include <CopCore/1/Allocator.h>
+#include <CopCore/1/VariableSizeObjAllocator.h>
+#include <AdePT/1/MParray.h>
+
+// Kernel filling the array from many work items
+void fillArray(adept::MParray *array, sycl::nd_item<3> item_ct1)
+{
+  int id = item_ct1.get_group(2) * item_ct1.get_local_range().get(2) + item_ct1.get_local_id(2);
+  array->push_back(id);
+}
+
+template <class Alloc_t>
+double AllocCycle(Alloc_t const &alloc, sycl::queue &q_ct1, int niter, int nthreads, bool &valid)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < niter; ++iter) {
+    auto array = alloc.allocate(2);
+    q_ct1.parallel_for(sycl::nd_range<3>(sycl::range<3>(1, 1, nthreads), sycl::range<3>(1, 1, 64)),
+                       [=](sycl::nd_item<3> item_ct1) { fillArray(array, item_ct1); });
+    q_ct1.wait_and_throw();
+    valid &= array->size() == nthreads;
+    alloc.deallocate(array, 2);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  using Array_t         = adept::MParray;
+  using Alloc_t         = copcore::VariableSizeObjAllocator<Array_t, copcore::BackendType::ONEAPI>;
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  constexpr int capacity = 256 * 1024;
+  constexpr int niter    = 100;
+  constexpr int nthreads = 64 * 1024;
+
+  // Plain USM allocations
+  Alloc_t plain(capacity, q_ct1);
+  bool valid    = true;
+  double tPlain = AllocCycle(plain, q_ct1, niter, nthreads, valid);
+  std::cout << "   plain USM allocations        ... " << result[valid] << "\n";
+  success &= valid;
+
+  // Pooled allocations
+  copcore::UsmPool pool(q_ct1);
+  Alloc_t pooled(capacity, pool);
+  valid          = true;
+  double tPooled = AllocCycle(pooled, q_ct1, niter, nthreads, valid);
+  std::cout << "   pooled USM allocations       ... " << result[valid] << "\n";
+  success &= valid;
+
+  std::cout << "   pool hits/misses             ... ";
+  testOK = pool.GetMisses() == 1 && pool.GetHits() == niter - 1 && pool.GetLiveBytes() == 0;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Objects of fixed size constructed on the device
+  copcore::Allocator<int, copcore::BackendType::ONEAPI> intAlloc(pool, copcore::UsmKind::kDevice);
+  int *values = intAlloc.allocate(1024, 7);
+  int sum     = 0;
+  {
+    int *dsum = sycl::malloc_shared<int>(1, q_ct1);
+    *dsum     = 0;
+    q_ct1
+        .single_task([=]() {
+          for (int i = 0; i < 1024; ++i)
+            *dsum += values[i];
+        })
+        .wait_and_throw();
+    sum = *dsum;
+    sycl::free(dsum, q_ct1);
+  }
+  intAlloc.deallocate(values, 1024);
+  std::cout << "   device-constructed objects   ... ";
+  testOK = sum == 7 * 1024;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  pool.Trim();
+  std::cout << "   pool trim                    ... ";
+  testOK = pool.GetCachedBytes() == 0;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  std::cout << std::fixed << std::setprecision(4);
+  std::cout << "   " << niter << " alloc/free cycles, plain  : " << tPlain << " s\n";
+  std::cout << "   " << niter << " alloc/free cycles, pooled : " << tPooled << " s\n";
+
+  if (!success) return 1;
+  return 0;
+}
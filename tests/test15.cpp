@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test15.cpp
+ * @brief Microbenchmark of adept::Atomic_t memory orders and scopes.
+ *
+ * @details Every work item increments a counter many times. The same kernel is run with the strongest
+ * semantics (seq_cst, system scope), with the relaxed device-scope counter used by the containers, and
+ * with a work-group scope counter in local memory flushed once per group. All must count the same.
+ */
+
+#include <CL/sycl.hpp>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+#include <AdePT/1/Atomic.h>
+#include <AdePT/1/MParray.h>
+
+using adept::memory_order;
+using adept::memory_scope;
+
+using SeqCstCounter_t  = adept::Atomic_t<int, memory_order::seq_cst, memory_scope::system>;
+using RelaxedCounter_t = adept::AtomicCounter_t<int>;
+using LocalCounter_t   = adept::Atomic_t<int, memory_order::relaxed, memory_scope::work_group,
+                                       sycl::access::address_space::local_space>;
+
+constexpr int kGroups     = 4096;
+constexpr int kGroupSize  = 128;
+constexpr int kIncrements = 64;
+
+template <class Counter_t>
+double RunGlobal(sycl::queue &q_ct1, Counter_t *counter)
+{
+  counter->store(0);
+  auto start = std::chrono::steady_clock::now();
+  q_ct1
+      .parallel_for(sycl::nd_range<1>(kGroups * kGroupSize, kGroupSize),
+                    [=](sycl::nd_item<1> item) {
+                      for (int i = 0; i < kIncrements; ++i)
+                        counter->fetch_add(1);
+                    })
+      .wait_and_throw();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+double RunLocal(sycl::queue &q_ct1, RelaxedCounter_t *counter)
+{
+  counter->store(0);
+  auto start = std::chrono::steady_clock::now();
+  q_ct1
+      .submit([&](sycl::handler &cgh) {
+        sycl::accessor<LocalCounter_t, 1, sycl::access_mode::read_write, sycl::access::target::local> local(1, cgh);
+        cgh.parallel_for(sycl::nd_range<1>(kGroups * kGroupSize, kGroupSize), [=](sycl::nd_item<1> item) {
+          LocalCounter_t &groupCounter = local[0];
+          if (item.get_local_id(0) == 0) groupCounter.store(0);
+          item.barrier(sycl::access::fence_space::local_space);
+          for (int i = 0; i < kIncrements; ++i)
+            groupCounter.fetch_add(1);
+          item.barrier(sycl::access::fence_space::local_space);
+          if (item.get_local_id(0) == 0) counter->fetch_add(groupCounter.load());
+        });
+      })
+      .wait_and_throw();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+  constexpr int expected = kGroups * kGroupSize * kIncrements;
+
+  auto seqCst  = new (sycl::malloc_shared<SeqCstCounter_t>(1, q_ct1)) SeqCstCounter_t;
+  auto relaxed = new (sycl::malloc_shared<RelaxedCounter_t>(1, q_ct1)) RelaxedCounter_t;
+
+  // Warm up (JIT compilation)
+  RunGlobal(q_ct1, seqCst);
+  RunGlobal(q_ct1, relaxed);
+  RunLocal(q_ct1, relaxed);
+
+  double tSeqCst = RunGlobal(q_ct1, seqCst);
+  std::cout << "   seq_cst, system scope        ... ";
+  testOK = seqCst->load() == expected;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  double tRelaxed = RunGlobal(q_ct1, relaxed);
+  std::cout << "   relaxed, device scope        ... ";
+  testOK = relaxed->load() == expected;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  double tLocal = RunLocal(q_ct1, relaxed);
+  std::cout << "   relaxed, work-group scope    ... ";
+  testOK = relaxed->load() == expected;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // MParray filled concurrently with relaxed counters
+  constexpr int capacity = kGroups * kGroupSize;
+  auto array = adept::MParray::MakeInstanceAt(
+      capacity, sycl::malloc_shared(adept::MParray::SizeOfInstance(capacity), q_ct1));
+  auto start = std::chrono::steady_clock::now();
+  q_ct1
+      .parallel_for(sycl::nd_range<1>(capacity, kGroupSize),
+                    [=](sycl::nd_item<1> item) { array->push_back(item.get_global_id(0)); })
+      .wait_and_throw();
+  std::chrono::duration<double> tArray = std::chrono::steady_clock::now() - start;
+  std::cout << "   MParray concurrent push_back ... ";
+  testOK = array->size() == capacity && array->full();
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  std::cout << std::fixed << std::setprecision(6);
+  std::cout << "   " << expected << " increments, seq_cst/system   : " << tSeqCst << " s\n";
+  std::cout << "   " << expected << " increments, relaxed/device   : " << tRelaxed << " s\n";
+  std::cout << "   " << expected << " increments, relaxed/group    : " << tLocal << " s\n";
+  std::cout << "   " << capacity << " MParray push_back            : " << tArray.count() << " s\n";
+
+  sycl::free(seqCst, q_ct1);
+  sycl::free(relaxed, q_ct1);
+  sycl::free(array, q_ct1);
+
+  if (!success) return 1;
+  return 0;
+}
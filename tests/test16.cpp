@@ -0,0 +1,182 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test16.cpp
+ * @brief Unit test and benchmark for the bulk and sub-group operations of mpmc_bounded_queue, including the
+ * sub-group dispatch of work items to several queues.
+ */
+
+#include <CL/sycl.hpp>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+#include <AdePT/1/mpmc_bounded_queue.h>
+
+using Queue_t = adept::mpmc_bounded_queue<int>;
+
+constexpr int kBatch = 8;
+
+// Each work item enqueues one value at a time
+void enqueueSingle(Queue_t *queue, sycl::nd_item<1> item)
+{
+  int id = item.get_global_id(0);
+  for (int i = 0; i < kBatch; ++i)
+    queue->enqueue(id * kBatch + i);
+}
+
+// Each work item enqueues a batch of values
+void enqueueBatch(Queue_t *queue, sycl::nd_item<1> item)
+{
+  int id = item.get_global_id(0);
+  int values[kBatch];
+  for (int i = 0; i < kBatch; ++i)
+    values[i] = id * kBatch + i;
+  int done = 0;
+  while (done < kBatch) {
+    int n = queue->enqueue_n(values + done, kBatch - done);
+    if (n == 0) break;
+    done += n;
+  }
+}
+
+// Each work item dequeues a batch of values and accumulates them
+void dequeueBatch(Queue_t *queue, long *sum, sycl::nd_item<1> item)
+{
+  int values[kBatch];
+  int n        = queue->dequeue_n(values, kBatch);
+  long partial = 0;
+  for (int i = 0; i < n; ++i)
+    partial += values[i];
+  sycl::ext::oneapi::atomic_ref<long, sycl::ext::oneapi::memory_order::relaxed, sycl::ext::oneapi::memory_scope::device,
+                                sycl::access::address_space::global_space>(*sum)
+      .fetch_add(partial);
+}
+
+// Odd work items enqueue cooperatively per sub-group
+void enqueueSubgroup(Queue_t *queue, sycl::nd_item<1> item)
+{
+  int id = item.get_global_id(0);
+  queue->enqueue_subgroup(item.get_sub_group(), id, id % 2 == 1);
+}
+
+// All work items try to dequeue cooperatively per sub-group
+void dequeueSubgroup(Queue_t *queue, long *sum, sycl::nd_item<1> item)
+{
+  int value = 0;
+  if (queue->dequeue_subgroup(item.get_sub_group(), value, true))
+    sycl::ext::oneapi::atomic_ref<long, sycl::ext::oneapi::memory_order::relaxed,
+                                  sycl::ext::oneapi::memory_scope::device, sycl::access::address_space::global_space>(
+        *sum)
+        .fetch_add(value);
+}
+
+// Work items dispatched to one of two queues per sub-group, as the process selection of test3
+void dispatchSubgroup(Queue_t *first, Queue_t *second, sycl::nd_item<1> item)
+{
+  int id     = item.get_global_id(0);
+  auto sg    = item.get_sub_group();
+  bool alive = id % 7 != 0;
+  first->enqueue_subgroup(sg, id, alive && id % 3 == 0);
+  second->enqueue_subgroup(sg, id, alive && id % 3 != 0);
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  constexpr int nitems   = 1 << 16;
+  constexpr int capacity = nitems * kBatch;
+  constexpr int nthreads = 64;
+  const long expected    = (long)capacity * (capacity - 1) / 2;
+
+  auto queue = Queue_t::MakeInstanceAt(capacity, sycl::malloc_shared(Queue_t::SizeOfInstance(capacity), q_ct1));
+  long *sum  = sycl::malloc_shared<long>(1, q_ct1);
+  sycl::nd_range<1> range(nitems, nthreads);
+
+  // Warm up (JIT compilation)
+  q_ct1.parallel_for(range, [=](sycl::nd_item<1> item) { enqueueSingle(queue, item); }).wait_and_throw();
+  q_ct1.parallel_for(range, [=](sycl::nd_item<1> item) { enqueueBatch(queue, item); }).wait_and_throw();
+  queue->clear();
+
+  // Single element operations
+  auto start = std::chrono::steady_clock::now();
+  q_ct1.parallel_for(range, [=](sycl::nd_item<1> item) { enqueueSingle(queue, item); }).wait_and_throw();
+  std::chrono::duration<double> tSingle = std::chrono::steady_clock::now() - start;
+  queue->clear();
+
+  // Bulk enqueue
+  start = std::chrono::steady_clock::now();
+  q_ct1.parallel_for(range, [=](sycl::nd_item<1> item) { enqueueBatch(queue, item); }).wait_and_throw();
+  std::chrono::duration<double> tBatch = std::chrono::steady_clock::now() - start;
+  std::cout << "   enqueue_n fills the queue    ... ";
+  testOK = queue->size() == capacity;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Bulk dequeue
+  *sum = 0;
+  q_ct1.parallel_for(range, [=](sycl::nd_item<1> item) { dequeueBatch(queue, sum, item); }).wait_and_throw();
+  std::cout << "   dequeue_n drains the queue   ... ";
+  testOK = queue->size() == 0 && *sum == expected;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Sub-group cooperative operations
+  *sum = 0;
+  q_ct1.parallel_for(range, [=](sycl::nd_item<1> item) { enqueueSubgroup(queue, item); }).wait_and_throw();
+  std::cout << "   sub-group enqueue            ... ";
+  testOK = queue->size() == nitems / 2;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  q_ct1.parallel_for(range, [=](sycl::nd_item<1> item) { dequeueSubgroup(queue, sum, item); }).wait_and_throw();
+  std::cout << "   sub-group dequeue            ... ";
+  testOK = queue->size() == 0 && *sum == (long)nitems * nitems / 4;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Dispatch to two queues, the content of each queue is checked on the host
+  auto other = Queue_t::MakeInstanceAt(capacity, sycl::malloc_shared(Queue_t::SizeOfInstance(capacity), q_ct1));
+  q_ct1.parallel_for(range, [=](sycl::nd_item<1> item) { dispatchSubgroup(queue, other, item); }).wait_and_throw();
+  int nfirst    = 0, nsecond = 0;
+  long sumFirst = 0, sumSecond = 0;
+  for (int id = 0; id < nitems; ++id) {
+    if (id % 7 == 0) continue;
+    if (id % 3 == 0) {
+      nfirst++;
+      sumFirst += id;
+    } else {
+      nsecond++;
+      sumSecond += id;
+    }
+  }
+  std::cout << "   sub-group dispatch           ... ";
+  testOK = queue->size() == nfirst && other->size() == nsecond;
+  for (int i = 0; testOK && i < queue->size(); ++i)
+    sumFirst -= (*queue)[i];
+  for (int i = 0; testOK && i < other->size(); ++i)
+    sumSecond -= (*other)[i];
+  testOK &= sumFirst == 0 && sumSecond == 0;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  std::cout << std::fixed << std::setprecision(6);
+  std::cout << "   " << capacity << " single enqueues : " << tSingle.count() << " s\n";
+  std::cout << "   " << capacity << " bulk enqueues   : " << tBatch.count() << " s\n";
+
+  sycl::free(sum, q_ct1);
+  sycl::free(queue, q_ct1);
+  sycl::free(other, q_ct1);
+
+  if (!success) return 1;
+  return 0;
+}
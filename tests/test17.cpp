@@ -0,0 +1,135 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test17.cpp
+ * @brief Unit test and benchmark for the parallel SparseVector selection and compaction.
+ *
+ * @details A vector of 1M slots is filled, every third element is released, and the remaining elements
+ * are selected and compacted into a second vector, both with the sub-group device kernels and with the
+ * host prefix-sum implementation.
+ */
+
+#include <CL/sycl.hpp>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+#include <AdePT/1/SparseVector.h>
+
+struct Track_t {
+  int id{0};
+  float energy{0.};
+
+  Track_t(int itr) : id(itr), energy((itr % 100) * 0.01f) {}
+};
+
+constexpr unsigned kCapacity = 1 << 20;
+using Vector_t               = adept::SparseVector<Track_t, kCapacity>;
+using VectorInterface        = adept::SparseVectorInterface<Track_t>;
+
+// Fill the vector and release every third element
+void FillVector(VectorInterface *vect)
+{
+  vect->clear();
+  for (unsigned i = 0; i < kCapacity; ++i)
+    vect->next_free(i);
+  for (unsigned i = 0; i < kCapacity; i += 3)
+    vect->release(i);
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  auto &q_ct1 = dpct::get_default_queue();
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  auto vect1 = Vector_t::MakeInstanceAt(sycl::malloc_shared(sizeof(Vector_t), q_ct1));
+  auto vect2 = Vector_t::MakeInstanceAt(sycl::malloc_shared(sizeof(Vector_t), q_ct1));
+  auto selection = sycl::malloc_shared<unsigned>(kCapacity, q_ct1);
+  auto nselected = sycl::malloc_shared<unsigned>(1, q_ct1);
+  const unsigned nused = kCapacity - (kCapacity + 2) / 3;
+  auto select_func     = [](int i, const VectorInterface *arr) { return ((*arr)[i].energy < 0.2f); };
+
+  FillVector(vect1);
+  unsigned expectedLow = 0;
+  for (unsigned i = 0; i < kCapacity; ++i)
+    if (i % 3 && (*vect1)[i].energy < 0.2f) expectedLow++;
+
+  // Host selection, order preserving
+  auto start = std::chrono::steady_clock::now();
+  VectorInterface::select_host(vect1, select_func, selection, nselected);
+  std::chrono::duration<double> tSelectHost = std::chrono::steady_clock::now() - start;
+  std::cout << "   host select                  ... ";
+  testOK = *nselected == expectedLow;
+  for (unsigned i = 1; testOK && i < *nselected; ++i)
+    testOK = selection[i] > selection[i - 1];
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Device selection
+  *nselected = 0;
+  start      = std::chrono::steady_clock::now();
+  VectorInterface::select(vect1, select_func, selection, nselected).wait_and_throw();
+  std::chrono::duration<double> tSelectDevice = std::chrono::steady_clock::now() - start;
+  std::cout << "   device select                ... ";
+  testOK = *nselected == expectedLow;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Host release of the selection
+  VectorInterface::release_selected_host(vect1, selection, *nselected);
+  std::cout << "   host release_selected        ... ";
+  testOK = vect1->size_used() == nused - expectedLow;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Host compaction
+  FillVector(vect1);
+  vect2->clear();
+  start = std::chrono::steady_clock::now();
+  VectorInterface::compact_host(vect1, vect2, nselected);
+  std::chrono::duration<double> tCompactHost = std::chrono::steady_clock::now() - start;
+  std::cout << "   host compact                 ... ";
+  testOK = *nselected == nused && vect2->size_used() == nused && vect1->size_used() == 0;
+  for (unsigned i = 1; testOK && i < nused; ++i)
+    testOK = (*vect2)[i].id > (*vect2)[i - 1].id && (*vect2)[i].id % 3 != 0;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Device compaction
+  FillVector(vect1);
+  vect2->clear();
+  *nselected = 0;
+  start      = std::chrono::steady_clock::now();
+  VectorInterface::compact(vect1, vect2, nselected).wait_and_throw();
+  std::chrono::duration<double> tCompactDevice = std::chrono::steady_clock::now() - start;
+  std::cout << "   device compact               ... ";
+  testOK         = *nselected == nused && vect2->size_used() == nused && vect2->size() == nused;
+  long long sum1 = 0, sum2 = 0;
+  for (unsigned i = 0; i < kCapacity; ++i)
+    if (i % 3) sum1 += i;
+  for (unsigned i = 0; testOK && i < nused; ++i)
+    sum2 += (*vect2)[i].id;
+  testOK &= sum1 == sum2;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  std::cout << std::fixed << std::setprecision(6);
+  std::cout << "   select  " << kCapacity << " slots, host   : " << tSelectHost.count() << " s\n";
+  std::cout << "   select  " << kCapacity << " slots, device : " << tSelectDevice.count() << " s\n";
+  std::cout << "   compact " << kCapacity << " slots, host   : " << tCompactHost.count() << " s\n";
+  std::cout << "   compact " << kCapacity << " slots, device : " << tCompactDevice.count() << " s\n";
+
+  sycl::free(vect1, q_ct1);
+  sycl::free(vect2, q_ct1);
+  sycl::free(selection, q_ct1);
+  sycl::free(nselected, q_ct1);
+
+  if (!success) return 1;
+  return 0;
+}
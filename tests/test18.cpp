@@ -0,0 +1,137 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test18.cpp
+ * @brief Unit test for the relocation cache: concurrent stores and lookups, and the usage counters.
+ */
+
+#include <CL/sycl.hpp>
+#include <iostream>
+
+#include <AdePT/1/RelocationCache.h>
+
+using NavIndex_t = adept::RelocationCache::NavIndex_t;
+
+// The final state stored for a key, so that any value found can be checked against its key
+NavIndex_t FinalOf(NavIndex_t previous, NavIndex_t tentative)
+{
+  return 3 * previous + tentative + 1;
+}
+
+// Each work item stores one key, several work items sharing the same key
+void storeKeys(adept::RelocationCache cache, int nkeys, sycl::nd_item<1> item)
+{
+  NavIndex_t previous  = item.get_global_id(0) % nkeys;
+  NavIndex_t tentative = previous + 7;
+  cache.Store(previous, tentative, FinalOf(previous, tentative));
+}
+
+// Each work item looks up one stored key and one key never stored, and records what it finds
+void lookupKeys(adept::RelocationCache cache, int nkeys, int *found, int *wrong, sycl::nd_item<1> item)
+{
+  NavIndex_t previous  = item.get_global_id(0);
+  NavIndex_t tentative = previous + 7;
+  NavIndex_t final     = cache.Lookup(previous, tentative);
+  // A key is either found with its own final state, or was evicted by another key of the same entry.
+  if (final != 0) {
+    found[previous] = 1;
+    if (final != FinalOf(previous, tentative)) wrong[previous] = 1;
+    cache.CountHit();
+  }
+  // The tags prevent answering for keys that were never stored.
+  if (cache.Lookup(previous + nkeys, tentative) != 0) wrong[previous] = 1;
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  constexpr int log2Entries = 12;
+  constexpr int nkeys       = 1 << 10;
+  constexpr int nstores     = 16 * nkeys;
+  constexpr int nthreads    = 64;
+
+  adept::RelocationCacheStorage storage;
+  storage.Allocate(q_ct1, log2Entries, /*statistics=*/true);
+  const adept::RelocationCache cache = storage.View();
+
+  int *found = sycl::malloc_shared<int>(nkeys, q_ct1);
+  int *wrong = sycl::malloc_shared<int>(nkeys, q_ct1);
+  for (int i = 0; i < nkeys; ++i)
+    found[i] = wrong[i] = 0;
+
+  q_ct1.parallel_for(sycl::nd_range<1>(nstores, nthreads), [=](sycl::nd_item<1> item) {
+    storeKeys(cache, nkeys, item);
+  }).wait_and_throw();
+  q_ct1.parallel_for(sycl::nd_range<1>(nkeys, nthreads), [=](sycl::nd_item<1> item) {
+    lookupKeys(cache, nkeys, found, wrong, item);
+  }).wait_and_throw();
+
+  int numFound = 0, numWrong = 0;
+  for (int i = 0; i < nkeys; ++i) {
+    numFound += found[i];
+    numWrong += wrong[i];
+  }
+
+  std::cout << "   no wrong or foreign states    ... ";
+  testOK = numWrong == 0;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // With four entries per key, most keys keep their entry.
+  std::cout << "   most stored keys are found    ... ";
+  testOK = numFound > nkeys / 2;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  const auto summary = storage.GetSummary();
+  std::cout << "   counters                      ... ";
+  testOK = summary.lookups == 2 * nkeys && summary.hits == (unsigned long long)numFound && summary.stores == nstores;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Counters written back, as when an iteration is undone
+  std::cout << "   counters set from a summary   ... ";
+  storage.SetSummary({3, 2, 1});
+  const auto restored = storage.GetSummary();
+  testOK              = restored.lookups == 3 && restored.hits == 2 && restored.stores == 1;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  storage.Clear();
+  std::cout << "   clear forgets all entries     ... ";
+  q_ct1.single_task([=]() { found[0] = cache.Lookup(0, 7); }).wait_and_throw();
+  testOK = found[0] == 0 && storage.GetSummary().lookups == 1;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Without statistics, the cache works the same and no counters are kept.
+  adept::RelocationCacheStorage plain;
+  plain.Allocate(q_ct1, log2Entries);
+  const adept::RelocationCache plainCache = plain.View();
+  std::cout << "   no counters without statistics ... ";
+  q_ct1.single_task([=]() {
+    plainCache.Store(3, 7, 11);
+    found[0] = plainCache.Lookup(3, 7);
+    plainCache.CountHit();
+  }).wait_and_throw();
+  testOK = found[0] == 11 && !plain.HasStatistics() && plain.GetSummary().lookups == 0;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  std::cout << "   " << numFound << " of " << nkeys << " keys found in " << storage.GetNumEntries() << " entries\n";
+
+  sycl::free(found, q_ct1);
+  sycl::free(wrong, q_ct1);
+
+  if (!success) return 1;
+  return 0;
+}
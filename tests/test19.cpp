@@ -0,0 +1,146 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test19.cpp
+ * @brief Unit test for GeometryImage: file round trip, rejection of truncated or inconsistent files, and
+ *        point location in the device copy.
+ */
+
+#include <CL/sycl.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <AdePT/1/GeometryImage.h>
+#include <AdePT/1/LoopNavigator.h>
+
+#include <VecGeom/management/GeoManager.h>
+#include <VecGeom/volumes/LogicalVolume.h>
+#include <VecGeom/volumes/UnplacedBox.h>
+#include <VecGeom/volumes/UnplacedTube.h>
+
+// A world box holding a row of layers, each with a tube inside
+const vecgeom::VPlacedVolume *BuildGeometry(int nlayers)
+{
+  auto worldSolid = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(100., 100., 100.);
+  auto layerSolid = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(1., 50., 50.);
+  auto tubeSolid  = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedTube>(0., 0.5, 20., 0., vecgeom::kTwoPi);
+
+  auto world = new vecgeom::LogicalVolume("world", worldSolid);
+  auto layer = new vecgeom::LogicalVolume("layer", layerSolid);
+  auto tube  = new vecgeom::LogicalVolume("tube", tubeSolid);
+  layer->PlaceDaughter("tube", tube, new vecgeom::Transformation3D(0., 0., 0., 0., 90., 0.));
+  for (int i = 0; i < nlayers; ++i) {
+    world->PlaceDaughter("layer", layer, new vecgeom::Transformation3D(-90. + 4. * i, 0., 0.));
+  }
+
+  vecgeom::GeoManager::Instance().SetWorldAndClose(world->Place());
+  return vecgeom::GeoManager::Instance().GetWorld();
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  constexpr int nlayers = 10;
+  const char *filename  = "test19.geometry";
+
+  adept::GeometryImage image;
+  image.Build(BuildGeometry(nlayers));
+  const adept::GeometryImageView host = image.HostView();
+
+  std::cout << "   image of the geometry         ... ";
+  testOK = host.GetNumLogical() == 3 && host.GetNumPlaced() == 1 + nlayers + 1 &&
+           host.Logical(0).fNumDaughters == nlayers &&
+           host.Placed(host.Daughter(host.Logical(0), 3)).fTranslation[0] == -78.;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  adept::GeometryImage loaded;
+  std::cout << "   file round trip               ... ";
+  testOK = image.Save(filename) && loaded.Load(filename) && loaded.GetSize() == image.GetSize() &&
+           std::memcmp(loaded.HostView().Placed(nlayers + 1).fRotation, host.Placed(nlayers + 1).fRotation,
+                       sizeof(host.Placed(nlayers + 1).fRotation)) == 0;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Corrupt a copy of the image in the file and check that it is not accepted.
+  std::vector<char> bytes(image.GetSize());
+  {
+    std::ifstream in(filename, std::ios::binary);
+    in.read(bytes.data(), bytes.size());
+  }
+  auto loadCorrupted = [&](std::vector<char> const &corrupted) {
+    {
+      std::ofstream out(filename, std::ios::binary);
+      out.write(corrupted.data(), corrupted.size());
+    }
+    adept::GeometryImage rejected;
+    return !rejected.Load(filename) && rejected.Empty();
+  };
+  auto withHeader = [&](void (*modify)(adept::GeometryImageLayout::Header &)) {
+    std::vector<char> corrupted = bytes;
+    modify(*(adept::GeometryImageLayout::Header *)corrupted.data());
+    return corrupted;
+  };
+
+  std::cout << "   rejection of corrupted files  ... ";
+  testOK = loadCorrupted(std::vector<char>(bytes.begin(), bytes.end() - 8));
+  testOK &= loadCorrupted(withHeader([](adept::GeometryImageLayout::Header &h) { h.fSize = 4; }));
+  testOK &= loadCorrupted(withHeader([](adept::GeometryImageLayout::Header &h) { h.fSize *= 1000; }));
+  testOK &= loadCorrupted(withHeader([](adept::GeometryImageLayout::Header &h) { h.fVersion++; }));
+  testOK &= loadCorrupted(withHeader([](adept::GeometryImageLayout::Header &h) { h.fNumPlaced = 1 << 30; }));
+  testOK &= loadCorrupted(withHeader([](adept::GeometryImageLayout::Header &h) {
+    h.fNavIndexOffset = h.fSize;
+    h.fNumNavIndex++;
+  }));
+  testOK &= loadCorrupted(withHeader([](adept::GeometryImageLayout::Header &h) { h.fNumDaughters = 1; }));
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+  std::remove(filename);
+
+  // Locate points in the world, in layers and in tubes with the device copy, and compare with VecGeom.
+  using Point_t                 = vecgeom::Vector3D<vecgeom::Precision>;
+  constexpr int npoints         = 6;
+  const Point_t points[npoints] = {{0., 80., 0.},    {-78., 30., 0.}, {-78., 0., 10.},
+                                   {-90., 0.2, -19.}, {-78., 0., 30.}, {0., 0., 150.}};
+  Point_t *devPoints            = sycl::malloc_shared<Point_t>(npoints, q_ct1);
+  vecgeom::NavIndex_t *located  = sycl::malloc_shared<vecgeom::NavIndex_t>(npoints, q_ct1);
+  for (int i = 0; i < npoints; ++i)
+    devPoints[i] = points[i];
+
+  const adept::GeometryImageView device = image.Upload(q_ct1);
+  q_ct1.parallel_for(sycl::range<1>(npoints), [=](sycl::id<1> i) {
+    located[i] = device.LocatePoint(devPoints[i]);
+  }).wait_and_throw();
+
+  std::cout << "   point location on the device  ... ";
+  testOK = device.Enabled();
+  for (int i = 0; i < npoints; ++i) {
+    vecgeom::NavStateIndex state;
+    LoopNavigator::LocatePointIn(vecgeom::GeoManager::Instance().GetWorld(), points[i], state, true);
+    testOK &= located[i] == state.GetNavIndex(state.GetLevel());
+  }
+  testOK &= located[npoints - 1] == 0;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  image.FreeDevice();
+  sycl::free(devPoints, q_ct1);
+  sycl::free(located, q_ct1);
+
+  std::cout << "   " << image.GetSize() << " bytes for " << host.GetNumPlaced() << " placed volumes\n";
+
+  if (!success) return 1;
+  return 0;
+}
@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test20.cpp
+ * @brief Unit test for FieldMap and RungeKuttaStepper: interpolation, file round trip, device access and
+ * integration in a uniform map against the helix solution.
+ */
+
+#include <CL/sycl.hpp>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include <CopCore/1/SystemOfUnits.h>
+#include <Field/1/ConstFieldHelixStepper.h>
+#include <Field/1/FieldMap.h>
+#include <Field/1/RungeKuttaStepper.h>
+
+using Vector3D = vecgeom::Vector3D<double>;
+
+// A field linear in the position (in mm), interpolated exactly by trilinear interpolation. In tesla.
+Vector3D LinearField(double x, double y, double z)
+{
+  return Vector3D(0.001 * y, -0.002 * x + 0.5, 1. + 0.003 * z);
+}
+
+bool Near(Vector3D const &a, Vector3D const &b, double tolerance)
+{
+  return (a - b).Mag() <= tolerance * (1. + b.Mag());
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  using copcore::units::mm;
+  using copcore::units::tesla;
+
+  // A grid of 23 x 18 x 11 points, not a multiple of the brick size, spaced by 10 mm.
+  const int n[3]          = {23, 18, 11};
+  const double origin[3]  = {-110., -85., -50.};
+  const double spacing[3] = {10., 10., 10.};
+  const char *filename    = "test20.fieldmap";
+
+  FieldMapBuilder builder;
+  builder.Fill(n, origin, spacing, LinearField);
+  const FieldMap host = builder.HostView();
+
+  const Vector3D points[] = {{0., 0., 0.}, {-110., -85., -50.}, {110., 85., 50.}, {33.3, -71.2, 48.9}, {-1., 2., -3.}};
+  constexpr int numPoints = sizeof(points) / sizeof(points[0]);
+
+  std::cout << "   interpolation of a linear field ... ";
+  testOK = true;
+  for (int i = 0; i < numPoints; ++i) {
+    const Vector3D &p = points[i];
+    testOK &= Near(host.Evaluate(mm * p), tesla * LinearField(p.x(), p.y(), p.z()), 1.e-6);
+  }
+  testOK &= host.Evaluate(mm * Vector3D(0., 0., 51.)).Mag() == 0.;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  FieldMapBuilder loaded;
+  std::cout << "   file round trip                 ... ";
+  testOK = builder.Save(filename) && loaded.Load(filename) && loaded.GetSize() == builder.GetSize() &&
+           loaded.HostView().Evaluate(mm * points[3]) == host.Evaluate(mm * points[3]);
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+  std::remove(filename);
+
+  // Evaluate the map on the device at the same points.
+  const FieldMap device = loaded.Upload(q_ct1);
+  Vector3D *values      = sycl::malloc_shared<Vector3D>(numPoints, q_ct1);
+  Vector3D *where       = sycl::malloc_shared<Vector3D>(numPoints, q_ct1);
+  for (int i = 0; i < numPoints; ++i) {
+    where[i] = mm * points[i];
+  }
+  q_ct1.parallel_for(sycl::range<1>(numPoints), [=](sycl::id<1> i) { values[i] = device.Evaluate(where[i]); })
+      .wait_and_throw();
+  std::cout << "   evaluation on the device        ... ";
+  testOK = true;
+  for (int i = 0; i < numPoints; ++i) {
+    testOK &= Near(values[i], host.Evaluate(where[i]), 1.e-12);
+  }
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // In a uniform map, the Runge-Kutta integration follows the helix.
+  const Vector3D uniform(0.3, -0.4, 1.2);
+  FieldMapBuilder uniformBuilder;
+  uniformBuilder.Fill(n, origin, spacing, [&](double, double, double) { return uniform; });
+  const RungeKuttaStepper<FieldMap> rungeKutta(uniformBuilder.HostView());
+  const ConstFieldHelixStepper helix(uniform.x() * tesla, uniform.y() * tesla, uniform.z() * tesla);
+
+  const Vector3D start(0., 0., 0.);
+  const Vector3D direction = Vector3D(1., 0.5, 0.2).Unit();
+  const double momentum    = 10 * copcore::units::MeV;
+  const double step        = 20 * mm;
+  Vector3D rkPos, rkDir, helixPos, helixDir;
+  rungeKutta.DoStep(start, direction, -1, momentum, step, rkPos, rkDir);
+  helix.DoStep(start, direction, -1, momentum, step, helixPos, helixDir);
+
+  std::cout << "   Runge-Kutta versus helix        ... ";
+  testOK = (rkPos - helixPos).Mag() < 1.e-3 * mm && (rkDir - helixDir).Mag() < 1.e-4;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  std::cout << "   " << builder.GetSize() << " bytes for " << n[0] * n[1] * n[2] << " grid points\n";
+
+  sycl::free(values, q_ct1);
+  sycl::free(where, q_ct1);
+
+  if (!success) return 1;
+  return 0;
+}
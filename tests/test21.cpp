@@ -0,0 +1,123 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test21.cpp
+ * @brief Unit test for HelixBatchStepper: SIMD steps on the host and steps on the device against the
+ * scalar steppers, for a field along z and a field of any direction.
+ */
+
+#include <CL/sycl.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include <CopCore/1/SystemOfUnits.h>
+#include <Field/1/HelixBatch.h>
+
+// Storage for the SoA arrays of a batch, in shared USM to be stepped on the host or on the device
+struct BatchStorage {
+  sycl::queue &fQueue;
+  double *fData;
+  int *fCharge;
+  HelixBatch fBatch;
+
+  BatchStorage(sycl::queue &queue, int size) : fQueue(queue)
+  {
+    fData   = sycl::malloc_shared<double>(8 * size, queue);
+    fCharge = sycl::malloc_shared<int>(size, queue);
+    fBatch  = {{fData, fData + size, fData + 2 * size},
+              {fData + 3 * size, fData + 4 * size, fData + 5 * size},
+              fCharge,
+              fData + 6 * size,
+              fData + 7 * size,
+              size};
+  }
+  ~BatchStorage()
+  {
+    sycl::free(fData, fQueue);
+    sycl::free(fCharge, fQueue);
+  }
+
+  void CopyFrom(BatchStorage const &other)
+  {
+    std::copy(other.fData, other.fData + 8 * fBatch.fSize, fData);
+    std::copy(other.fCharge, other.fCharge + fBatch.fSize, fCharge);
+  }
+};
+
+// Largest difference of the positions and directions of two batches
+double MaxDifference(HelixBatch const &a, HelixBatch const &b)
+{
+  double diff = 0;
+  for (int c = 0; c < 3; ++c) {
+    for (int i = 0; i < a.fSize; ++i) {
+      diff = std::max(diff, std::abs(a.fPos[c][i] - b.fPos[c][i]));
+      diff = std::max(diff, std::abs(a.fDir[c][i] - b.fDir[c][i]));
+    }
+  }
+  return diff;
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  // A batch size which is not a multiple of the vector size, to exercise the remainder.
+  constexpr int size = 1001;
+
+  BatchStorage initial(q_ct1, size);
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<double> uniform(-1., 1.);
+  for (int i = 0; i < size; ++i) {
+    double dir[3]     = {uniform(rng), uniform(rng), uniform(rng)};
+    const double norm = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+    for (int c = 0; c < 3; ++c) {
+      initial.fBatch.fPos[c][i] = 10 * uniform(rng) * copcore::units::cm;
+      initial.fBatch.fDir[c][i] = dir[c] / norm;
+    }
+    initial.fCharge[i]          = i % 3 - 1;
+    initial.fData[6 * size + i] = (1 + uniform(rng)) * 10 * copcore::units::MeV;
+    initial.fData[7 * size + i] = (1 + uniform(rng)) * copcore::units::cm;
+  }
+
+  // The scalar steppers keep the field in single precision, hence the tolerance of the SIMD steps.
+  const float tesla        = copcore::units::tesla;
+  const float fields[2][3] = {{0, 0, 1.5f * tesla}, {0.3f * tesla, -0.4f * tesla, 1.2f * tesla}};
+  const char *names[2]     = {"field along z  ", "field any dir. "};
+
+  BatchStorage scalar(q_ct1, size), simd(q_ct1, size), device(q_ct1, size);
+  for (int f = 0; f < 2; ++f) {
+    const HelixBatchStepper stepper(fields[f][0], fields[f][1], fields[f][2]);
+    scalar.CopyFrom(initial);
+    simd.CopyFrom(initial);
+    device.CopyFrom(initial);
+
+    for (int i = 0; i < size; ++i) {
+      stepper.DoStep(scalar.fBatch, i);
+    }
+    stepper.DoStepHost(simd.fBatch);
+    stepper.Submit(q_ct1, device.fBatch).wait_and_throw();
+
+    std::cout << "   " << names[f] << " SIMD on host ... ";
+    testOK = MaxDifference(simd.fBatch, scalar.fBatch) < 1.e-4;
+    std::cout << result[testOK] << "\n";
+    success &= testOK;
+
+    std::cout << "   " << names[f] << " on device    ... ";
+    testOK = MaxDifference(device.fBatch, scalar.fBatch) < 1.e-9;
+    std::cout << result[testOK] << "\n";
+    success &= testOK;
+  }
+
+  if (!success) return 1;
+  return 0;
+}
@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test22.cpp
+ * @brief Unit test for PackedNavState: packing of located navigation states on the host, and unpacking on
+ * the host and on the device, keeping the navigation index and the boundary flag.
+ */
+
+#include <CL/sycl.hpp>
+#include <iostream>
+
+#include <AdePT/1/LoopNavigator.h>
+#include <AdePT/1/PackedNavState.h>
+
+#include <VecGeom/management/GeoManager.h>
+#include <VecGeom/volumes/LogicalVolume.h>
+#include <VecGeom/volumes/UnplacedBox.h>
+
+using vecgeom::NavIndex_t;
+
+// A world box holding a row of layers, each with a box inside
+const vecgeom::VPlacedVolume *BuildGeometry(int nlayers)
+{
+  auto worldSolid = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(100., 100., 100.);
+  auto layerSolid = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(1., 50., 50.);
+  auto cellSolid  = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(0.5, 10., 10.);
+
+  auto world = new vecgeom::LogicalVolume("world", worldSolid);
+  auto layer = new vecgeom::LogicalVolume("layer", layerSolid);
+  auto cell  = new vecgeom::LogicalVolume("cell", cellSolid);
+  layer->PlaceDaughter("cell", cell, new vecgeom::Transformation3D(0., 0., 0.));
+  for (int i = 0; i < nlayers; ++i) {
+    world->PlaceDaughter("layer", layer, new vecgeom::Transformation3D(-90. + 4. * i, 0., 0.));
+  }
+
+  vecgeom::GeoManager::Instance().SetWorldAndClose(world->Place());
+  return vecgeom::GeoManager::Instance().GetWorld();
+}
+
+// Navigation index of a state, 0 outside the world
+NavIndex_t NavIndexOf(vecgeom::NavStateIndex const &state)
+{
+  return state.IsOutside() ? 0 : state.GetNavIndex(state.GetLevel());
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  const vecgeom::VPlacedVolume *world = BuildGeometry(10);
+
+  // States in the world, in layers, in cells, and outside the world
+  using Point_t                   = vecgeom::Vector3D<vecgeom::Precision>;
+  constexpr int numStates         = 6;
+  const Point_t points[numStates] = {{0., 80., 0.},  {-78., 30., 0.}, {-78., 0., 5.},
+                                     {-90., 0., -9.}, {-42., 0., 0.},  {0., 0., 150.}};
+
+  vecgeom::NavStateIndex states[numStates];
+  NavIndex_t navInd[numStates];
+  for (int i = 0; i < numStates; ++i) {
+    LoopNavigator::LocatePointIn(world, points[i], states[i], true);
+    states[i].SetBoundaryState(i % 2);
+    navInd[i] = NavIndexOf(states[i]);
+  }
+
+  std::cout << "   packed size                 ... ";
+  testOK = sizeof(adept::PackedNavState) == sizeof(NavIndex_t);
+  std::cout << result[testOK] << " (" << sizeof(adept::PackedNavState) << " bytes instead of "
+            << sizeof(vecgeom::NavStateIndex) << ")\n";
+  success &= testOK;
+
+  std::cout << "   round trip on the host      ... ";
+  testOK = navInd[0] != 0 && navInd[numStates - 1] == 0;
+  for (int i = 0; i < numStates; ++i) {
+    adept::PackedNavState packed(states[i]);
+    testOK &= packed.GetNavIndex() == navInd[i] && packed.IsOnBoundary() == bool(i % 2);
+    testOK &= packed.Top() == states[i].Top();
+    vecgeom::NavStateIndex unpacked = packed.Unpack();
+    testOK &= NavIndexOf(unpacked) == navInd[i] && unpacked.IsOnBoundary() == bool(i % 2);
+    packed.SetBoundaryState(!(i % 2));
+    testOK &= packed.GetNavIndex() == navInd[i] && packed.Unpack().IsOnBoundary() == !(i % 2);
+  }
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Pack on the host, unpack and flip the boundary flag on the device.
+  adept::PackedNavState *packed = sycl::malloc_shared<adept::PackedNavState>(numStates, q_ct1);
+  vecgeom::NavStateIndex *out   = sycl::malloc_shared<vecgeom::NavStateIndex>(numStates, q_ct1);
+  for (int i = 0; i < numStates; ++i) {
+    packed[i].Pack(states[i]);
+  }
+  q_ct1
+      .parallel_for(sycl::range<1>(numStates),
+                    [=](sycl::id<1> i) {
+                      out[i] = packed[i].Unpack();
+                      packed[i].SetBoundaryState(!out[i].IsOnBoundary());
+                    })
+      .wait_and_throw();
+
+  std::cout << "   round trip on the device    ... ";
+  testOK = true;
+  for (int i = 0; i < numStates; ++i) {
+    testOK &= NavIndexOf(out[i]) == navInd[i] && out[i].IsOnBoundary() == bool(i % 2);
+    testOK &= packed[i].GetNavIndex() == navInd[i] && packed[i].IsOnBoundary() == !(i % 2);
+  }
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  sycl::free(packed, q_ct1);
+  sycl::free(out, q_ct1);
+
+  if (!success) return 1;
+  return 0;
+}
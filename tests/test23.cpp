@@ -0,0 +1,119 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test23.cpp
+ * @brief Unit test for DaughterBatch: distances to rotated box and tube daughters against
+ * VolumeDispatcher::DistanceToIn on the host.
+ */
+
+#include <CL/sycl.hpp>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <AdePT/1/DaughterBatch.h>
+#include <AdePT/1/VolumeDispatcher.h>
+
+#include <VecGeom/management/GeoManager.h>
+#include <VecGeom/volumes/LogicalVolume.h>
+#include <VecGeom/volumes/UnplacedBox.h>
+#include <VecGeom/volumes/UnplacedTube.h>
+
+using Vector = vecgeom::Vector3D<vecgeom::Precision>;
+
+// A world box holding a grid of rotated boxes and full tubes, more than one block of each
+const vecgeom::VPlacedVolume *BuildGeometry(int ngrid)
+{
+  auto worldSolid = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(100., 100., 100.);
+  auto boxSolid   = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(3., 2., 4.);
+  auto tubeSolid  = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedTube>(0., 2.5, 3., 0., vecgeom::kTwoPi);
+
+  auto world = new vecgeom::LogicalVolume("world", worldSolid);
+  auto box   = new vecgeom::LogicalVolume("box", boxSolid);
+  auto tube  = new vecgeom::LogicalVolume("tube", tubeSolid);
+  for (int i = 0; i < ngrid; ++i) {
+    for (int j = 0; j < ngrid; ++j) {
+      const double x = -80. + 160. * i / (ngrid - 1), y = -80. + 160. * j / (ngrid - 1);
+      auto daughter  = (i + j) % 2 ? box : tube;
+      world->PlaceDaughter("daughter", daughter,
+                           new vecgeom::Transformation3D(x, y, 10. * (i - j), 15. * i, 20. * j, 5. * (i + j)));
+    }
+  }
+
+  vecgeom::GeoManager::Instance().SetWorldAndClose(world->Place());
+  return vecgeom::GeoManager::Instance().GetWorld();
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  constexpr int ngrid   = 6;
+  constexpr int npoints = 20000;
+  // Distances agree to rounding, relative to the size of the world.
+  const double tolerance = adept::kMixedPrecision ? 1.e-3 : 1.e-9;
+
+  auto const *world     = BuildGeometry(ngrid);
+  auto const &daughters = world->GetDaughters();
+
+  adept::DaughterBatchBuilder builder;
+  builder.Build(world);
+  const adept::DaughterBatch batch = builder.HostView();
+  auto const *range                = batch.Find(world->GetLogicalVolume()->id());
+
+  std::cout << "   blocks of the world          ... ";
+  testOK = range != nullptr && range->fNumOthers == 0 &&
+           builder.GetNumBlocks() == 2 * ((ngrid * ngrid / 2 + adept::DaughterBatch::kLanes - 1) /
+                                          adept::DaughterBatch::kLanes);
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+  if (!range) return 1;
+
+  // Points outside of all daughters, in random directions.
+  std::mt19937 rng(12345);
+  std::uniform_real_distribution<double> uniform(-1., 1.);
+  std::vector<double> batchDistances(daughters.size());
+  int numPoints = 0, numHits = 0, numMismatches = 0;
+  while (numPoints < npoints) {
+    const Vector point(95. * uniform(rng), 95. * uniform(rng), 95. * uniform(rng));
+    bool inside = false;
+    Vector local;
+    for (auto *daughter : daughters)
+      inside |= VolumeDispatcher::Contains(daughter, point, local);
+    if (inside) continue;
+    Vector dir(uniform(rng), uniform(rng), uniform(rng));
+    if (dir.Mag2() < 1.e-6) continue;
+    dir.Normalize();
+    numPoints++;
+
+    batch.DistancesToIn(*range, point, dir, [&](int index, vecgeom::Precision distance) {
+      batchDistances[index] = distance;
+    });
+    for (size_t i = 0; i < daughters.size(); ++i) {
+      const double expected = VolumeDispatcher::DistanceToIn(daughters[i], point, dir, vecgeom::kInfLength);
+      const bool expectHit  = expected < vecgeom::kInfLength;
+      const bool batchHit   = batchDistances[i] < vecgeom::kInfLength;
+      numHits += expectHit;
+      if (expectHit != batchHit || (expectHit && std::abs(batchDistances[i] - expected) > 100. * tolerance))
+        numMismatches++;
+    }
+  }
+
+  // Grazing rays may be counted as hits by one and as misses by the other.
+  std::cout << "   distances vs VolumeDispatcher ... ";
+  testOK = numHits > 0 && numMismatches <= 1.e-4 * npoints * daughters.size();
+  std::cout << result[testOK] << " (" << numMismatches << " mismatches, " << numHits << " hits)\n";
+  success &= testOK;
+
+  if (!success) return 1;
+  return 0;
+}
@@ -0,0 +1,220 @@
+// SPDX-FileCopyrightText: 2021 CERN
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file test24.cpp
+ * @brief Unit test for DaughterBVH: FindFirst and ForEachCandidate against the linear scan of the
+ * daughters, on the host and on the device, and ForEachNearer for the safety on the host.
+ */
+
+#include <CL/sycl.hpp>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <AdePT/1/DaughterBVH.h>
+#include <AdePT/1/VolumeDispatcher.h>
+
+#include <VecGeom/management/GeoManager.h>
+#include <VecGeom/volumes/LogicalVolume.h>
+#include <VecGeom/volumes/UnplacedBox.h>
+#include <VecGeom/volumes/UnplacedTube.h>
+
+using Vector = vecgeom::Vector3D<vecgeom::Precision>;
+
+// A world box holding a grid of ngrid^3 rotated boxes and tubes
+const vecgeom::VPlacedVolume *BuildGeometry(int ngrid, std::vector<Vector> &centers)
+{
+  auto worldSolid = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(100., 100., 100.);
+  auto boxSolid   = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedBox>(5., 3., 4.);
+  auto tubeSolid  = vecgeom::GeoManager::MakeInstance<vecgeom::UnplacedTube>(1., 4., 5., 0., vecgeom::kTwoPi);
+
+  auto world = new vecgeom::LogicalVolume("world", worldSolid);
+  auto box   = new vecgeom::LogicalVolume("box", boxSolid);
+  auto tube  = new vecgeom::LogicalVolume("tube", tubeSolid);
+  for (int i = 0; i < ngrid; ++i) {
+    for (int j = 0; j < ngrid; ++j) {
+      for (int k = 0; k < ngrid; ++k) {
+        const Vector center(-60. + 40. * i, -60. + 40. * j, -60. + 40. * k);
+        auto daughter = (i + j + k) % 2 ? box : tube;
+        world->PlaceDaughter("daughter", daughter,
+                             new vecgeom::Transformation3D(center.x(), center.y(), center.z(), 10. * i, 20. * j,
+                                                           30. * k));
+        centers.push_back(center);
+      }
+    }
+  }
+
+  vecgeom::GeoManager::Instance().SetWorldAndClose(world->Place());
+  return vecgeom::GeoManager::Instance().GetWorld();
+}
+
+///______________________________________________________________________________________
+int main(void)
+{
+  sycl::default_selector device_selector;
+  sycl::queue q_ct1(device_selector);
+  std::cout << "Running on " << q_ct1.get_device().get_info<cl::sycl::info::device::name>() << "\n";
+
+  const char *result[2] = {"FAILED", "OK"};
+  bool success          = true;
+  bool testOK           = true;
+
+  constexpr int ngrid   = 4;
+  constexpr int npoints = 4096;
+
+  std::vector<Vector> centers;
+  auto const *world     = BuildGeometry(ngrid, centers);
+  auto const &daughters = world->GetDaughters();
+  const int ndaughters  = daughters.size();
+
+  adept::DaughterBVHBuilder builder;
+  builder.Build(world);
+  const adept::DaughterBVH host = builder.HostView();
+  const int root                = host.Root(world->GetLogicalVolume()->id());
+
+  std::cout << "   tree of the world                  ... ";
+  testOK = root >= 0 && builder.GetNumTrees() == 1;
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+  if (root < 0) return 1;
+
+  // Half of the points close to the daughters, so that some are inside, all in random directions. The
+  // linear scan gives the daughter containing each point, -1 if none, and the nearest daughter along
+  // the ray with its distance.
+  Vector *points    = sycl::malloc_shared<Vector>(npoints, q_ct1);
+  Vector *dirs      = sycl::malloc_shared<Vector>(npoints, q_ct1);
+  double *distances = sycl::malloc_shared<double>(npoints * ndaughters, q_ct1);
+  std::vector<int> containing(npoints, -1), nearest(npoints, -1);
+  std::mt19937 rng(2021);
+  std::uniform_real_distribution<double> uniform(-1., 1.);
+  std::uniform_int_distribution<int> anyDaughter(0, ndaughters - 1);
+  for (int i = 0; i < npoints; ++i) {
+    points[i] = i % 2 ? Vector(95. * uniform(rng), 95. * uniform(rng), 95. * uniform(rng))
+                      : centers[anyDaughter(rng)] + Vector(6. * uniform(rng), 6. * uniform(rng), 6. * uniform(rng));
+    do {
+      dirs[i] = Vector(uniform(rng), uniform(rng), uniform(rng));
+    } while (dirs[i].Mag2() < 1.e-6);
+    dirs[i].Normalize();
+
+    double step = vecgeom::kInfLength;
+    for (int d = 0; d < ndaughters; ++d) {
+      Vector local;
+      if (containing[i] < 0 && VolumeDispatcher::Contains(daughters[d], points[i], local)) containing[i] = d;
+      distances[i * ndaughters + d] =
+          VolumeDispatcher::DistanceToIn(daughters[d], points[i], dirs[i], vecgeom::kInfLength);
+      if (distances[i * ndaughters + d] < step) {
+        step       = distances[i * ndaughters + d];
+        nearest[i] = d;
+      }
+    }
+  }
+
+  // On the host, the tree is queried with VolumeDispatcher as in the navigation.
+  std::cout << "   host FindFirst vs linear scan      ... ";
+  testOK = true;
+  for (int i = 0; i < npoints; ++i) {
+    int found = -1;
+    host.FindFirst(root, points[i], [&](int index) {
+      Vector local;
+      if (!VolumeDispatcher::Contains(daughters[index], points[i], local)) return false;
+      found = index;
+      return true;
+    });
+    testOK &= found == containing[i];
+  }
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  std::cout << "   host ForEachCandidate vs linear    ... ";
+  testOK = true;
+  for (int i = 0; i < npoints; ++i) {
+    int found   = -1;
+    double best = vecgeom::kInfLength;
+    host.ForEachCandidate(root, points[i], dirs[i], best, [&](int index, vecgeom::Precision step) {
+      const double distance = VolumeDispatcher::DistanceToIn(daughters[index], points[i], dirs[i], step);
+      if (distance < best) {
+        best  = distance;
+        found = index;
+      }
+      return best;
+    });
+    testOK &= found == nearest[i] && (found < 0 || best == distances[i * ndaughters + found]);
+  }
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // Safety: the tree skips the daughters whose boxes are farther than the safety found so far. As
+  // SafetyToIn underestimates, the result can be larger than the smallest SafetyToIn of all daughters,
+  // but it stays below the distance to the nearest daughter along the ray.
+  std::cout << "   host ForEachNearer vs linear       ... ";
+  testOK = true;
+  for (int i = 0; i < npoints; ++i) {
+    if (containing[i] >= 0) continue;
+    double expected = vecgeom::kInfLength;
+    for (int d = 0; d < ndaughters; ++d)
+      expected = std::min(expected, (double)VolumeDispatcher::SafetyToIn(daughters[d], points[i]));
+    const double bound = nearest[i] >= 0 ? distances[i * ndaughters + nearest[i]] : vecgeom::kInfLength;
+    double safety = vecgeom::kInfLength;
+    host.ForEachNearer(root, points[i], safety, [&](int index, vecgeom::Precision) {
+      safety = std::min(safety, (double)VolumeDispatcher::SafetyToIn(daughters[index], points[i]));
+      return safety;
+    });
+    testOK &= safety >= expected && safety <= bound + vecgeom::kTolerance;
+  }
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  // On the device, the distances and the containing daughters of the linear scan stand in for the
+  // geometry, and the traversal has to find the same daughters.
+  const adept::DaughterBVH device = builder.Upload(q_ct1);
+  int *expected                   = sycl::malloc_shared<int>(npoints, q_ct1);
+  int *foundFirst                 = sycl::malloc_shared<int>(npoints, q_ct1);
+  int *foundNearest               = sycl::malloc_shared<int>(npoints, q_ct1);
+  std::copy(containing.begin(), containing.end(), expected);
+  q_ct1
+      .parallel_for(sycl::range<1>(npoints),
+                    [=](sycl::id<1> id) {
+                      const int i = id;
+                      foundFirst[i] =
+                          device.FindFirst(root, points[i], [&](int index) { return index == expected[i]; })
+                              ? expected[i]
+                              : -1;
+                      int found   = -1;
+                      double best = vecgeom::kInfLength;
+                      device.ForEachCandidate(root, points[i], dirs[i], best, [&](int index, vecgeom::Precision) {
+                        if (distances[i * ndaughters + index] < best) {
+                          best  = distances[i * ndaughters + index];
+                          found = index;
+                        }
+                        return best;
+                      });
+                      foundNearest[i] = found;
+                    })
+      .wait_and_throw();
+
+  std::cout << "   device FindFirst vs linear scan    ... ";
+  testOK = true;
+  for (int i = 0; i < npoints; ++i)
+    testOK &= foundFirst[i] == containing[i];
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  std::cout << "   device ForEachCandidate vs linear  ... ";
+  testOK = true;
+  for (int i = 0; i < npoints; ++i)
+    testOK &= foundNearest[i] == nearest[i];
+  std::cout << result[testOK] << "\n";
+  success &= testOK;
+
+  sycl::free(points, q_ct1);
+  sycl::free(dirs, q_ct1);
+  sycl::free(distances, q_ct1);
+  sycl::free(expected, q_ct1);
+  sycl::free(foundFirst, q_ct1);
+  sycl::free(foundNearest, q_ct1);
+
+  if (!success) return 1;
+  return 0;
+}
@@ -10,7 +10,10 @@
 #include <CL/sycl.hpp>
 #include <iostream>
 #include <cassert>
+#include <chrono>
+#include <iomanip>
 #include <AdePT/1/BlockData.h>
+#include <AdePT/1/BlockDataCache.h>
 
 struct MyTrack {
   int index{0};
@@ -36,6 +39,79 @@ void releaseTrack(adept::BlockData<MyTrack> *block, sycl::nd_item<3> item_ct1)
   block->ReleaseElement(id);
 }
 
+// Number of allocate/release cycles per thread in the contention benchmark
+constexpr int kChurn = 64;
+// Size of the per-thread cache in the contention benchmark, the most a thread holds at once
+constexpr int kChurnCache = 16;
+
+// Kernel function allocating and releasing tracks one at a time, through the global atomics. The
+// number of completed cycles is written to cycles.
+void churnPlain(adept::BlockData<MyTrack> *block, int *cycles)
+{
+  int i = 0;
+  for (; i < kChurn; ++i) {
+    auto track = block->NextElement();
+    if (!track) break;
+    track->index = i;
+    block->ReleaseElement(track - &(*block)[0]);
+  }
+  *cycles = i;
+}
+
+// Kernel function allocating and releasing tracks cooperatively per sub-group
+void churnSubgroup(adept::BlockData<MyTrack> *block, int *cycles, sycl::nd_item<3> item_ct1)
+{
+  auto sg  = item_ct1.get_sub_group();
+  int done = 0;
+  for (int i = 0; i < kChurn; ++i) {
+    auto track = block->NextElement(sg);
+    int index  = -1;
+    if (track) {
+      track->index = i;
+      index        = track - &(*block)[0];
+      done++;
+    }
+    block->ReleaseElement(sg, index, track != nullptr);
+  }
+  *cycles = done;
+}
+
+// Kernel function allocating and releasing tracks through a per-thread cache
+void churnCache(adept::BlockData<MyTrack> *block, int *cycles)
+{
+  adept::BlockDataCache<MyTrack, kChurnCache> cache(block);
+  int i = 0;
+  for (; i < kChurn; ++i) {
+    int index = cache.NextIndex();
+    if (index < 0) break;
+    (*block)[index].index = i;
+    cache.ReleaseElement(index);
+  }
+  *cycles = i;
+}
+
+// Size of the per-work-group cache in the contention benchmark, at least the work-group size
+constexpr int kChurnGroupCache = 256;
+using GroupCache_t             = adept::BlockDataGroupCache<MyTrack, kChurnGroupCache>;
+
+// Kernel function allocating and releasing tracks through a cache shared by the work-group
+void churnGroupCache(adept::BlockData<MyTrack> *block, GroupCache_t *cache, int *cycles, sycl::nd_item<3> item_ct1)
+{
+  auto group = item_ct1.get_group();
+  cache->Init(group, block);
+  int done = 0;
+  for (int i = 0; i < kChurn; ++i) {
+    int index = cache->NextIndex(group);
+    if (index >= 0) {
+      (*block)[index].index = i;
+      done++;
+    }
+    cache->ReleaseElement(group, index, index >= 0);
+  }
+  cache->Flush(group);
+  *cycles = done;
+}
+
 ///______________________________________________________________________________________
 int main(void)
 {
@@ -184,6 +260,47 @@ int main(void)
   q_ct1.wait_and_throw();
   testOK &= block->GetNholes() == (32000 - 320);
   std::cout << result[testOK] << "\n";
+
+  // Contention benchmark: every thread allocates and releases kChurn tracks. The threads hold at most
+  // half of the capacity at once, so that the block is never exhausted and the benchmark measures the
+  // reuse of released elements. Every cycle has to succeed.
+  const sycl::range<3> churnBlocks(1, 1, capacity / (2 * kChurnCache * nthreads[2]));
+  const int numChurnThreads = churnBlocks[2] * nthreads[2];
+  int *cycles               = sycl::malloc_shared<int>(numChurnThreads, q_ct1);
+  auto runChurn             = [&](const char *name, int mode) {
+    auto churnBlock = Block_t::MakeInstanceAt(capacity, buffer);
+    q_ct1.wait_and_throw();
+    auto start = std::chrono::steady_clock::now();
+    q_ct1.submit([&](sycl::handler &cgh) {
+      sycl::accessor<GroupCache_t, 1, sycl::access_mode::read_write, sycl::access::target::local> groupCache(1, cgh);
+      cgh.parallel_for(sycl::nd_range<3>(churnBlocks * nthreads, nthreads), [=](sycl::nd_item<3> item_ct1) {
+        int *threadCycles = cycles + item_ct1.get_global_linear_id();
+        if (mode == 0)
+          churnPlain(churnBlock, threadCycles);
+        else if (mode == 1)
+          churnSubgroup(churnBlock, threadCycles, item_ct1);
+        else if (mode == 2)
+          churnCache(churnBlock, threadCycles);
+        else
+          churnGroupCache(churnBlock, &groupCache[0], threadCycles, item_ct1);
+      });
+    });
+    q_ct1.wait_and_throw();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "   " << name << " ... ";
+    long totalCycles = 0;
+    for (int i = 0; i < numChurnThreads; ++i)
+      totalCycles += cycles[i];
+    testOK = churnBlock->GetNused() == 0 && totalCycles == (long)numChurnThreads * kChurn;
+    std::cout << result[testOK] << std::fixed << std::setprecision(6) << "  (" << elapsed.count() << " s)\n";
+    success &= testOK;
+  };
+  runChurn("churn per-thread atomics     ", 0);
+  runChurn("churn per-sub-group          ", 1);
+  runChurn("churn per-thread cache       ", 2);
+  runChurn("churn per-work-group cache   ", 3);
+
+  sycl::free(cycles, q_ct1);
   sycl::free(buffer, q_ct1);
   if (!success) return 1;
   return 0;